@@ -73,4 +73,6 @@
 
 #define SO_SELECT_ERR_QUEUE	0x4026
 
+#define SO_BUSY_POLL		0x4027
+
 #endif /* _UAPI_ASM_SOCKET_H */
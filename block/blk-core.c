@@ -658,11 +658,16 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 	q->bypass_depth = 1;
 	__set_bit(QUEUE_FLAG_BYPASS, &q->queue_flags);
 
-	if (blkcg_init_queue(q))
+	if (blk_lat_hist_init(q))
 		goto fail_bdi;
 
+	if (blkcg_init_queue(q))
+		goto fail_hist;
+
 	return q;
 
+fail_hist:
+	blk_lat_hist_exit(q);
 fail_bdi:
 	bdi_destroy(&q->backing_dev_info);
 fail_id:
@@ -2186,6 +2191,8 @@ static void blk_account_io_done(struct request *req)
 
 		hd_struct_put(part);
 		part_stat_unlock();
+
+		blk_account_io_latency(req);
 	}
 }
 
@@ -2336,6 +2343,7 @@ void blk_dequeue_request(struct request *rq)
 	if (blk_account_rq(rq)) {
 		q->in_flight[rq_is_sync(rq)]++;
 		set_io_start_time_ns(rq);
+		blk_lat_hist_dispatch(rq);
 	}
 }
 
@@ -0,0 +1,176 @@
+/*
+ * Request latency histograms
+ *
+ * Every request completed with I/O accounting enabled is counted in a
+ * per-cpu histogram of its queue, once for the time from insertion to
+ * dispatch and once for the time the device took, so that storage
+ * stalls can be told apart from scheduler queueing without blktrace.
+ */
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "blk.h"
+
+static const char *const blk_lat_phase_names[BLK_LAT_PHASES] = {
+	[BLK_LAT_QUEUE]		= "queue",
+	[BLK_LAT_DEVICE]	= "device",
+};
+
+static const char *const blk_lat_op_names[BLK_LAT_OPS] = {
+	[BLK_LAT_READ]		= "read",
+	[BLK_LAT_WRITE]		= "write",
+	[BLK_LAT_DISCARD]	= "discard",
+};
+
+static const char *const blk_lat_size_names[BLK_LAT_SIZES] = {
+	"4K", "32K", "128K", "large",
+};
+
+int blk_lat_hist_init(struct request_queue *q)
+{
+	q->lat_hist = alloc_percpu(struct blk_lat_hist);
+	return q->lat_hist ? 0 : -ENOMEM;
+}
+
+void blk_lat_hist_exit(struct request_queue *q)
+{
+	free_percpu(q->lat_hist);
+	q->lat_hist = NULL;
+}
+
+static inline int blk_lat_size(unsigned int bytes)
+{
+	if (bytes <= SZ_4K)
+		return 0;
+	if (bytes <= SZ_32K)
+		return 1;
+	if (bytes <= SZ_128K)
+		return 2;
+	return 3;
+}
+
+static inline int blk_lat_bucket(u64 delta_ns)
+{
+	u64 usecs = div_u64(delta_ns, NSEC_PER_USEC);
+
+	return min_t(int, fls64(usecs >> 3), BLK_LAT_BUCKETS - 1);
+}
+
+/**
+ * blk_account_io_latency - count a completed request in the histograms
+ * @req: the request
+ *
+ * Requests that never went through blk_dequeue_request() carry no
+ * dispatch time and are not counted.
+ */
+void blk_account_io_latency(struct request *req)
+{
+	struct blk_lat_hist __percpu *hist = req->q->lat_hist;
+	u64 now, queued, dispatched;
+	int op, size;
+
+	dispatched = rq_io_start_time_ns(req);
+	if (!hist || !dispatched)
+		return;
+
+	if (req->cmd_flags & REQ_DISCARD)
+		op = BLK_LAT_DISCARD;
+	else
+		op = rq_data_dir(req) == READ ? BLK_LAT_READ : BLK_LAT_WRITE;
+	size = blk_lat_size(req->io_bytes);
+
+	preempt_disable();
+	now = sched_clock();
+	queued = rq_start_time_ns(req);
+	if (queued && queued <= dispatched)
+		this_cpu_inc(hist->count[BLK_LAT_QUEUE][op][size]
+			     [blk_lat_bucket(dispatched - queued)]);
+	if (dispatched <= now)
+		this_cpu_inc(hist->count[BLK_LAT_DEVICE][op][size]
+			     [blk_lat_bucket(now - dispatched)]);
+	preempt_enable();
+}
+
+/*
+ * One line per phase/op/size that saw any request: the counts of every
+ * latency bucket, preceded by a header with the bucket bounds in usec.
+ */
+ssize_t blk_lat_hist_show(struct request_queue *q, char *buf)
+{
+	struct blk_lat_hist *sum;
+	ssize_t count = 0;
+	int phase, op, size, b, cpu;
+	u32 *row;
+	u64 total;
+
+	if (!q->lat_hist)
+		return -ENODEV;
+
+	sum = kzalloc(sizeof(*sum), GFP_KERNEL);
+	if (!sum)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct blk_lat_hist *h = per_cpu_ptr(q->lat_hist, cpu);
+
+		for (phase = 0; phase < BLK_LAT_PHASES; phase++)
+			for (op = 0; op < BLK_LAT_OPS; op++)
+				for (size = 0; size < BLK_LAT_SIZES; size++)
+					for (b = 0; b < BLK_LAT_BUCKETS; b++)
+						sum->count[phase][op][size][b] +=
+						h->count[phase][op][size][b];
+	}
+
+	count += scnprintf(buf + count, PAGE_SIZE - count, "usecs:");
+	for (b = 0; b < BLK_LAT_BUCKETS - 1; b++)
+		count += scnprintf(buf + count, PAGE_SIZE - count, " <%u",
+				   8U << b);
+	count += scnprintf(buf + count, PAGE_SIZE - count, " >=%u\n",
+			   8U << (BLK_LAT_BUCKETS - 2));
+
+	for (phase = 0; phase < BLK_LAT_PHASES; phase++) {
+		for (op = 0; op < BLK_LAT_OPS; op++) {
+			for (size = 0; size < BLK_LAT_SIZES; size++) {
+				row = sum->count[phase][op][size];
+				total = 0;
+				for (b = 0; b < BLK_LAT_BUCKETS; b++)
+					total += row[b];
+				if (!total)
+					continue;
+
+				count += scnprintf(buf + count,
+						   PAGE_SIZE - count,
+						   "%s %s %s:",
+						   blk_lat_phase_names[phase],
+						   blk_lat_op_names[op],
+						   blk_lat_size_names[size]);
+				for (b = 0; b < BLK_LAT_BUCKETS; b++)
+					count += scnprintf(buf + count,
+							   PAGE_SIZE - count,
+							   " %u", row[b]);
+				count += scnprintf(buf + count,
+						   PAGE_SIZE - count, "\n");
+			}
+		}
+	}
+
+	kfree(sum);
+	return count;
+}
+
+void blk_lat_hist_reset(struct request_queue *q)
+{
+	int cpu;
+
+	if (!q->lat_hist)
+		return;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(q->lat_hist, cpu), 0,
+		       sizeof(struct blk_lat_hist));
+}
@@ -543,6 +543,7 @@ static void blk_release_queue(struct kobject *kobj)
 		__blk_queue_free_tags(q);
 
 	blk_trace_shutdown(q);
+	blk_lat_hist_exit(q);
 
 	bdi_destroy(&q->backing_dev_info);
 
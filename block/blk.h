@@ -33,6 +33,54 @@ void __blk_queue_free_tags(struct request_queue *q);
 bool __blk_end_bidi_request(struct request *rq, int error,
 			    unsigned int nr_bytes, unsigned int bidi_bytes);
 
+#ifdef CONFIG_BLK_DEV_LATENCY_HIST
+/*
+ * Request latency histograms, one set per cpu and request queue. A
+ * request is counted by phase (insertion to dispatch, dispatch to
+ * completion), op and size when it completes. Latency bucket i holds
+ * [8 << (i - 1), 8 << i) usec, the first one everything under 8 usec
+ * and the last one everything from 8 << (BLK_LAT_BUCKETS - 2) usec on.
+ */
+enum {
+	BLK_LAT_QUEUE,
+	BLK_LAT_DEVICE,
+	BLK_LAT_PHASES,
+};
+
+enum {
+	BLK_LAT_READ,
+	BLK_LAT_WRITE,
+	BLK_LAT_DISCARD,
+	BLK_LAT_OPS,
+};
+
+#define BLK_LAT_SIZES		4	/* <= 4K, 32K, 128K, larger */
+#define BLK_LAT_BUCKETS		16
+
+struct blk_lat_hist {
+	u32 count[BLK_LAT_PHASES][BLK_LAT_OPS][BLK_LAT_SIZES][BLK_LAT_BUCKETS];
+};
+
+int blk_lat_hist_init(struct request_queue *q);
+void blk_lat_hist_exit(struct request_queue *q);
+void blk_account_io_latency(struct request *req);
+ssize_t blk_lat_hist_show(struct request_queue *q, char *buf);
+void blk_lat_hist_reset(struct request_queue *q);
+
+static inline void blk_lat_hist_dispatch(struct request *rq)
+{
+	rq->io_bytes = blk_rq_bytes(rq);
+}
+#else
+static inline int blk_lat_hist_init(struct request_queue *q)
+{
+	return 0;
+}
+static inline void blk_lat_hist_exit(struct request_queue *q) { }
+static inline void blk_account_io_latency(struct request *req) { }
+static inline void blk_lat_hist_dispatch(struct request *rq) { }
+#endif
+
 void blk_rq_timed_out_timer(unsigned long data);
 void blk_delete_timer(struct request *);
 void blk_add_timer(struct request *);
@@ -64,18 +64,21 @@ enum row_queue_prio {
  *			in a dispatch cycle
  * @is_urgent: Flags indicating whether the queue can notify on
  *			urgent requests
+ * @target_ms: Longest time (msec) a request may wait in this queue
+ *			before it is dispatched ahead of the priority order
  *
  */
 struct row_queue_params {
 	bool idling_enabled;
 	int quantum;
 	bool is_urgent;
+	int target_ms;
 };
 
 /*
  * This array holds the default values of the different configurables
  * for each ROW queue. Each row of the array holds the following values:
- * {idling_enabled, quantum, is_urgent}
+ * {idling_enabled, quantum, is_urgent, target_ms}
  * Each row corresponds to a queue with the same index (according to
  * enum row_queue_prio)
  * Note: The quantums are valid inside their priority type. For example:
@@ -85,16 +88,29 @@ struct row_queue_params {
  *       be dispatched.
  */
 static const struct row_queue_params row_queues_def[] = {
-/* idling_enabled, quantum, is_urgent */
-	{true, 10, true},	/* ROWQ_PRIO_HIGH_READ */
-	{false, 1, false},	/* ROWQ_PRIO_HIGH_SWRITE */
-	{true, 100, true},	/* ROWQ_PRIO_REG_READ */
-	{false, 1, false},	/* ROWQ_PRIO_REG_SWRITE */
-	{false, 1, false},	/* ROWQ_PRIO_REG_WRITE */
-	{false, 1, false},	/* ROWQ_PRIO_LOW_READ */
-	{false, 1, false}	/* ROWQ_PRIO_LOW_SWRITE */
+/* idling_enabled, quantum, is_urgent, target_ms */
+	{true, 10, true, 20},		/* ROWQ_PRIO_HIGH_READ */
+	{false, 1, false, 100},		/* ROWQ_PRIO_HIGH_SWRITE */
+	{true, 100, true, 50},		/* ROWQ_PRIO_REG_READ */
+	{false, 1, false, 250},		/* ROWQ_PRIO_REG_SWRITE */
+	{false, 1, false, 500},		/* ROWQ_PRIO_REG_WRITE */
+	{false, 1, false, 1000},	/* ROWQ_PRIO_LOW_READ */
+	{false, 1, false, 1000}		/* ROWQ_PRIO_LOW_SWRITE */
 };
 
+/*
+ * With adaptive quantum a queue whose requests complete later than its
+ * target is given up to this many times its configured quantum, and is
+ * brought back to it once they complete within half the target.
+ */
+#define ROW_MAX_QUANTUM_SCALE	4
+
+/*
+ * Completion latency histogram buckets: bucket i counts requests that
+ * completed in [2^(i-1), 2^i) msec, the last one everything slower.
+ */
+#define ROW_LAT_BUCKETS		12
+
 /* Default values for idling on read queues (in msec) */
 #define ROW_IDLE_TIME_MSEC 5
 #define ROW_READ_FREQ_MSEC 5
@@ -121,6 +137,13 @@ struct rowq_idling_data {
  * @nr_req:		number of requests in queue
  * @dispatch quantum:	number of requests this queue may
  *			dispatch in a dispatch cycle
+ * @quantum_boost:	requests added to disp_quantum while the queue
+ *			misses its target latency
+ * @target_ms:		target latency of the queue (msec)
+ * @avg_lat_us:		moving average of the completion latency (usec)
+ * @nr_expired:		number of requests dispatched because they
+ *			waited longer than target_ms
+ * @lat_hist:		completion latency histogram
  * @idle_data:		data for idling on queues
  *
  */
@@ -133,6 +156,12 @@ struct row_queue {
 
 	unsigned int		nr_req;
 	int			disp_quantum;
+	int			quantum_boost;
+
+	int			target_ms;
+	unsigned long		avg_lat_us;
+	unsigned long		nr_expired;
+	unsigned long		lat_hist[ROW_LAT_BUCKETS];
 
 	/* used only for READ queues */
 	struct rowq_idling_data	idle_data;
@@ -187,6 +216,8 @@ struct starvation_data {
  * @reg_prio_starvation: starvation data for REGULAR priority queues
  * @low_prio_starvation: starvation data for LOW priority queues
  * @cycle_flags:	used for marking unserved queueus
+ * @adaptive_quantum:	flag indicating whether queue quantums follow
+ *			the measured completion latency
  *
  */
 struct row_data {
@@ -206,9 +237,12 @@ struct row_data {
 	struct starvation_data		low_prio_starvation;
 
 	unsigned int			cycle_flags;
+	int				adaptive_quantum;
 };
 
 #define RQ_ROWQ(rq) ((struct row_queue *) ((rq)->elv.priv[0]))
+/* Insertion time in usec, kept modulo ULONG_MAX */
+#define RQ_INSERT_US(rq) ((unsigned long)((rq)->elv.priv[1]))
 
 #define row_log(q, fmt, args...)   \
 	blk_add_trace_msg(q, "%s():" fmt , __func__, ##args)
@@ -234,6 +268,14 @@ static inline int row_rowq_unserved(struct row_data *rd,
 	return rd->cycle_flags & (1 << qnum);
 }
 
+static inline int row_rowq_quantum(struct row_data *rd,
+				   struct row_queue *rqueue)
+{
+	if (!rd->adaptive_quantum)
+		return rqueue->disp_quantum;
+	return rqueue->disp_quantum + rqueue->quantum_boost;
+}
+
 static inline void __maybe_unused row_dump_queues_stat(struct row_data *rd)
 {
 	int i;
@@ -335,7 +377,8 @@ static void row_add_request(struct request_queue *q,
 	list_add_tail(&rq->queuelist, &rqueue->fifo);
 	rd->nr_reqs[rq_data_dir(rq)]++;
 	rqueue->nr_req++;
-	rq->fifo_time=jiffies; /* for statistics*/
+	rq->fifo_time = jiffies + msecs_to_jiffies(rqueue->target_ms);
+	rq->elv.priv[1] = (void *)(unsigned long)ktime_to_us(ktime_get());
 
 	if (rq->cmd_flags & REQ_URGENT) {
 		WARN_ON(1);
@@ -449,9 +492,52 @@ static int row_reinsert_req(struct request_queue *q,
 	return 0;
 }
 
+/*
+ * row_update_latency() - Account the completion latency of a request
+ * @rd:		pointer to struct row_data
+ * @rqueue:	queue the request was dispatched from
+ * @lat_us:	time from insertion to completion (usec)
+ *
+ * Updates the latency statistics of the queue and, with adaptive
+ * quantum, grows the quantum of a queue that misses its target and
+ * shrinks it back once the target is comfortably met.
+ */
+static void row_update_latency(struct row_data *rd, struct row_queue *rqueue,
+			       unsigned long lat_us)
+{
+	unsigned long target_us = rqueue->target_ms * USEC_PER_MSEC;
+	int bucket = 0;
+
+	if (lat_us >= USEC_PER_MSEC)
+		bucket = min(fls(lat_us / USEC_PER_MSEC), ROW_LAT_BUCKETS - 1);
+	rqueue->lat_hist[bucket]++;
+
+	/* 1/8 weight for the newest sample */
+	rqueue->avg_lat_us = rqueue->avg_lat_us - (rqueue->avg_lat_us >> 3) +
+			     (lat_us >> 3);
+
+	if (!rd->adaptive_quantum)
+		return;
+
+	if (rqueue->avg_lat_us > target_us) {
+		if (rqueue->quantum_boost <
+		    (ROW_MAX_QUANTUM_SCALE - 1) * rqueue->disp_quantum)
+			rqueue->quantum_boost++;
+	} else if (rqueue->avg_lat_us < target_us / 2) {
+		if (rqueue->quantum_boost > 0)
+			rqueue->quantum_boost--;
+	}
+}
+
 static void row_completed_req(struct request_queue *q, struct request *rq)
 {
 	struct row_data *rd = q->elevator->elevator_data;
+	struct row_queue *rqueue = RQ_ROWQ(rq);
+
+	if (rqueue)
+		row_update_latency(rd, rqueue,
+			(unsigned long)ktime_to_us(ktime_get()) -
+			RQ_INSERT_US(rq));
 
 	 if (rq->cmd_flags & REQ_URGENT) {
 		if (!rd->urgent_in_flight) {
@@ -662,7 +748,7 @@ static void row_restart_cycle(struct row_data *rd,
 	row_dump_queues_stat(rd);
 	for (i = start_idx; i < end_idx; i++) {
 		if (rd->row_queues[i].nr_dispatched <
-		    rd->row_queues[i].disp_quantum)
+		    row_rowq_quantum(rd, &rd->row_queues[i]))
 			row_mark_rowq_unserved(rd, i);
 		rd->row_queues[i].nr_dispatched = 0;
 	}
@@ -690,7 +776,7 @@ static int row_get_next_queue(struct request_queue *q, struct row_data *rd,
 	do {
 		if (list_empty(&rd->row_queues[i].fifo) ||
 		    rd->row_queues[i].nr_dispatched >=
-		    rd->row_queues[i].disp_quantum) {
+		    row_rowq_quantum(rd, &rd->row_queues[i])) {
 			i++;
 			if (i == end_idx && restart) {
 				/* Restart cycle for this priority class */
@@ -707,6 +793,30 @@ static int row_get_next_queue(struct request_queue *q, struct row_data *rd,
 	return ret;
 }
 
+/*
+ * row_get_expired_queue() - find a queue whose oldest request expired
+ * @rd:		pointer to struct row_data
+ *
+ * Return index of the highest priority queue whose oldest request has
+ * waited longer than the target latency of the queue. -1 if none.
+ *
+ */
+static int row_get_expired_queue(struct row_data *rd)
+{
+	struct request *rq;
+	int i;
+
+	for (i = 0; i < ROWQ_MAX_PRIO; i++) {
+		if (list_empty(&rd->row_queues[i].fifo))
+			continue;
+		rq = rq_entry_fifo(rd->row_queues[i].fifo.next);
+		if (time_after_eq(jiffies, rq->fifo_time))
+			return i;
+	}
+
+	return -1;
+}
+
 /*
  * row_dispatch_requests() - selects the next request to dispatch
  * @q:		requests queue
@@ -737,6 +847,17 @@ static int row_dispatch_requests(struct request_queue *q, int force)
 		goto done;
 	}
 
+	/* A request past its target latency goes ahead of the class order */
+	currq = row_get_expired_queue(rd);
+	if (currq >= 0) {
+		row_log_rowq(rd, currq, "dispatching expired request");
+		rd->row_queues[currq].nr_expired++;
+		row_dispatch_insert(rd,
+			rq_entry_fifo(rd->row_queues[currq].fifo.next));
+		ret = 1;
+		goto done;
+	}
+
 	ioprio_class_to_serve = row_get_ioprio_class_to_serve(rd, force);
 	row_log(rd->dispatch_queue, "Dispatching from %d priority class",
 		ioprio_class_to_serve);
@@ -805,6 +926,7 @@ static int row_init_queue(struct request_queue *q, struct elevator_type *e)
 	for (i = 0; i < ROWQ_MAX_PRIO; i++) {
 		INIT_LIST_HEAD(&rdata->row_queues[i].fifo);
 		rdata->row_queues[i].disp_quantum = row_queues_def[i].quantum;
+		rdata->row_queues[i].target_ms = row_queues_def[i].target_ms;
 		rdata->row_queues[i].rdata = rdata;
 		rdata->row_queues[i].prio = i;
 		rdata->row_queues[i].idle_data.begin_idling = false;
@@ -831,6 +953,7 @@ static int row_init_queue(struct request_queue *q, struct elevator_type *e)
 	rdata->last_served_ioprio_class = IOPRIO_CLASS_NONE;
 	rdata->rd_idle_data.idling_queue_idx = ROWQ_MAX_PRIO;
 	rdata->dispatch_queue = q;
+	rdata->adaptive_quantum = 1;
 
 	spin_lock_irq(q->queue_lock);
 	q->elevator = eq;
@@ -868,6 +991,17 @@ static void row_merged_requests(struct request_queue *q, struct request *rq,
 {
 	struct row_queue   *rqueue = RQ_ROWQ(next);
 
+	/*
+	 * Keep the earlier deadline, and the fifo position that goes
+	 * with it, when both requests sit on the same queue.
+	 */
+	if (RQ_ROWQ(rq) == rqueue && !list_empty(&rq->queuelist) &&
+	    time_before(next->fifo_time, rq->fifo_time)) {
+		list_move(&rq->queuelist, &next->queuelist);
+		rq->fifo_time = next->fifo_time;
+		rq->elv.priv[1] = next->elv.priv[1];
+	}
+
 	list_del_init(&next->queuelist);
 	rqueue->nr_req--;
 	if (rqueue->rdata->pending_urgent_rq == next) {
@@ -997,6 +1131,21 @@ SHOW_FUNCTION(row_reg_starv_limit_show,
 	rowd->reg_prio_starvation.starvation_limit);
 SHOW_FUNCTION(row_low_starv_limit_show,
 	rowd->low_prio_starvation.starvation_limit);
+SHOW_FUNCTION(row_hp_read_target_ms_show,
+	rowd->row_queues[ROWQ_PRIO_HIGH_READ].target_ms);
+SHOW_FUNCTION(row_rp_read_target_ms_show,
+	rowd->row_queues[ROWQ_PRIO_REG_READ].target_ms);
+SHOW_FUNCTION(row_hp_swrite_target_ms_show,
+	rowd->row_queues[ROWQ_PRIO_HIGH_SWRITE].target_ms);
+SHOW_FUNCTION(row_rp_swrite_target_ms_show,
+	rowd->row_queues[ROWQ_PRIO_REG_SWRITE].target_ms);
+SHOW_FUNCTION(row_rp_write_target_ms_show,
+	rowd->row_queues[ROWQ_PRIO_REG_WRITE].target_ms);
+SHOW_FUNCTION(row_lp_read_target_ms_show,
+	rowd->row_queues[ROWQ_PRIO_LOW_READ].target_ms);
+SHOW_FUNCTION(row_lp_swrite_target_ms_show,
+	rowd->row_queues[ROWQ_PRIO_LOW_SWRITE].target_ms);
+SHOW_FUNCTION(row_adaptive_quantum_show, rowd->adaptive_quantum);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX)			\
@@ -1043,9 +1192,64 @@ STORE_FUNCTION(row_reg_starv_limit_store,
 STORE_FUNCTION(row_low_starv_limit_store,
 			&rowd->low_prio_starvation.starvation_limit,
 			1, INT_MAX);
+STORE_FUNCTION(row_hp_read_target_ms_store,
+			&rowd->row_queues[ROWQ_PRIO_HIGH_READ].target_ms,
+			1, INT_MAX);
+STORE_FUNCTION(row_rp_read_target_ms_store,
+			&rowd->row_queues[ROWQ_PRIO_REG_READ].target_ms,
+			1, INT_MAX);
+STORE_FUNCTION(row_hp_swrite_target_ms_store,
+			&rowd->row_queues[ROWQ_PRIO_HIGH_SWRITE].target_ms,
+			1, INT_MAX);
+STORE_FUNCTION(row_rp_swrite_target_ms_store,
+			&rowd->row_queues[ROWQ_PRIO_REG_SWRITE].target_ms,
+			1, INT_MAX);
+STORE_FUNCTION(row_rp_write_target_ms_store,
+			&rowd->row_queues[ROWQ_PRIO_REG_WRITE].target_ms,
+			1, INT_MAX);
+STORE_FUNCTION(row_lp_read_target_ms_store,
+			&rowd->row_queues[ROWQ_PRIO_LOW_READ].target_ms,
+			1, INT_MAX);
+STORE_FUNCTION(row_lp_swrite_target_ms_store,
+			&rowd->row_queues[ROWQ_PRIO_LOW_SWRITE].target_ms,
+			1, INT_MAX);
+STORE_FUNCTION(row_adaptive_quantum_store, &rowd->adaptive_quantum, 0, 1);
 
 #undef STORE_FUNCTION
 
+/*
+ * row_latency_hist_show() - Per queue completion latency statistics
+ *
+ * One line per queue: the histogram buckets (msec upper bounds), the
+ * average latency, the number of expired dispatches and the current
+ * quantum.
+ */
+static ssize_t row_latency_hist_show(struct elevator_queue *e, char *page)
+{
+	struct row_data *rowd = e->elevator_data;
+	struct row_queue *rqueue;
+	ssize_t count = 0;
+	int i, b;
+
+	for (i = 0; i < ROWQ_MAX_PRIO; i++) {
+		rqueue = &rowd->row_queues[i];
+		count += scnprintf(page + count, PAGE_SIZE - count,
+				   "rowq%d:", i);
+		for (b = 0; b < ROW_LAT_BUCKETS - 1; b++)
+			count += scnprintf(page + count, PAGE_SIZE - count,
+					   " <%u:%lu", 1U << b,
+					   rqueue->lat_hist[b]);
+		count += scnprintf(page + count, PAGE_SIZE - count,
+				   " >=%u:%lu avg_us:%lu expired:%lu quantum:%d\n",
+				   1U << (ROW_LAT_BUCKETS - 2),
+				   rqueue->lat_hist[ROW_LAT_BUCKETS - 1],
+				   rqueue->avg_lat_us, rqueue->nr_expired,
+				   row_rowq_quantum(rowd, rqueue));
+	}
+
+	return count;
+}
+
 #define ROW_ATTR(name) \
 	__ATTR(name, S_IRUGO|S_IWUSR, row_##name##_show, \
 				      row_##name##_store)
@@ -1062,6 +1266,15 @@ static struct elv_fs_entry row_attrs[] = {
 	ROW_ATTR(rd_idle_data_freq),
 	ROW_ATTR(reg_starv_limit),
 	ROW_ATTR(low_starv_limit),
+	ROW_ATTR(hp_read_target_ms),
+	ROW_ATTR(rp_read_target_ms),
+	ROW_ATTR(hp_swrite_target_ms),
+	ROW_ATTR(rp_swrite_target_ms),
+	ROW_ATTR(rp_write_target_ms),
+	ROW_ATTR(lp_read_target_ms),
+	ROW_ATTR(lp_swrite_target_ms),
+	ROW_ATTR(adaptive_quantum),
+	__ATTR(latency_hist, S_IRUGO, row_latency_hist_show, NULL),
 	__ATTR_NULL
 };
 
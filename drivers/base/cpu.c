@@ -313,6 +313,67 @@ static ssize_t __ref store_sched_prefer_idle(struct device *dev,
 	return err;
 }
 
+/*
+ * Energy model of the cpu's cluster: "<idle_power> <freq>:<power> ..."
+ * with frequencies ascending. Writing only the idle power removes it.
+ */
+static ssize_t show_sched_energy_costs(struct device *dev,
+		 struct device_attribute *attr, char *buf)
+{
+	struct cpu *cpu = container_of(dev, struct cpu, dev);
+	struct cpu_pstate_pwr states[SCHED_MAX_ENERGY_STATES];
+	unsigned int idle_power = 0;
+	ssize_t rc;
+	int i, nr_states;
+
+	nr_states = sched_get_cpu_energy_costs(cpu->dev.id, &idle_power,
+					       states, ARRAY_SIZE(states));
+
+	rc = snprintf(buf, PAGE_SIZE, "%u", idle_power);
+	for (i = 0; i < nr_states; i++)
+		rc += snprintf(buf + rc, PAGE_SIZE - rc, " %u:%u",
+			       states[i].freq, states[i].power);
+	rc += snprintf(buf + rc, PAGE_SIZE - rc, "\n");
+
+	return rc;
+}
+
+static ssize_t __ref store_sched_energy_costs(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct cpu *cpu = container_of(dev, struct cpu, dev);
+	struct cpu_pstate_pwr *states;
+	unsigned int idle_power;
+	const char *cp = buf;
+	int nr_states = 0, n, err;
+
+	if (sscanf(cp, "%u%n", &idle_power, &n) != 1)
+		return -EINVAL;
+	cp += n;
+
+	states = kcalloc(SCHED_MAX_ENERGY_STATES, sizeof(*states), GFP_KERNEL);
+	if (!states)
+		return -ENOMEM;
+
+	while (sscanf(cp, " %u:%u%n", &states[nr_states].freq,
+		      &states[nr_states].power, &n) == 2) {
+		cp += n;
+		if (++nr_states == SCHED_MAX_ENERGY_STATES)
+			break;
+	}
+
+	err = sched_set_cpu_energy_costs(cpu->dev.id, idle_power, states,
+					 nr_states);
+	kfree(states);
+	if (err >= 0)
+		err = count;
+
+	return err;
+}
+
+static DEVICE_ATTR(sched_energy_costs, 0664, show_sched_energy_costs,
+						store_sched_energy_costs);
 static DEVICE_ATTR(sched_mostly_idle_freq, 0664, show_sched_mostly_idle_freq,
 						store_sched_mostly_idle_freq);
 static DEVICE_ATTR(sched_mostly_idle_load, 0664, show_sched_mostly_idle_load,
@@ -507,6 +568,9 @@ int __cpuinit register_cpu(struct cpu *cpu, int num)
 	if (!error)
 		error = device_create_file(&cpu->dev,
 					 &dev_attr_sched_prefer_idle);
+	if (!error)
+		error = device_create_file(&cpu->dev,
+					 &dev_attr_sched_energy_costs);
 #endif
 
 	return error;
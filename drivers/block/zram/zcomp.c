@@ -13,6 +13,8 @@
 #include <linux/slab.h>
 #include <linux/wait.h>
 #include <linux/sched.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
 
 #include "zcomp.h"
 #include "zcomp_lzo.h"
@@ -40,6 +42,11 @@ struct zcomp_strm_multi {
 	int avail_strm;
 	/* list of available strms */
 	struct list_head idle_strm;
+	/*
+	 * one idle stream parked per cpu, taken and returned without
+	 * strm_lock so writers on different cpus don't contend
+	 */
+	struct zcomp_strm * __percpu *cached_strm;
 	wait_queue_head_t strm_wait;
 };
 
@@ -93,6 +100,42 @@ static struct zcomp_strm *zcomp_strm_alloc(struct zcomp *comp)
 	return zstrm;
 }
 
+static struct zcomp_strm *zcomp_strm_take_cached(struct zcomp_strm_multi *zs,
+		int cpu)
+{
+	struct zcomp_strm **slot = per_cpu_ptr(zs->cached_strm, cpu);
+
+	if (!ACCESS_ONCE(*slot))
+		return NULL;
+	return xchg(slot, NULL);
+}
+
+/* steal a stream parked on any cpu */
+static struct zcomp_strm *zcomp_strm_steal_cached(struct zcomp_strm_multi *zs)
+{
+	struct zcomp_strm *zstrm;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		zstrm = zcomp_strm_take_cached(zs, cpu);
+		if (zstrm)
+			return zstrm;
+	}
+	return NULL;
+}
+
+static bool zcomp_strm_multi_idle(struct zcomp_strm_multi *zs)
+{
+	int cpu;
+
+	if (!list_empty(&zs->idle_strm))
+		return true;
+	for_each_possible_cpu(cpu)
+		if (ACCESS_ONCE(*per_cpu_ptr(zs->cached_strm, cpu)))
+			return true;
+	return false;
+}
+
 /*
  * get idle zcomp_strm or wait until other process release
  * (zcomp_strm_release()) one for us
@@ -102,6 +145,10 @@ static struct zcomp_strm *zcomp_strm_multi_find(struct zcomp *comp)
 	struct zcomp_strm_multi *zs = comp->stream;
 	struct zcomp_strm *zstrm;
 
+	zstrm = zcomp_strm_take_cached(zs, raw_smp_processor_id());
+	if (zstrm)
+		return zstrm;
+
 	while (1) {
 		spin_lock(&zs->strm_lock);
 		if (!list_empty(&zs->idle_strm)) {
@@ -114,7 +161,10 @@ static struct zcomp_strm *zcomp_strm_multi_find(struct zcomp *comp)
 		/* zstrm streams limit reached, wait for idle stream */
 		if (zs->avail_strm >= zs->max_strm) {
 			spin_unlock(&zs->strm_lock);
-			wait_event(zs->strm_wait, !list_empty(&zs->idle_strm));
+			zstrm = zcomp_strm_steal_cached(zs);
+			if (zstrm)
+				return zstrm;
+			wait_event(zs->strm_wait, zcomp_strm_multi_idle(zs));
 			continue;
 		}
 		/* allocate new zstrm stream */
@@ -126,7 +176,7 @@ static struct zcomp_strm *zcomp_strm_multi_find(struct zcomp *comp)
 			spin_lock(&zs->strm_lock);
 			zs->avail_strm--;
 			spin_unlock(&zs->strm_lock);
-			wait_event(zs->strm_wait, !list_empty(&zs->idle_strm));
+			wait_event(zs->strm_wait, zcomp_strm_multi_idle(zs));
 			continue;
 		}
 		break;
@@ -134,10 +184,24 @@ static struct zcomp_strm *zcomp_strm_multi_find(struct zcomp *comp)
 	return zstrm;
 }
 
-/* add stream back to idle list and wake up waiter or free the stream */
+/*
+ * park stream on this cpu, or add it back to idle list, and wake up
+ * waiter; free the stream if there are more than max_strm of them
+ */
 static void zcomp_strm_multi_release(struct zcomp *comp, struct zcomp_strm *zstrm)
 {
 	struct zcomp_strm_multi *zs = comp->stream;
+	struct zcomp_strm **slot;
+
+	if (ACCESS_ONCE(zs->avail_strm) <= ACCESS_ONCE(zs->max_strm)) {
+		slot = per_cpu_ptr(zs->cached_strm, raw_smp_processor_id());
+		/* cmpxchg orders the store before waitqueue_active() */
+		if (!cmpxchg(slot, NULL, zstrm)) {
+			if (waitqueue_active(&zs->strm_wait))
+				wake_up(&zs->strm_wait);
+			return;
+		}
+	}
 
 	spin_lock(&zs->strm_lock);
 	if (zs->avail_strm <= zs->max_strm) {
@@ -164,6 +228,13 @@ static bool zcomp_strm_multi_set_max_streams(struct zcomp *comp, int num_strm)
 	 * if user has lowered the limit and there are idle streams,
 	 * immediately free as much streams (and memory) as we can.
 	 */
+	while (zs->avail_strm > num_strm) {
+		zstrm = zcomp_strm_steal_cached(zs);
+		if (!zstrm)
+			break;
+		zcomp_strm_free(comp, zstrm);
+		zs->avail_strm--;
+	}
 	while (zs->avail_strm > num_strm && !list_empty(&zs->idle_strm)) {
 		zstrm = list_entry(zs->idle_strm.next,
 				struct zcomp_strm, list);
@@ -180,12 +251,15 @@ static void zcomp_strm_multi_destroy(struct zcomp *comp)
 	struct zcomp_strm_multi *zs = comp->stream;
 	struct zcomp_strm *zstrm;
 
+	while ((zstrm = zcomp_strm_steal_cached(zs)))
+		zcomp_strm_free(comp, zstrm);
 	while (!list_empty(&zs->idle_strm)) {
 		zstrm = list_entry(zs->idle_strm.next,
 				struct zcomp_strm, list);
 		list_del(&zstrm->list);
 		zcomp_strm_free(comp, zstrm);
 	}
+	free_percpu(zs->cached_strm);
 	kfree(zs);
 }
 
@@ -202,6 +276,12 @@ static int zcomp_strm_multi_create(struct zcomp *comp, int max_strm)
 	if (!zs)
 		return -ENOMEM;
 
+	zs->cached_strm = alloc_percpu(struct zcomp_strm *);
+	if (!zs->cached_strm) {
+		kfree(zs);
+		return -ENOMEM;
+	}
+
 	comp->stream = zs;
 	spin_lock_init(&zs->strm_lock);
 	INIT_LIST_HEAD(&zs->idle_strm);
@@ -211,6 +291,7 @@ static int zcomp_strm_multi_create(struct zcomp *comp, int max_strm)
 
 	zstrm = zcomp_strm_alloc(comp);
 	if (!zstrm) {
+		free_percpu(zs->cached_strm);
 		kfree(zs);
 		return -ENOMEM;
 	}
@@ -0,0 +1,449 @@
+/*
+ * drivers/cpufreq/cpufreq_schedutil.c
+ *
+ * CPUFreq governor driven directly by the scheduler's window-based
+ * load statistics.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Instead of sampling load from a timer, the scheduler pushes each
+ * cpu's demand to the governor at every window rollover and on task
+ * migration (see sched_set_freq_update_hook()). The next frequency is
+ * computed right there, under a per-policy raw spinlock, and handed to
+ * a SCHED_FIFO kthread through irq_work since cpufreq drivers may
+ * sleep and the scheduler holds rq->lock while calling us.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/irq_work.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/sched/rt.h>
+#include <linux/slab.h>
+
+#define SUGOV_DEFAULT_TARGET_LOAD	80
+#define SUGOV_DEFAULT_UP_RATE_US	500
+#define SUGOV_DEFAULT_DOWN_RATE_US	20000
+
+struct sugov_policy {
+	struct cpufreq_policy *policy;
+
+	raw_spinlock_t update_lock;	/* protects the fields below */
+	u64 last_freq_update_time;
+	unsigned int next_freq;
+	bool work_in_progress;
+
+	/* slow path: cpufreq drivers here may sleep */
+	struct irq_work irq_work;
+	struct kthread_work work;
+	struct mutex work_lock;
+	struct kthread_worker worker;
+	struct task_struct *thread;
+};
+
+struct sugov_cpu {
+	struct freq_update_hook hook;
+	struct sugov_policy *sg_policy;
+
+	unsigned long util;
+	unsigned long max;
+	u64 last_update;
+};
+
+static DEFINE_PER_CPU(struct sugov_cpu, sugov_cpu);
+
+/* Tunables are global, in /sys/devices/system/cpu/cpufreq/schedutil */
+static unsigned int target_load = SUGOV_DEFAULT_TARGET_LOAD;
+static unsigned int up_rate_limit_us = SUGOV_DEFAULT_UP_RATE_US;
+static unsigned int down_rate_limit_us = SUGOV_DEFAULT_DOWN_RATE_US;
+static u64 up_rate_delay_ns = SUGOV_DEFAULT_UP_RATE_US * NSEC_PER_USEC;
+static u64 down_rate_delay_ns = SUGOV_DEFAULT_DOWN_RATE_US * NSEC_PER_USEC;
+
+static DEFINE_MUTEX(sugov_global_lock);
+static int sugov_usage_count;
+
+/*
+ * Frequency that runs @util out of @max at target_load percent busy:
+ *
+ *   next_freq = max_freq * util / max * 100 / target_load
+ */
+static unsigned int get_next_freq(struct cpufreq_policy *policy,
+				  unsigned long util, unsigned long max)
+{
+	u64 freq;
+
+	if (!max)
+		return policy->max;
+
+	freq = (u64)policy->cpuinfo.max_freq * util * 100;
+	freq = div64_u64(freq, (u64)max * ACCESS_ONCE(target_load));
+
+	return clamp_t(u64, freq, policy->min, policy->max);
+}
+
+static bool sugov_rate_limited(struct sugov_policy *sg_policy, u64 time,
+			       unsigned int next_freq)
+{
+	s64 delta_ns = time - sg_policy->last_freq_update_time;
+
+	if (next_freq > sg_policy->next_freq)
+		return delta_ns < (s64)ACCESS_ONCE(up_rate_delay_ns);
+
+	return delta_ns < (s64)ACCESS_ONCE(down_rate_delay_ns);
+}
+
+static void sugov_update_commit(struct sugov_policy *sg_policy, u64 time,
+				unsigned int next_freq)
+{
+	if (sg_policy->next_freq == next_freq)
+		return;
+
+	if (sugov_rate_limited(sg_policy, time, next_freq))
+		return;
+
+	sg_policy->next_freq = next_freq;
+	sg_policy->last_freq_update_time = time;
+
+	if (!sg_policy->work_in_progress) {
+		sg_policy->work_in_progress = true;
+		irq_work_queue(&sg_policy->irq_work);
+	}
+}
+
+/* Demand of a cpu that has not reported for two windows is stale */
+static unsigned int sugov_next_freq_shared(struct sugov_cpu *sg_cpu, u64 time)
+{
+	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
+	struct cpufreq_policy *policy = sg_policy->policy;
+	unsigned long util = sg_cpu->util, max = sg_cpu->max;
+	unsigned int j;
+
+	for_each_cpu(j, policy->cpus) {
+		struct sugov_cpu *j_sg_cpu;
+		unsigned long j_util, j_max;
+		s64 delta_ns;
+
+		j_sg_cpu = &per_cpu(sugov_cpu, j);
+		if (j_sg_cpu == sg_cpu)
+			continue;
+
+		j_max = j_sg_cpu->max;
+		delta_ns = time - j_sg_cpu->last_update;
+		if (!j_max || delta_ns > 2 * (s64)j_max)
+			continue;
+
+		j_util = j_sg_cpu->util;
+		if (j_util * max > j_max * util) {
+			util = j_util;
+			max = j_max;
+		}
+	}
+
+	return get_next_freq(policy, util, max);
+}
+
+static void sugov_update(struct freq_update_hook *hook, u64 time,
+			 unsigned long util, unsigned long max)
+{
+	struct sugov_cpu *sg_cpu = container_of(hook, struct sugov_cpu, hook);
+	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
+	unsigned long flags;
+	unsigned int next_f;
+
+	raw_spin_lock_irqsave(&sg_policy->update_lock, flags);
+
+	sg_cpu->util = util;
+	sg_cpu->max = max;
+	sg_cpu->last_update = time;
+
+	if (policy_is_shared(sg_policy->policy))
+		next_f = sugov_next_freq_shared(sg_cpu, time);
+	else
+		next_f = get_next_freq(sg_policy->policy, util, max);
+
+	sugov_update_commit(sg_policy, time, next_f);
+
+	raw_spin_unlock_irqrestore(&sg_policy->update_lock, flags);
+}
+
+static void sugov_work(struct kthread_work *work)
+{
+	struct sugov_policy *sg_policy =
+			container_of(work, struct sugov_policy, work);
+	unsigned int next_freq;
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&sg_policy->update_lock, flags);
+	next_freq = sg_policy->next_freq;
+	sg_policy->work_in_progress = false;
+	raw_spin_unlock_irqrestore(&sg_policy->update_lock, flags);
+
+	mutex_lock(&sg_policy->work_lock);
+	if (next_freq != sg_policy->policy->cur)
+		__cpufreq_driver_target(sg_policy->policy, next_freq,
+					CPUFREQ_RELATION_L);
+	mutex_unlock(&sg_policy->work_lock);
+}
+
+static void sugov_irq_work(struct irq_work *irq_work)
+{
+	struct sugov_policy *sg_policy =
+			container_of(irq_work, struct sugov_policy, irq_work);
+
+	queue_kthread_work(&sg_policy->worker, &sg_policy->work);
+}
+
+/************************** sysfs interface ************************/
+
+static ssize_t show_target_load(struct kobject *kobj,
+				struct attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", target_load);
+}
+
+static ssize_t store_target_load(struct kobject *kobj,
+				 struct attribute *attr, const char *buf,
+				 size_t count)
+{
+	unsigned int val;
+
+	if (kstrtouint(buf, 0, &val) || !val || val > 100)
+		return -EINVAL;
+
+	target_load = val;
+	return count;
+}
+
+static ssize_t show_up_rate_limit_us(struct kobject *kobj,
+				     struct attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", up_rate_limit_us);
+}
+
+static ssize_t store_up_rate_limit_us(struct kobject *kobj,
+				      struct attribute *attr, const char *buf,
+				      size_t count)
+{
+	unsigned int val;
+
+	if (kstrtouint(buf, 0, &val))
+		return -EINVAL;
+
+	up_rate_limit_us = val;
+	up_rate_delay_ns = (u64)val * NSEC_PER_USEC;
+	return count;
+}
+
+static ssize_t show_down_rate_limit_us(struct kobject *kobj,
+				       struct attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", down_rate_limit_us);
+}
+
+static ssize_t store_down_rate_limit_us(struct kobject *kobj,
+					struct attribute *attr,
+					const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (kstrtouint(buf, 0, &val))
+		return -EINVAL;
+
+	down_rate_limit_us = val;
+	down_rate_delay_ns = (u64)val * NSEC_PER_USEC;
+	return count;
+}
+
+define_one_global_rw(target_load);
+define_one_global_rw(up_rate_limit_us);
+define_one_global_rw(down_rate_limit_us);
+
+static struct attribute *sugov_attributes[] = {
+	&target_load.attr,
+	&up_rate_limit_us.attr,
+	&down_rate_limit_us.attr,
+	NULL,
+};
+
+static struct attribute_group sugov_attr_group = {
+	.attrs = sugov_attributes,
+	.name = "schedutil",
+};
+
+/********************** cpufreq governor interface *********************/
+
+static int sugov_policy_init(struct cpufreq_policy *policy)
+{
+	struct sched_param param = { .sched_priority = MAX_USER_RT_PRIO / 2 };
+	struct sugov_policy *sg_policy;
+	int rc;
+
+	sg_policy = kzalloc(sizeof(*sg_policy), GFP_KERNEL);
+	if (!sg_policy)
+		return -ENOMEM;
+
+	sg_policy->policy = policy;
+	raw_spin_lock_init(&sg_policy->update_lock);
+	mutex_init(&sg_policy->work_lock);
+	init_irq_work(&sg_policy->irq_work, sugov_irq_work);
+	init_kthread_work(&sg_policy->work, sugov_work);
+	init_kthread_worker(&sg_policy->worker);
+
+	sg_policy->thread = kthread_create(kthread_worker_fn,
+					   &sg_policy->worker,
+					   "sugov:%d", policy->cpu);
+	if (IS_ERR(sg_policy->thread)) {
+		rc = PTR_ERR(sg_policy->thread);
+		goto free_sg_policy;
+	}
+	sched_setscheduler_nocheck(sg_policy->thread, SCHED_FIFO, &param);
+
+	mutex_lock(&sugov_global_lock);
+	if (!sugov_usage_count) {
+		rc = cpufreq_get_global_kobject();
+		if (!rc) {
+			rc = sysfs_create_group(cpufreq_global_kobject,
+						&sugov_attr_group);
+			if (rc)
+				cpufreq_put_global_kobject();
+		}
+		if (rc) {
+			mutex_unlock(&sugov_global_lock);
+			goto stop_thread;
+		}
+	}
+	sugov_usage_count++;
+	mutex_unlock(&sugov_global_lock);
+
+	policy->governor_data = sg_policy;
+	wake_up_process(sg_policy->thread);
+
+	return 0;
+
+stop_thread:
+	kthread_stop(sg_policy->thread);
+free_sg_policy:
+	kfree(sg_policy);
+	return rc;
+}
+
+static void sugov_policy_exit(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+
+	mutex_lock(&sugov_global_lock);
+	if (!--sugov_usage_count) {
+		sysfs_remove_group(cpufreq_global_kobject, &sugov_attr_group);
+		cpufreq_put_global_kobject();
+	}
+	mutex_unlock(&sugov_global_lock);
+
+	flush_kthread_worker(&sg_policy->worker);
+	kthread_stop(sg_policy->thread);
+
+	policy->governor_data = NULL;
+	kfree(sg_policy);
+}
+
+static void sugov_start(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	unsigned int cpu;
+
+	sg_policy->last_freq_update_time = 0;
+	sg_policy->next_freq = policy->cur;
+	sg_policy->work_in_progress = false;
+
+	for_each_cpu(cpu, policy->cpus) {
+		struct sugov_cpu *sg_cpu = &per_cpu(sugov_cpu, cpu);
+
+		memset(sg_cpu, 0, sizeof(*sg_cpu));
+		sg_cpu->sg_policy = sg_policy;
+		sg_cpu->hook.func = sugov_update;
+		sched_set_freq_update_hook(cpu, &sg_cpu->hook);
+	}
+}
+
+static void sugov_stop(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	unsigned int cpu;
+
+	for_each_cpu(cpu, policy->cpus)
+		sched_clear_freq_update_hook(cpu);
+
+	synchronize_sched();
+
+	irq_work_sync(&sg_policy->irq_work);
+	flush_kthread_work(&sg_policy->work);
+}
+
+static void sugov_limits(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+
+	mutex_lock(&sg_policy->work_lock);
+	if (policy->max < policy->cur)
+		__cpufreq_driver_target(policy, policy->max,
+					CPUFREQ_RELATION_H);
+	else if (policy->min > policy->cur)
+		__cpufreq_driver_target(policy, policy->min,
+					CPUFREQ_RELATION_L);
+	mutex_unlock(&sg_policy->work_lock);
+}
+
+static int cpufreq_governor_schedutil(struct cpufreq_policy *policy,
+				      unsigned int event)
+{
+	switch (event) {
+	case CPUFREQ_GOV_POLICY_INIT:
+		return sugov_policy_init(policy);
+	case CPUFREQ_GOV_POLICY_EXIT:
+		sugov_policy_exit(policy);
+		break;
+	case CPUFREQ_GOV_START:
+		sugov_start(policy);
+		break;
+	case CPUFREQ_GOV_STOP:
+		sugov_stop(policy);
+		break;
+	case CPUFREQ_GOV_LIMITS:
+		sugov_limits(policy);
+		break;
+	}
+	return 0;
+}
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHEDUTIL
+static
+#endif
+struct cpufreq_governor cpufreq_gov_schedutil = {
+	.name = "schedutil",
+	.governor = cpufreq_governor_schedutil,
+	.owner = THIS_MODULE,
+};
+
+static int __init cpufreq_schedutil_init(void)
+{
+	return cpufreq_register_governor(&cpufreq_gov_schedutil);
+}
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHEDUTIL
+fs_initcall(cpufreq_schedutil_init);
+#else
+module_init(cpufreq_schedutil_init);
+#endif
+
+MODULE_DESCRIPTION("'cpufreq_schedutil' - cpufreq governor driven by "
+		   "scheduler window statistics");
+MODULE_LICENSE("GPL");
@@ -50,6 +50,7 @@ struct cpu_data {
 	/* Per CPU data. */
 	bool	inited;
 	bool	online;
+	bool	isolated;
 	bool	rejected;
 	bool	is_busy;
 	bool    not_preferred;
@@ -265,7 +266,8 @@ static ssize_t show_cpus(struct cpu_data *state, char *buf)
 	list_for_each_entry(c, &state->lru, sib) {
 		count += snprintf(buf + count, PAGE_SIZE - count,
 					"CPU%u (%s)\n", c->cpu,
-					c->online ? "Online" : "Offline");
+					c->online ? "Online" :
+					c->isolated ? "Isolated" : "Offline");
 	}
 	spin_unlock_irqrestore(&state_lock, flags);
 	return count;
@@ -297,6 +299,8 @@ static ssize_t show_global_state(struct cpu_data *state, char *buf)
 					"\tCPU: %u\n", c->cpu);
 		count += snprintf(buf + count, PAGE_SIZE - count,
 					"\tOnline: %u\n", c->online);
+		count += snprintf(buf + count, PAGE_SIZE - count,
+					"\tIsolated: %u\n", c->isolated);
 		count += snprintf(buf + count, PAGE_SIZE - count,
 					"\tRejected: %u\n", c->rejected);
 		count += snprintf(buf + count, PAGE_SIZE - count,
@@ -630,6 +634,14 @@ static int core_ctl_set_busy(unsigned int cpu, unsigned int busy)
 
 /* ========================= core count enforcement ==================== */
 
+/*
+ * Isolating a core keeps it online but idle, which takes a fraction of
+ * the time of a hotplug cycle and leaves per cpu state alone. Isolated
+ * cores count as offline for every core count decision below.
+ */
+static bool isolate_cores = true;
+module_param(isolate_cores, bool, 0644);
+
 /*
  * If current thread is hotplug thread, don't attempt to wake up
  * itself or other hotplug threads because it will deadlock. Instead,
@@ -697,6 +709,73 @@ static void update_lru(struct cpu_data *f)
 	spin_unlock_irqrestore(&pending_lru_lock, flags);
 }
 
+static void core_ctl_isolate_core(struct cpu_data *c)
+{
+	struct cpu_data *f = &per_cpu(cpu_state, c->first_cpu);
+	unsigned long flags;
+
+	if (sched_isolate_cpu(c->cpu)) {
+		pr_debug("Unable to isolate CPU%u\n", c->cpu);
+		return;
+	}
+
+	spin_lock_irqsave(&state_lock, flags);
+	c->isolated = true;
+	c->online = false;
+	c->busy = 0;
+	f->online_cpus--;
+	spin_unlock_irqrestore(&state_lock, flags);
+
+	/* lru_lock is held, so the LRU move is deferred like for hotplug */
+	add_to_pending_lru(c);
+}
+
+static void core_ctl_unisolate_core(struct cpu_data *c)
+{
+	struct cpu_data *f = &per_cpu(cpu_state, c->first_cpu);
+	unsigned long flags;
+
+	if (sched_unisolate_cpu(c->cpu)) {
+		pr_debug("Unable to unisolate CPU%u\n", c->cpu);
+		return;
+	}
+
+	spin_lock_irqsave(&state_lock, flags);
+	c->isolated = false;
+	c->online = true;
+	f->online_cpus++;
+	spin_unlock_irqrestore(&state_lock, flags);
+
+	add_to_pending_lru(c);
+}
+
+static void __ref core_ctl_offline_core(struct cpu_data *c)
+{
+	if (isolate_cores) {
+		pr_debug("Trying to isolate CPU%u\n", c->cpu);
+		core_ctl_isolate_core(c);
+		return;
+	}
+
+	pr_debug("Trying to Offline CPU%u\n", c->cpu);
+	if (cpu_down(c->cpu))
+		pr_debug("Unable to Offline CPU%u\n", c->cpu);
+}
+
+static void __ref core_ctl_bring_up_core(struct cpu_data *c)
+{
+	/* An isolated core comes back the same way, whatever the mode. */
+	if (c->isolated) {
+		pr_debug("Trying to unisolate CPU%u\n", c->cpu);
+		core_ctl_unisolate_core(c);
+		return;
+	}
+
+	pr_debug("Trying to Online CPU%u\n", c->cpu);
+	if (core_ctl_online_core(c->cpu))
+		pr_debug("Unable to Online CPU%u\n", c->cpu);
+}
+
 static void __ref do_hotplug(struct cpu_data *f)
 {
 	unsigned int need;
@@ -718,9 +797,7 @@ static void __ref do_hotplug(struct cpu_data *f)
 			if (c->is_busy)
 				continue;
 
-			pr_debug("Trying to Offline CPU%u\n", c->cpu);
-			if (cpu_down(c->cpu))
-				pr_debug("Unable to Offline CPU%u\n", c->cpu);
+			core_ctl_offline_core(c);
 		}
 
 		/*
@@ -737,9 +814,7 @@ static void __ref do_hotplug(struct cpu_data *f)
 			if (f->online_cpus <= f->max_cpus)
 				break;
 
-			pr_debug("Trying to Offline CPU%u\n", c->cpu);
-			if (cpu_down(c->cpu))
-				pr_debug("Unable to Offline CPU%u\n", c->cpu);
+			core_ctl_offline_core(c);
 		}
 	} else if (f->online_cpus < need) {
 		list_for_each_entry_safe(c, tmp, &f->lru, sib) {
@@ -748,9 +823,7 @@ static void __ref do_hotplug(struct cpu_data *f)
 			if (f->online_cpus == need)
 				break;
 
-			pr_debug("Trying to Online CPU%u\n", c->cpu);
-			if (core_ctl_online_core(c->cpu))
-				pr_debug("Unable to Online CPU%u\n", c->cpu);
+			core_ctl_bring_up_core(c);
 		}
 
 		if (f->online_cpus == need)
@@ -763,9 +836,7 @@ static void __ref do_hotplug(struct cpu_data *f)
 			if (f->online_cpus == need)
 				break;
 
-			pr_debug("Trying to Online CPU%u\n", c->cpu);
-			if (core_ctl_online_core(c->cpu))
-				pr_debug("Unable to Online CPU%u\n", c->cpu);
+			core_ctl_bring_up_core(c);
 		}
 	}
 done:
@@ -900,6 +971,17 @@ static int __ref cpu_callback(struct notifier_block *nfb,
 
 	case CPU_UP_CANCELED:
 
+		/*
+		 * An isolated CPU that goes offline anyway drops its
+		 * isolation; the scheduler clears it at CPU_DEAD. It was
+		 * already out of the online count.
+		 */
+		if (state->isolated) {
+			state->isolated = false;
+			state->online = true;
+			f->online_cpus++;
+		}
+
 		/* If online state of CPU somehow got out of sync, fix it. */
 		if (!state->online) {
 			f->online_cpus++;
@@ -97,10 +97,16 @@ int FsMountVol(struct super_block *sb)
 	sm_P(&z_sem);
 
 	err = buf_init(sb);
-	if (!err)
+	if (!err) {
 		err = ffsMountVol(sb);
-	else
+		if (err) {
+			FAT_release_all(sb);
+			buf_release_all(sb);
+			buf_shutdown(sb);
+		}
+	} else {
 		buf_shutdown(sb);
+	}
 
 	sm_V(&z_sem);
 
@@ -391,20 +397,20 @@ int FsWriteStat(struct inode *inode, DIR_ENTRY_T *info)
 } /* end of FsWriteStat */
 
 /* FsMapCluster : return the cluster number in the given cluster offset */
-int FsMapCluster(struct inode *inode, s32 clu_offset, u32 *clu)
+int FsMapCluster(struct inode *inode, s32 clu_offset, u32 *clu, s32 *num_clu)
 {
 	int err;
 	struct super_block *sb = inode->i_sb;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
 	/* check the validity of pointer parameters */
-	if (clu == NULL)
+	if ((clu == NULL) || (num_clu == NULL))
 		return FFS_ERROR;
 
 	/* acquire the lock for file system critical section */
 	sm_P(&p_fs->v_sem);
 
-	err = ffsMapCluster(inode, clu_offset, clu);
+	err = ffsMapCluster(inode, clu_offset, clu, num_clu);
 
 	/* release the lock for file system critical section */
 	sm_V(&p_fs->v_sem);
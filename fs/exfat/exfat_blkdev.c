@@ -34,6 +34,7 @@
 
 #include <linux/blkdev.h>
 #include <linux/log2.h>
+#include <linux/buffer_head.h>
 #include "exfat_config.h"
 #include "exfat_blkdev.h"
 #include "exfat_data.h"
@@ -126,6 +127,22 @@ s32 bdev_read(struct super_block *sb, u32 secno, struct buffer_head **bh, u32 nu
 	return FFS_MEDIAERR;
 }
 
+void bdev_readahead(struct super_block *sb, u32 secno, u32 num_secs)
+{
+	u32 i;
+	struct blk_plug plug;
+	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
+
+	if (!p_bd->opened)
+		return;
+
+	/* plug so that the per-sector requests are merged into large ones */
+	blk_start_plug(&plug);
+	for (i = 0; i < num_secs; i++)
+		__breadahead(sb->s_bdev, secno + i, p_bd->sector_size);
+	blk_finish_plug(&plug);
+}
+
 s32 bdev_write(struct super_block *sb, u32 secno, struct buffer_head *bh, u32 num_secs, s32 sync)
 {
 	s32 count;
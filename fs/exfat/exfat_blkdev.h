@@ -67,6 +67,7 @@ s32 bdev_shutdown(void);
 s32 bdev_open(struct super_block *sb);
 s32 bdev_close(struct super_block *sb);
 s32 bdev_read(struct super_block *sb, u32 secno, struct buffer_head **bh, u32 num_secs, s32 read);
+void bdev_readahead(struct super_block *sb, u32 secno, u32 num_secs);
 s32 bdev_write(struct super_block *sb, u32 secno, struct buffer_head *bh, u32 num_secs, s32 sync);
 s32 bdev_sync(struct super_block *sb);
 
@@ -33,8 +33,14 @@
 /*                                                                      */
 /************************************************************************/
 
+#include <linux/blkdev.h>
+#include <linux/buffer_head.h>
+#include <linux/log2.h>
+#include <linux/slab.h>
+
 #include "exfat_config.h"
 #include "exfat_data.h"
+#include "exfat_oal.h"
 
 #include "exfat_cache.h"
 #include "exfat_super.h"
@@ -44,9 +50,6 @@
 /*  Global Variable Definitions                                         */
 /*----------------------------------------------------------------------*/
 
-#define sm_P(s)
-#define sm_V(s)
-
 static s32 __FAT_read(struct super_block *sb, u32 loc, u32 *content);
 static s32 __FAT_write(struct super_block *sb, u32 loc, u32 content);
 
@@ -62,6 +65,10 @@ static BUF_CACHE_T *buf_cache_get(struct super_block *sb, u32 sec);
 static void buf_cache_insert_hash(struct super_block *sb, BUF_CACHE_T *bp);
 static void buf_cache_remove_hash(BUF_CACHE_T *bp);
 
+static void cache_mark_dirty(struct super_block *sb, BUF_CACHE_T *bp);
+static void cache_flush_entry(struct super_block *sb, BUF_CACHE_T *bp);
+static void cache_sync_list(struct super_block *sb, BUF_CACHE_T *list);
+
 static void push_to_mru(BUF_CACHE_T *bp, BUF_CACHE_T *list);
 static void push_to_lru(BUF_CACHE_T *bp, BUF_CACHE_T *list);
 static void move_to_mru(BUF_CACHE_T *bp, BUF_CACHE_T *list);
@@ -71,16 +78,47 @@ static void move_to_lru(BUF_CACHE_T *bp, BUF_CACHE_T *list);
 /*  Cache Initialization Functions                                      */
 /*======================================================================*/
 
+/* scale a cache size with the size of the underlying volume */
+static u32 cache_size_for_volume(struct super_block *sb, u32 min_size, u32 max_size)
+{
+	u32 size = min_size;
+	u64 gb = i_size_read(sb->s_bdev->bd_inode) >> 30;
+
+	while ((gb > 1) && (size < max_size)) {
+		size <<= 1;
+		gb >>= 1;
+	}
+
+	return size;
+} /* end of cache_size_for_volume */
+
 s32 buf_init(struct super_block *sb)
 {
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
 	int i;
 
+	sm_init(&p_fs->f_sem);
+	sm_init(&p_fs->b_sem);
+
+	p_fs->FAT_cache_size = cache_size_for_volume(sb, FAT_CACHE_SIZE, FAT_CACHE_MAX_SIZE);
+	p_fs->FAT_cache_hash_size = p_fs->FAT_cache_size / CACHE_HASH_DEPTH;
+	p_fs->buf_cache_size = cache_size_for_volume(sb, BUF_CACHE_SIZE, BUF_CACHE_MAX_SIZE);
+	p_fs->buf_cache_hash_size = p_fs->buf_cache_size / CACHE_HASH_DEPTH;
+
+	p_fs->FAT_cache_array = kcalloc(p_fs->FAT_cache_size, sizeof(BUF_CACHE_T), GFP_KERNEL);
+	p_fs->FAT_cache_hash_list = kcalloc(p_fs->FAT_cache_hash_size, sizeof(BUF_CACHE_T), GFP_KERNEL);
+	p_fs->buf_cache_array = kcalloc(p_fs->buf_cache_size, sizeof(BUF_CACHE_T), GFP_KERNEL);
+	p_fs->buf_cache_hash_list = kcalloc(p_fs->buf_cache_hash_size, sizeof(BUF_CACHE_T), GFP_KERNEL);
+
+	if (!p_fs->FAT_cache_array || !p_fs->FAT_cache_hash_list ||
+		!p_fs->buf_cache_array || !p_fs->buf_cache_hash_list)
+		return FFS_MEMORYERR;
+
 	/* LRU list */
 	p_fs->FAT_cache_lru_list.next = p_fs->FAT_cache_lru_list.prev = &p_fs->FAT_cache_lru_list;
 
-	for (i = 0; i < FAT_CACHE_SIZE; i++) {
+	for (i = 0; i < p_fs->FAT_cache_size; i++) {
 		p_fs->FAT_cache_array[i].drv = -1;
 		p_fs->FAT_cache_array[i].sec = ~0;
 		p_fs->FAT_cache_array[i].flag = 0;
@@ -91,7 +129,7 @@ s32 buf_init(struct super_block *sb)
 
 	p_fs->buf_cache_lru_list.next = p_fs->buf_cache_lru_list.prev = &p_fs->buf_cache_lru_list;
 
-	for (i = 0; i < BUF_CACHE_SIZE; i++) {
+	for (i = 0; i < p_fs->buf_cache_size; i++) {
 		p_fs->buf_cache_array[i].drv = -1;
 		p_fs->buf_cache_array[i].sec = ~0;
 		p_fs->buf_cache_array[i].flag = 0;
@@ -101,22 +139,22 @@ s32 buf_init(struct super_block *sb)
 	}
 
 	/* HASH list */
-	for (i = 0; i < FAT_CACHE_HASH_SIZE; i++) {
+	for (i = 0; i < p_fs->FAT_cache_hash_size; i++) {
 		p_fs->FAT_cache_hash_list[i].drv = -1;
 		p_fs->FAT_cache_hash_list[i].sec = ~0;
 		p_fs->FAT_cache_hash_list[i].hash_next = p_fs->FAT_cache_hash_list[i].hash_prev = &(p_fs->FAT_cache_hash_list[i]);
 	}
 
-	for (i = 0; i < FAT_CACHE_SIZE; i++)
+	for (i = 0; i < p_fs->FAT_cache_size; i++)
 		FAT_cache_insert_hash(sb, &(p_fs->FAT_cache_array[i]));
 
-	for (i = 0; i < BUF_CACHE_HASH_SIZE; i++) {
+	for (i = 0; i < p_fs->buf_cache_hash_size; i++) {
 		p_fs->buf_cache_hash_list[i].drv = -1;
 		p_fs->buf_cache_hash_list[i].sec = ~0;
 		p_fs->buf_cache_hash_list[i].hash_next = p_fs->buf_cache_hash_list[i].hash_prev = &(p_fs->buf_cache_hash_list[i]);
 	}
 
-	for (i = 0; i < BUF_CACHE_SIZE; i++)
+	for (i = 0; i < p_fs->buf_cache_size; i++)
 		buf_cache_insert_hash(sb, &(p_fs->buf_cache_array[i]));
 
 	return FFS_SUCCESS;
@@ -124,6 +162,18 @@ s32 buf_init(struct super_block *sb)
 
 s32 buf_shutdown(struct super_block *sb)
 {
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	kfree(p_fs->FAT_cache_array);
+	kfree(p_fs->FAT_cache_hash_list);
+	kfree(p_fs->buf_cache_array);
+	kfree(p_fs->buf_cache_hash_list);
+
+	p_fs->FAT_cache_array = NULL;
+	p_fs->FAT_cache_hash_list = NULL;
+	p_fs->buf_cache_array = NULL;
+	p_fs->buf_cache_hash_list = NULL;
+
 	return FFS_SUCCESS;
 } /* end of buf_shutdown */
 
@@ -139,12 +189,13 @@ s32 buf_shutdown(struct super_block *sb)
 s32 FAT_read(struct super_block *sb, u32 loc, u32 *content)
 {
 	s32 ret;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&f_sem);
+	sm_P(&p_fs->f_sem);
 
 	ret = __FAT_read(sb, loc, content);
 
-	sm_V(&f_sem);
+	sm_V(&p_fs->f_sem);
 
 	return ret;
 } /* end of FAT_read */
@@ -152,12 +203,13 @@ s32 FAT_read(struct super_block *sb, u32 loc, u32 *content)
 s32 FAT_write(struct super_block *sb, u32 loc, u32 content)
 {
 	s32 ret;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&f_sem);
+	sm_P(&p_fs->f_sem);
 
 	ret = __FAT_write(sb, loc, content);
 
-	sm_V(&f_sem);
+	sm_V(&p_fs->f_sem);
 
 	return ret;
 } /* end of FAT_write */
@@ -393,6 +445,7 @@ u8 *FAT_getblk(struct super_block *sb, u32 sec)
 	}
 
 	bp = FAT_cache_get(sb, sec);
+	cache_flush_entry(sb, bp);
 
 	FAT_cache_remove_hash(bp);
 
@@ -416,13 +469,15 @@ u8 *FAT_getblk(struct super_block *sb, u32 sec)
 	return bp->buf_bh->b_data;
 } /* end of FAT_getblk */
 
+/* the sector is only marked dirty in the cache here; it is handed to the
+ * buffer layer once per flush instead of once per FAT entry update */
 void FAT_modify(struct super_block *sb, u32 sec)
 {
 	BUF_CACHE_T *bp;
 
 	bp = FAT_cache_find(sb, sec);
 	if (bp != NULL)
-		sector_write(sb, sec, bp->buf_bh, 0);
+		cache_mark_dirty(sb, bp);
 } /* end of FAT_modify */
 
 void FAT_release_all(struct super_block *sb)
@@ -430,11 +485,13 @@ void FAT_release_all(struct super_block *sb)
 	BUF_CACHE_T *bp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&f_sem);
+	sm_P(&p_fs->f_sem);
 
 	bp = p_fs->FAT_cache_lru_list.next;
 	while (bp != &p_fs->FAT_cache_lru_list) {
 		if (bp->drv == p_fs->drv) {
+			cache_flush_entry(sb, bp);
+
 			bp->drv = -1;
 			bp->sec = ~0;
 			bp->flag = 0;
@@ -447,26 +504,34 @@ void FAT_release_all(struct super_block *sb)
 		bp = bp->next;
 	}
 
-	sm_V(&f_sem);
+	sm_V(&p_fs->f_sem);
 } /* end of FAT_release_all */
 
-void FAT_sync(struct super_block *sb)
+/* hand the dirty FAT sectors to the buffer layer without waiting on I/O */
+void FAT_flush(struct super_block *sb)
 {
 	BUF_CACHE_T *bp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&f_sem);
+	sm_P(&p_fs->f_sem);
 
 	bp = p_fs->FAT_cache_lru_list.next;
 	while (bp != &p_fs->FAT_cache_lru_list) {
-		if ((bp->drv == p_fs->drv) && (bp->flag & DIRTYBIT)) {
-			sync_dirty_buffer(bp->buf_bh);
-			bp->flag &= ~(DIRTYBIT);
-		}
+		if (bp->drv == p_fs->drv)
+			cache_flush_entry(sb, bp);
 		bp = bp->next;
 	}
 
-	sm_V(&f_sem);
+	sm_V(&p_fs->f_sem);
+} /* end of FAT_flush */
+
+void FAT_sync(struct super_block *sb)
+{
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	sm_P(&p_fs->f_sem);
+	cache_sync_list(sb, &p_fs->FAT_cache_lru_list);
+	sm_V(&p_fs->f_sem);
 } /* end of FAT_sync */
 
 static BUF_CACHE_T *FAT_cache_find(struct super_block *sb, u32 sec)
@@ -475,7 +540,7 @@ static BUF_CACHE_T *FAT_cache_find(struct super_block *sb, u32 sec)
 	BUF_CACHE_T *bp, *hp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	off = (sec + (sec >> p_fs->sectors_per_clu_bits)) & (FAT_CACHE_HASH_SIZE - 1);
+	off = (sec + (sec >> p_fs->sectors_per_clu_bits)) & (p_fs->FAT_cache_hash_size - 1);
 
 	hp = &(p_fs->FAT_cache_hash_list[off]);
 	for (bp = hp->hash_next; bp != hp; bp = bp->hash_next) {
@@ -510,7 +575,7 @@ static void FAT_cache_insert_hash(struct super_block *sb, BUF_CACHE_T *bp)
 	FS_INFO_T *p_fs;
 
 	p_fs = &(EXFAT_SB(sb)->fs_info);
-	off = (bp->sec + (bp->sec >> p_fs->sectors_per_clu_bits)) & (FAT_CACHE_HASH_SIZE-1);
+	off = (bp->sec + (bp->sec >> p_fs->sectors_per_clu_bits)) & (p_fs->FAT_cache_hash_size - 1);
 
 	hp = &(p_fs->FAT_cache_hash_list[off]);
 	bp->hash_next = hp->hash_next;
@@ -532,12 +597,13 @@ static void FAT_cache_remove_hash(BUF_CACHE_T *bp)
 u8 *buf_getblk(struct super_block *sb, u32 sec)
 {
 	u8 *buf;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&b_sem);
+	sm_P(&p_fs->b_sem);
 
 	buf = __buf_getblk(sb, sec);
 
-	sm_V(&b_sem);
+	sm_V(&p_fs->b_sem);
 
 	return buf;
 } /* end of buf_getblk */
@@ -554,6 +620,7 @@ static u8 *__buf_getblk(struct super_block *sb, u32 sec)
 	}
 
 	bp = buf_cache_get(sb, sec);
+	cache_flush_entry(sb, bp);
 
 	buf_cache_remove_hash(bp);
 
@@ -581,23 +648,25 @@ static u8 *__buf_getblk(struct super_block *sb, u32 sec)
 void buf_modify(struct super_block *sb, u32 sec)
 {
 	BUF_CACHE_T *bp;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&b_sem);
+	sm_P(&p_fs->b_sem);
 
 	bp = buf_cache_find(sb, sec);
 	if (likely(bp != NULL))
-		sector_write(sb, sec, bp->buf_bh, 0);
+		cache_mark_dirty(sb, bp);
 
 	WARN(!bp, "[EXFAT] failed to find buffer_cache(sector:%u).\n", sec);
 
-	sm_V(&b_sem);
+	sm_V(&p_fs->b_sem);
 } /* end of buf_modify */
 
 void buf_lock(struct super_block *sb, u32 sec)
 {
 	BUF_CACHE_T *bp;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&b_sem);
+	sm_P(&p_fs->b_sem);
 
 	bp = buf_cache_find(sb, sec);
 	if (likely(bp != NULL))
@@ -605,14 +674,15 @@ void buf_lock(struct super_block *sb, u32 sec)
 
 	WARN(!bp, "[EXFAT] failed to find buffer_cache(sector:%u).\n", sec);
 
-	sm_V(&b_sem);
+	sm_V(&p_fs->b_sem);
 } /* end of buf_lock */
 
 void buf_unlock(struct super_block *sb, u32 sec)
 {
 	BUF_CACHE_T *bp;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&b_sem);
+	sm_P(&p_fs->b_sem);
 
 	bp = buf_cache_find(sb, sec);
 	if (likely(bp != NULL))
@@ -620,7 +690,7 @@ void buf_unlock(struct super_block *sb, u32 sec)
 
 	WARN(!bp, "[EXFAT] failed to find buffer_cache(sector:%u).\n", sec);
 
-	sm_V(&b_sem);
+	sm_V(&p_fs->b_sem);
 } /* end of buf_unlock */
 
 void buf_release(struct super_block *sb, u32 sec)
@@ -628,10 +698,12 @@ void buf_release(struct super_block *sb, u32 sec)
 	BUF_CACHE_T *bp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&b_sem);
+	sm_P(&p_fs->b_sem);
 
 	bp = buf_cache_find(sb, sec);
 	if (likely(bp != NULL)) {
+		cache_flush_entry(sb, bp);
+
 		bp->drv = -1;
 		bp->sec = ~0;
 		bp->flag = 0;
@@ -644,7 +716,7 @@ void buf_release(struct super_block *sb, u32 sec)
 		move_to_lru(bp, &p_fs->buf_cache_lru_list);
 	}
 
-	sm_V(&b_sem);
+	sm_V(&p_fs->b_sem);
 } /* end of buf_release */
 
 void buf_release_all(struct super_block *sb)
@@ -652,11 +724,13 @@ void buf_release_all(struct super_block *sb)
 	BUF_CACHE_T *bp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&b_sem);
+	sm_P(&p_fs->b_sem);
 
 	bp = p_fs->buf_cache_lru_list.next;
 	while (bp != &p_fs->buf_cache_lru_list) {
 		if (bp->drv == p_fs->drv) {
+			cache_flush_entry(sb, bp);
+
 			bp->drv = -1;
 			bp->sec = ~0;
 			bp->flag = 0;
@@ -669,26 +743,33 @@ void buf_release_all(struct super_block *sb)
 		bp = bp->next;
 	}
 
-	sm_V(&b_sem);
+	sm_V(&p_fs->b_sem);
 } /* end of buf_release_all */
 
-void buf_sync(struct super_block *sb)
+void buf_flush(struct super_block *sb)
 {
 	BUF_CACHE_T *bp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	sm_P(&b_sem);
+	sm_P(&p_fs->b_sem);
 
 	bp = p_fs->buf_cache_lru_list.next;
 	while (bp != &p_fs->buf_cache_lru_list) {
-		if ((bp->drv == p_fs->drv) && (bp->flag & DIRTYBIT)) {
-			sync_dirty_buffer(bp->buf_bh);
-			bp->flag &= ~(DIRTYBIT);
-		}
+		if (bp->drv == p_fs->drv)
+			cache_flush_entry(sb, bp);
 		bp = bp->next;
 	}
 
-	sm_V(&b_sem);
+	sm_V(&p_fs->b_sem);
+} /* end of buf_flush */
+
+void buf_sync(struct super_block *sb)
+{
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	sm_P(&p_fs->b_sem);
+	cache_sync_list(sb, &p_fs->buf_cache_lru_list);
+	sm_V(&p_fs->b_sem);
 } /* end of buf_sync */
 
 static BUF_CACHE_T *buf_cache_find(struct super_block *sb, u32 sec)
@@ -697,7 +778,7 @@ static BUF_CACHE_T *buf_cache_find(struct super_block *sb, u32 sec)
 	BUF_CACHE_T *bp, *hp;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 
-	off = (sec + (sec >> p_fs->sectors_per_clu_bits)) & (BUF_CACHE_HASH_SIZE - 1);
+	off = (sec + (sec >> p_fs->sectors_per_clu_bits)) & (p_fs->buf_cache_hash_size - 1);
 
 	hp = &(p_fs->buf_cache_hash_list[off]);
 	for (bp = hp->hash_next; bp != hp; bp = bp->hash_next) {
@@ -730,7 +811,7 @@ static void buf_cache_insert_hash(struct super_block *sb, BUF_CACHE_T *bp)
 	FS_INFO_T *p_fs;
 
 	p_fs = &(EXFAT_SB(sb)->fs_info);
-	off = (bp->sec + (bp->sec >> p_fs->sectors_per_clu_bits)) & (BUF_CACHE_HASH_SIZE-1);
+	off = (bp->sec + (bp->sec >> p_fs->sectors_per_clu_bits)) & (p_fs->buf_cache_hash_size - 1);
 
 	hp = &(p_fs->buf_cache_hash_list[off]);
 	bp->hash_next = hp->hash_next;
@@ -749,6 +830,55 @@ static void buf_cache_remove_hash(BUF_CACHE_T *bp)
 /*  Local Function Definitions                                          */
 /*======================================================================*/
 
+/* a dirty cache entry also dirties the superblock, so that sync_fs()
+ * flushes it even if the operation that modified it never reached its
+ * closing fs_sync() */
+static void cache_mark_dirty(struct super_block *sb, BUF_CACHE_T *bp)
+{
+	bp->flag |= DIRTYBIT;
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,7,0)
+	sb->s_dirt = 1;
+#else
+	EXFAT_SB(sb)->s_dirt = 1;
+#endif
+} /* end of cache_mark_dirty */
+
+static void cache_flush_entry(struct super_block *sb, BUF_CACHE_T *bp)
+{
+	if (!(bp->flag & DIRTYBIT))
+		return;
+
+	if (bp->buf_bh)
+		sector_write(sb, bp->sec, bp->buf_bh, 0);
+	bp->flag &= ~(DIRTYBIT);
+} /* end of cache_flush_entry */
+
+/* write out every dirty sector of a cache in one plugged batch, so that
+ * adjacent sectors are merged, and only then wait for the writes */
+static void cache_sync_list(struct super_block *sb, BUF_CACHE_T *list)
+{
+	BUF_CACHE_T *bp;
+	struct blk_plug plug;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	blk_start_plug(&plug);
+	for (bp = list->next; bp != list; bp = bp->next) {
+		if ((bp->drv != p_fs->drv) || !bp->buf_bh)
+			continue;
+
+		cache_flush_entry(sb, bp);
+		if (buffer_dirty(bp->buf_bh))
+			write_dirty_buffer(bp->buf_bh, WRITE);
+	}
+	blk_finish_plug(&plug);
+
+	for (bp = list->next; bp != list; bp = bp->next) {
+		if ((bp->drv == p_fs->drv) && bp->buf_bh)
+			wait_on_buffer(bp->buf_bh);
+	}
+} /* end of cache_sync_list */
+
 static void push_to_mru(BUF_CACHE_T *bp, BUF_CACHE_T *list)
 {
 	bp->next = list->next;
@@ -73,6 +73,7 @@ s32  FAT_write(struct super_block *sb, u32 loc, u32 content);
 u8 *FAT_getblk(struct super_block *sb, u32 sec);
 void   FAT_modify(struct super_block *sb, u32 sec);
 void   FAT_release_all(struct super_block *sb);
+void   FAT_flush(struct super_block *sb);
 void   FAT_sync(struct super_block *sb);
 u8 *buf_getblk(struct super_block *sb, u32 sec);
 void   buf_modify(struct super_block *sb, u32 sec);
@@ -80,6 +81,7 @@ void   buf_lock(struct super_block *sb, u32 sec);
 void   buf_unlock(struct super_block *sb, u32 sec);
 void   buf_release(struct super_block *sb, u32 sec);
 void   buf_release_all(struct super_block *sb);
+void   buf_flush(struct super_block *sb);
 void   buf_sync(struct super_block *sb);
 
 #endif /* _EXFAT_CACHE_H */
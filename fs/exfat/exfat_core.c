@@ -44,6 +44,8 @@
 #include <linux/version.h>
 #include <linux/param.h>
 #include <linux/log2.h>
+#include <linux/bitops.h>
+#include <linux/string.h>
 
 #include "exfat_bitmap.h"
 #include "exfat_config.h"
@@ -89,38 +91,6 @@ static char *reserved_names[] = {
 	NULL
 };
 
-static u8 free_bit[] = {
-	0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, /*   0 ~  19 */
-	0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 5, 0, 1, 0, 2, 0, 1, 0, 3, /*  20 ~  39 */
-	0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, /*  40 ~  59 */
-	0, 1, 0, 6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, /*  60 ~  79 */
-	0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 5, 0, 1, 0, 2, /*  80 ~  99 */
-	0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, /* 100 ~ 119 */
-	0, 1, 0, 2, 0, 1, 0, 7, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, /* 120 ~ 139 */
-	0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 5, /* 140 ~ 159 */
-	0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, /* 160 ~ 179 */
-	0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 6, 0, 1, 0, 2, 0, 1, 0, 3, /* 180 ~ 199 */
-	0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, /* 200 ~ 219 */
-	0, 1, 0, 5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, /* 220 ~ 239 */
-	0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0                 /* 240 ~ 254 */
-};
-
-static u8 used_bit[] = {
-	0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3, /*   0 ~  19 */
-	2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 1, 2, 2, 3, 2, 3, 3, 4, /*  20 ~  39 */
-	2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, /*  40 ~  59 */
-	4, 5, 5, 6, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, /*  60 ~  79 */
-	2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, /*  80 ~  99 */
-	3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, /* 100 ~ 119 */
-	4, 5, 5, 6, 5, 6, 6, 7, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, /* 120 ~ 139 */
-	3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, /* 140 ~ 159 */
-	2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, /* 160 ~ 179 */
-	4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 2, 3, 3, 4, 3, 4, 4, 5, /* 180 ~ 199 */
-	3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, /* 200 ~ 219 */
-	5, 6, 6, 7, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, /* 220 ~ 239 */
-	4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8              /* 240 ~ 255 */
-};
-
 /*======================================================================*/
 /*  Global Function Definitions                                         */
 /*======================================================================*/
@@ -1276,15 +1246,49 @@ s32 ffsSetStat(struct inode *inode, DIR_ENTRY_T *info)
 		release_entry_set(es);
 	}
 
+#ifdef CONFIG_EXFAT_DELAYED_SYNC
+	fs_sync(sb, 0);
+	fs_set_vol_flags(sb, VOL_CLEAN);
+#endif
+
 	if (p_fs->dev_ejected)
 		return FFS_MEDIAERR;
 
 	return FFS_SUCCESS;
 } /* end of ffsSetStat */
 
-s32 ffsMapCluster(struct inode *inode, s32 clu_offset, u32 *clu)
+/* *num_clu holds how many clusters the caller is about to write from
+ * clu_offset on; if they have to be allocated, they are allocated as one
+ * request. On return it holds the number of contiguous clusters mapped
+ * from *clu on (1 unless a contiguous run was just allocated). */
+/* place a chain extension of fewer clusters than the write needs in a
+ * free run of num_goal clusters when it cannot be extended in place, so
+ * that the clusters allocated next for the same write stay contiguous */
+static void exfat_alloc_goal(struct super_block *sb, CHAIN_T *p_chain, s32 num_goal)
 {
-	s32 num_clusters, num_alloced, modified = FALSE;
+	u32 hint_clu, run_clu;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	hint_clu = p_chain->dir;
+	if (hint_clu == CLUSTER_32(~0))
+		hint_clu = p_fs->clu_srch_ptr;
+	else if ((hint_clu >= p_fs->num_clusters) ||
+			 (test_alloc_bitmap(sb, hint_clu-2) == hint_clu))
+		return;
+
+	run_clu = find_free_run_in_bitmap(sb, hint_clu-2, num_goal);
+	if (run_clu == CLUSTER_32(~0))
+		return;
+
+	if (p_chain->dir != CLUSTER_32(~0))
+		p_chain->flags = 0x01;
+	p_chain->dir = run_clu;
+} /* end of exfat_alloc_goal */
+
+s32 ffsMapCluster(struct inode *inode, s32 clu_offset, u32 *clu, s32 *num_clu)
+{
+	s32 num_clusters, num_alloc, num_alloced, num_goal, modified = FALSE;
+	s64 write_end;
 	u32 last_clu, sector = 0;
 	CHAIN_T new_clu;
 	DENTRY_T *ep;
@@ -1302,6 +1306,9 @@ s32 ffsMapCluster(struct inode *inode, s32 clu_offset, u32 *clu)
 
 	*clu = last_clu = fid->start_clu;
 
+	num_alloc = (*num_clu > 1) ? *num_clu : 1;
+	*num_clu = 1;
+
 	if (fid->flags == 0x03) {
 		if ((clu_offset > 0) && (*clu != CLUSTER_32(~0))) {
 			last_clu += clu_offset - 1;
@@ -1334,8 +1341,18 @@ s32 ffsMapCluster(struct inode *inode, s32 clu_offset, u32 *clu)
 		new_clu.size = 0;
 		new_clu.flags = fid->flags;
 
-		/* (1) allocate a cluster */
-		num_alloced = p_fs->fs_func->alloc_cluster(sb, 1, &new_clu);
+		/* buffered writes map a block at a time: aim for the whole write */
+		num_goal = num_alloc;
+		write_end = EXFAT_I(inode)->i_write_end;
+		if (write_end > fid->rwoffset)
+			num_goal = (s32) min_t(s64, INT_MAX,
+					((write_end - fid->rwoffset - 1) >> p_fs->cluster_size_bits) + 1);
+
+		if ((p_fs->vol_type == EXFAT) && (num_goal > num_alloc))
+			exfat_alloc_goal(sb, &new_clu, num_goal);
+
+		/* (1) allocate clusters */
+		num_alloced = p_fs->fs_func->alloc_cluster(sb, num_alloc, &new_clu);
 		if (num_alloced < 0)
 			return FFS_MEDIAERR;
 		else if (num_alloced == 0)
@@ -1360,6 +1377,9 @@ s32 ffsMapCluster(struct inode *inode, s32 clu_offset, u32 *clu)
 		num_clusters += num_alloced;
 		*clu = new_clu.dir;
 
+		/* only a no-FAT-chain run is known to be contiguous */
+		*num_clu = (new_clu.flags == 0x03) ? num_alloced : 1;
+
 		if (p_fs->vol_type == EXFAT) {
 			es = get_entry_set_in_dir(sb, &(fid->dir), fid->entry, ES_ALL_ENTRIES, &ep);
 			if (es == NULL)
@@ -1393,6 +1413,9 @@ s32 ffsMapCluster(struct inode *inode, s32 clu_offset, u32 *clu)
 
 		/* add number of new blocks to inode */
 		inode->i_blocks += num_alloced << (p_fs->cluster_size_bits - 9);
+
+		/* called from get_block without a closing fs_sync() */
+		fs_sync(sb, 0);
 	}
 
 	/* hint information */
@@ -1518,6 +1541,9 @@ s32 ffsReadDir(struct inode *inode, DIR_ENTRY_T *dir_entry)
 		else
 			i = dentry & (dentries_per_clu-1);
 
+		if (i == 0)
+			dir_readahead(sb, &clu, dentry >> dentries_per_clu_bits);
+
 		for ( ; i < dentries_per_clu; i++, dentry++) {
 			ep = get_entry_in_dir(sb, &clu, i, &sector);
 			if (!ep)
@@ -1740,8 +1766,14 @@ void fs_set_vol_flags(struct super_block *sb, u32 new_flag)
 
 void fs_sync(struct super_block *sb, s32 do_sync)
 {
-	if (do_sync)
+	if (do_sync) {
+		FAT_sync(sb);
+		buf_sync(sb);
 		bdev_sync(sb);
+	} else {
+		FAT_flush(sb);
+		buf_flush(sb);
+	}
 } /* end of fs_sync */
 
 void fs_error(struct super_block *sb)
@@ -1855,9 +1887,24 @@ s32 exfat_alloc_cluster(struct super_block *sb, s32 num_alloc, CHAIN_T *p_chain)
 		hint_clu = test_alloc_bitmap(sb, p_fs->clu_srch_ptr-2);
 		if (hint_clu == CLUSTER_32(~0))
 			return 0;
+
+		/* new chain: start it where the whole request fits */
+		if (num_alloc > 1) {
+			new_clu = find_free_run_in_bitmap(sb, hint_clu-2, num_alloc);
+			if (new_clu != CLUSTER_32(~0))
+				hint_clu = new_clu;
+		}
 	} else if (hint_clu >= p_fs->num_clusters) {
 		hint_clu = 2;
 		p_chain->flags = 0x01;
+	} else if ((num_alloc > 1) && (test_alloc_bitmap(sb, hint_clu-2) != hint_clu)) {
+		/* the chain cannot be extended in place, so jump to a free run
+		 * instead of scattering the request cluster by cluster */
+		new_clu = find_free_run_in_bitmap(sb, hint_clu-2, num_alloc);
+		if (new_clu != CLUSTER_32(~0)) {
+			hint_clu = new_clu;
+			p_chain->flags = 0x01;
+		}
 	}
 
 	__set_sb_dirty(sb);
@@ -2083,22 +2130,11 @@ s32 fat_count_used_clusters(struct super_block *sb)
 
 s32 exfat_count_used_clusters(struct super_block *sb)
 {
-	int i, map_i, map_b, count = 0;
-	u8 k;
+	int i, count = 0;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
-	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
-
-	map_i = map_b = 0;
-
-	for (i = 2; i < p_fs->num_clusters; i += 8) {
-		k = *(((u8 *) p_fs->vol_amap[map_i]->b_data) + map_b);
-		count += used_bit[k];
 
-		if ((++map_b) >= p_bd->sector_size) {
-			map_i++;
-			map_b = 0;
-		}
-	}
+	for (i = 0; i < p_fs->map_sectors; i++)
+		count += amap_sector_bits(sb, i) - p_fs->vol_amap_free[i];
 
 	return count;
 } /* end of exfat_count_used_clusters */
@@ -2178,6 +2214,23 @@ s32 load_alloc_bitmap(struct super_block *sb)
 					}
 				}
 
+				p_fs->vol_amap_free = (u16 *) kmalloc(sizeof(u16) * p_fs->map_sectors, GFP_KERNEL);
+				if (p_fs->vol_amap_free == NULL) {
+					for (i = 0; i < p_fs->map_sectors; i++)
+						brelse(p_fs->vol_amap[i]);
+
+					kfree(p_fs->vol_amap);
+					p_fs->vol_amap = NULL;
+					return FFS_MEMORYERR;
+				}
+
+				/* build the per-sector free summary once, so that
+				 * the used cluster count is known right after mount */
+				for (j = 0; j < p_fs->map_sectors; j++)
+					p_fs->vol_amap_free[j] = amap_sector_count_free(sb, j);
+
+				p_fs->used_clusters = exfat_count_used_clusters(sb);
+
 				p_fs->pbr_bh = NULL;
 				return FFS_SUCCESS;
 			}
@@ -2203,6 +2256,10 @@ void free_alloc_bitmap(struct super_block *sb)
 	if (p_fs->vol_amap)
 		kfree(p_fs->vol_amap);
 	p_fs->vol_amap = NULL;
+
+	if (p_fs->vol_amap_free)
+		kfree(p_fs->vol_amap_free);
+	p_fs->vol_amap_free = NULL;
 } /* end of free_alloc_bitmap */
 
 s32 set_alloc_bitmap(struct super_block *sb, u32 clu)
@@ -2217,7 +2274,10 @@ s32 set_alloc_bitmap(struct super_block *sb, u32 clu)
 
 	sector = START_SECTOR(p_fs->map_clu) + i;
 
-	exfat_bitmap_set((u8 *) p_fs->vol_amap[i]->b_data, b);
+	if (!exfat_bitmap_test((u8 *) p_fs->vol_amap[i]->b_data, b)) {
+		exfat_bitmap_set((u8 *) p_fs->vol_amap[i]->b_data, b);
+		p_fs->vol_amap_free[i]--;
+	}
 
 	return sector_write(sb, sector, p_fs->vol_amap[i], 0);
 } /* end of set_alloc_bitmap */
@@ -2239,7 +2299,10 @@ s32 clr_alloc_bitmap(struct super_block *sb, u32 clu)
 
 	sector = START_SECTOR(p_fs->map_clu) + i;
 
-	exfat_bitmap_clear((u8 *) p_fs->vol_amap[i]->b_data, b);
+	if (exfat_bitmap_test((u8 *) p_fs->vol_amap[i]->b_data, b)) {
+		exfat_bitmap_clear((u8 *) p_fs->vol_amap[i]->b_data, b);
+		p_fs->vol_amap_free[i]++;
+	}
 
 	return sector_write(sb, sector, p_fs->vol_amap[i], 0);
 
@@ -2258,44 +2321,138 @@ s32 clr_alloc_bitmap(struct super_block *sb, u32 clu)
 #endif /* CONFIG_EXFAT_DISCARD */
 } /* end of clr_alloc_bitmap */
 
+/* number of valid cluster bits held in bitmap sector i */
+u32 amap_sector_bits(struct super_block *sb, u32 i)
+{
+	u32 bits, first;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
+
+	bits = p_bd->sector_size << 3;
+	first = i << (p_bd->sector_size_bits + 3);
+
+	if (first >= (p_fs->num_clusters - 2))
+		return 0;
+	if ((p_fs->num_clusters - 2 - first) < bits)
+		return p_fs->num_clusters - 2 - first;
+	return bits;
+} /* end of amap_sector_bits */
+
+u32 amap_sector_count_free(struct super_block *sb, u32 i)
+{
+	u32 bits, used;
+	u8 *bitmap;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	bits = amap_sector_bits(sb, i);
+	bitmap = (u8 *) p_fs->vol_amap[i]->b_data;
+
+	used = memweight(bitmap, bits >> 3);
+	if (bits & 0x7)
+		used += hweight8(bitmap[bits >> 3] & ((1 << (bits & 0x7)) - 1));
+
+	return bits - used;
+} /* end of amap_sector_count_free */
+
 u32 test_alloc_bitmap(struct super_block *sb, u32 clu)
 {
-	int i, map_i, map_b;
-	u32 clu_base, clu_free;
-	u8 k, clu_mask;
+	u32 n, map_i, map_b, bits;
 	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
 	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
 
-	clu_base = (clu & ~(0x7)) + 2;
-	clu_mask = (1 << (clu - clu_base + 2)) - 1;
+	if (clu >= (p_fs->num_clusters - 2))
+		clu = 0;
 
 	map_i = clu >> (p_bd->sector_size_bits + 3);
-	map_b = (clu >> 3) & p_bd->sector_size_mask;
-
-	for (i = 2; i < p_fs->num_clusters; i += 8) {
-		k = *(((u8 *) p_fs->vol_amap[map_i]->b_data) + map_b);
-		if (clu_mask > 0) {
-			k |= clu_mask;
-			clu_mask = 0;
-		}
-		if (k < 0xFF) {
-			clu_free = clu_base + free_bit[k];
-			if (clu_free < p_fs->num_clusters)
-				return clu_free;
+	map_b = clu & ((p_bd->sector_size << 3) - 1);
+
+	/* the first sector is visited twice to cover bits before the hint */
+	for (n = 0; n <= p_fs->map_sectors; n++) {
+		if (p_fs->vol_amap_free[map_i] > 0) {
+			bits = amap_sector_bits(sb, map_i);
+			map_b = find_next_zero_bit_le(p_fs->vol_amap[map_i]->b_data, bits, map_b);
+			if (map_b < bits)
+				return (map_i << (p_bd->sector_size_bits + 3)) + map_b + 2;
 		}
-		clu_base += 8;
 
-		if (((++map_b) >= p_bd->sector_size) || (clu_base >= p_fs->num_clusters)) {
-			if ((++map_i) >= p_fs->map_sectors) {
-				clu_base = 2;
-				map_i = 0;
+		map_b = 0;
+		if ((++map_i) >= p_fs->map_sectors)
+			map_i = 0;
+	}
+
+	return CLUSTER_32(~0);
+} /* end of test_alloc_bitmap */
+
+/* find the first run of free clusters at or after clu which is long enough
+ * for num_alloc clusters (capped to one bitmap sector worth of clusters).
+ * fully used and fully free sectors are resolved from the free summary
+ * without touching the bitmap itself. */
+u32 find_free_run_in_bitmap(struct super_block *sb, u32 clu, s32 num_alloc)
+{
+	u32 n, map_i, map_b, bits, base, zero, one;
+	u32 len, run_start = 0, run_len = 0;
+	void *bitmap;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+	BD_INFO_T *p_bd = &(EXFAT_SB(sb)->bd_info);
+
+	len = p_bd->sector_size << 3;
+	if ((u32) num_alloc < len)
+		len = (u32) num_alloc;
+
+	if (clu >= (p_fs->num_clusters - 2))
+		clu = 0;
+
+	map_i = clu >> (p_bd->sector_size_bits + 3);
+	map_b = clu & ((p_bd->sector_size << 3) - 1);
+
+	for (n = 0; n < p_fs->map_sectors; n++) {
+		/* a run never wraps around the end of the bitmap */
+		if (map_i == 0)
+			run_len = 0;
+
+		bits = amap_sector_bits(sb, map_i);
+		base = map_i << (p_bd->sector_size_bits + 3);
+
+		if (p_fs->vol_amap_free[map_i] == 0) {
+			run_len = 0;
+		} else if ((map_b == 0) && (p_fs->vol_amap_free[map_i] == bits)) {
+			if (run_len == 0)
+				run_start = base;
+			run_len += bits;
+			if (run_len >= len)
+				return run_start + 2;
+		} else {
+			bitmap = p_fs->vol_amap[map_i]->b_data;
+			while (map_b < bits) {
+				if (run_len == 0) {
+					zero = find_next_zero_bit_le(bitmap, bits, map_b);
+					if (zero >= bits)
+						break;
+					run_start = base + zero;
+					map_b = zero;
+				}
+
+				one = find_next_bit_le(bitmap, bits, map_b);
+				run_len += one - map_b;
+				if (run_len >= len)
+					return run_start + 2;
+
+				/* the run may continue in the next sector */
+				if (one >= bits)
+					break;
+
+				run_len = 0;
+				map_b = one + 1;
 			}
-			map_b = 0;
 		}
+
+		map_b = 0;
+		if ((++map_i) >= p_fs->map_sectors)
+			map_i = 0;
 	}
 
 	return CLUSTER_32(~0);
-} /* end of test_alloc_bitmap */
+} /* end of find_free_run_in_bitmap */
 
 void sync_alloc_bitmap(struct super_block *sb)
 {
@@ -3219,6 +3376,40 @@ DENTRY_T *get_entry_in_dir(struct super_block *sb, CHAIN_T *p_dir, s32 entry, u3
 	return (DENTRY_T *)(buf + off);
 } /* end of get_entry_in_dir */
 
+/* read ahead the directory clusters starting at p_clu, which is the
+ * clu_offset-th cluster of the directory. the window is issued once per
+ * DIR_RA_SECTORS worth of clusters so that a scan hits the buffer cache. */
+void dir_readahead(struct super_block *sb, CHAIN_T *p_clu, s32 clu_offset)
+{
+	s32 ra_clusters, num_clusters = 0;
+	u32 clu;
+	FS_INFO_T *p_fs = &(EXFAT_SB(sb)->fs_info);
+
+	if (p_clu->dir == CLUSTER_32(0)) /* FAT16 root_dir */
+		return;
+
+	ra_clusters = DIR_RA_SECTORS >> p_fs->sectors_per_clu_bits;
+	if (ra_clusters <= 1)
+		return;
+
+	if (clu_offset % ra_clusters)
+		return;
+
+	if (p_clu->flags == 0x03) {
+		num_clusters = MIN(p_clu->size, ra_clusters);
+		if (num_clusters > 0)
+			bdev_readahead(sb, START_SECTOR(p_clu->dir), num_clusters << p_fs->sectors_per_clu_bits);
+		return;
+	}
+
+	clu = p_clu->dir;
+	while ((num_clusters++ < ra_clusters) && (clu >= 2) && (clu < p_fs->num_clusters)) {
+		bdev_readahead(sb, START_SECTOR(clu), p_fs->sectors_per_clu);
+		if (FAT_read(sb, clu, &clu) != 0)
+			break;
+	}
+} /* end of dir_readahead */
+
 
 /* returns a set of dentries for a file or dir.
  * Note that this is a copy (dump) of dentries so that user should call write_entry_set()
@@ -3758,7 +3949,7 @@ s32 fat_find_dir_entry(struct super_block *sb, CHAIN_T *p_dir, UNI_NAME_T *p_uni
    -2 : entry with the name does not exist */
 s32 exfat_find_dir_entry(struct super_block *sb, CHAIN_T *p_dir, UNI_NAME_T *p_uniname, s32 num_entries, DOS_NAME_T *p_dosname, u32 type)
 {
-	int i, dentry = 0, num_ext_entries = 0, len;
+	int i, dentry = 0, num_ext_entries = 0, len, clu_offset = 0;
 	s32 order = 0, is_feasible_entry = FALSE;
 	s32 dentries_per_clu, num_empty = 0;
 	u32 entry_type;
@@ -3792,6 +3983,8 @@ s32 exfat_find_dir_entry(struct super_block *sb, CHAIN_T *p_dir, UNI_NAME_T *p_u
 		if (p_fs->dev_ejected)
 			break;
 
+		dir_readahead(sb, &clu, clu_offset++);
+
 		for (i = 0; i < dentries_per_clu; i++, dentry++) {
 			ep = get_entry_in_dir(sb, &clu, i, NULL);
 			if (!ep)
@@ -3830,7 +4023,13 @@ s32 exfat_find_dir_entry(struct super_block *sb, CHAIN_T *p_dir, UNI_NAME_T *p_u
 				} else if (entry_type == TYPE_STREAM) {
 					if (is_feasible_entry) {
 						strm_ep = (STRM_DENTRY_T *) ep;
-						if (p_uniname->name_len == strm_ep->name_len) {
+						/* the on-disk name hash (always of the upcased
+						 * name) rules out most entries without reading
+						 * their name entries; with casesensitive the
+						 * lookup hash is not upcased, so skip it */
+						if ((p_uniname->name_len == strm_ep->name_len) &&
+							(EXFAT_SB(sb)->options.casesensitive ||
+							 (p_uniname->name_hash == GET16_A(strm_ep->name_hash)))) {
 							order = 1;
 						} else {
 							is_feasible_entry = FALSE;
@@ -117,6 +117,9 @@
 #define CS_PBR_SECTOR           1
 #define CS_DEFAULT              2
 
+/* directory readahead window */
+#define DIR_RA_SECTORS          256
+
 #define CLUSTER_16(x)           ((u16)(x))
 #define CLUSTER_32(x)           ((u32)(x))
 
@@ -473,6 +476,7 @@ typedef struct __FS_INFO_T {
 	u32      map_clu;                /* allocation bitmap start cluster */
 	u32      map_sectors;            /* num of allocation bitmap sectors */
 	struct buffer_head **vol_amap;      /* allocation bitmap */
+	u16      *vol_amap_free;         /* free clusters per bitmap sector */
 
 	u16      **vol_utbl;               /* upcase table */
 
@@ -486,14 +490,20 @@ typedef struct __FS_INFO_T {
 	struct semaphore v_sem;
 
 	/* FAT cache */
-	BUF_CACHE_T FAT_cache_array[FAT_CACHE_SIZE];
+	struct semaphore f_sem;
+	u32      FAT_cache_size;
+	u32      FAT_cache_hash_size;
+	BUF_CACHE_T *FAT_cache_array;
 	BUF_CACHE_T FAT_cache_lru_list;
-	BUF_CACHE_T FAT_cache_hash_list[FAT_CACHE_HASH_SIZE];
+	BUF_CACHE_T *FAT_cache_hash_list;
 
 	/* buf cache */
-	BUF_CACHE_T buf_cache_array[BUF_CACHE_SIZE];
+	struct semaphore b_sem;
+	u32      buf_cache_size;
+	u32      buf_cache_hash_size;
+	BUF_CACHE_T *buf_cache_array;
 	BUF_CACHE_T buf_cache_lru_list;
-	BUF_CACHE_T buf_cache_hash_list[BUF_CACHE_HASH_SIZE];
+	BUF_CACHE_T *buf_cache_hash_list;
 } FS_INFO_T;
 
 #define ES_2_ENTRIES		2
@@ -536,7 +546,7 @@ s32 ffsRemoveFile(struct inode *inode, FILE_ID_T *fid);
 s32 ffsSetAttr(struct inode *inode, u32 attr);
 s32 ffsGetStat(struct inode *inode, DIR_ENTRY_T *info);
 s32 ffsSetStat(struct inode *inode, DIR_ENTRY_T *info);
-s32 ffsMapCluster(struct inode *inode, s32 clu_offset, u32 *clu);
+s32 ffsMapCluster(struct inode *inode, s32 clu_offset, u32 *clu, s32 *num_clu);
 
 /* directory management functions */
 s32 ffsCreateDir(struct inode *inode, char *path, FILE_ID_T *fid);
@@ -572,6 +582,9 @@ void   free_alloc_bitmap(struct super_block *sb);
 s32   set_alloc_bitmap(struct super_block *sb, u32 clu);
 s32   clr_alloc_bitmap(struct super_block *sb, u32 clu);
 u32 test_alloc_bitmap(struct super_block *sb, u32 clu);
+u32 amap_sector_bits(struct super_block *sb, u32 i);
+u32 amap_sector_count_free(struct super_block *sb, u32 i);
+u32 find_free_run_in_bitmap(struct super_block *sb, u32 clu, s32 num_alloc);
 void   sync_alloc_bitmap(struct super_block *sb);
 
 /* upcase table management functions */
@@ -618,6 +631,7 @@ void   exfat_delete_dir_entry(struct super_block *sb, CHAIN_T *p_dir, s32 entry,
 s32   find_location(struct super_block *sb, CHAIN_T *p_dir, s32 entry, u32 *sector, s32 *offset);
 DENTRY_T *get_entry_with_sector(struct super_block *sb, u32 sector, s32 offset);
 DENTRY_T *get_entry_in_dir(struct super_block *sb, CHAIN_T *p_dir, s32 entry, u32 *sector);
+void dir_readahead(struct super_block *sb, CHAIN_T *p_clu, s32 clu_offset);
 ENTRY_SET_CACHE_T *get_entry_set_in_dir(struct super_block *sb, CHAIN_T *p_dir, s32 entry, u32 type, DENTRY_T **file_ep);
 void release_entry_set(ENTRY_SET_CACHE_T *es);
 s32 write_whole_entry_set(struct super_block *sb, ENTRY_SET_CACHE_T *es);
@@ -50,9 +50,15 @@
 
 /* cache size (in number of sectors)                */
 /* (should be an exponential value of 2)            */
+/* the caches start at the minimum size for volumes */
+/* up to 1GB and double with every doubling of the  */
+/* volume size, up to the maximum size              */
 #define FAT_CACHE_SIZE          128
-#define FAT_CACHE_HASH_SIZE     64
+#define FAT_CACHE_MAX_SIZE      1024
 #define BUF_CACHE_SIZE          256
-#define BUF_CACHE_HASH_SIZE     64
+#define BUF_CACHE_MAX_SIZE      1024
+
+/* number of cache entries per hash bucket          */
+#define CACHE_HASH_DEPTH        2
 
 #endif /* _EXFAT_DATA_H */
@@ -1325,18 +1325,74 @@ static int exfat_file_release(struct inode *inode, struct file *filp)
 	return 0;
 }
 
+/*
+ * Buffered writes reach exfat_get_block() one block at a time, so record
+ * where the write ends; ffsMapCluster() uses it to place the first new
+ * cluster in a free run that the rest of the write can extend in place.
+ */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,16,0)
+static ssize_t exfat_file_aio_write(struct kiocb *iocb, const struct iovec *iov,
+									unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file->f_mapping->host;
+	ssize_t ret;
+
+	BUG_ON(iocb->ki_pos != pos);
+
+	mutex_lock(&inode->i_mutex);
+	EXFAT_I(inode)->i_write_end = iov_length(iov, nr_segs) +
+		((file->f_flags & O_APPEND) ? i_size_read(inode) : pos);
+	ret = __generic_file_aio_write(iocb, iov, nr_segs, &iocb->ki_pos);
+	EXFAT_I(inode)->i_write_end = 0;
+	mutex_unlock(&inode->i_mutex);
+
+	if (ret > 0 || ret == -EIOCBQUEUED) {
+		ssize_t err;
+
+		err = generic_write_sync(file, pos, ret);
+		if (err < 0 && ret > 0)
+			ret = err;
+	}
+	return ret;
+}
+#else
+static ssize_t exfat_file_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file->f_mapping->host;
+	ssize_t ret;
+
+	mutex_lock(&inode->i_mutex);
+	EXFAT_I(inode)->i_write_end = iov_iter_count(from) +
+		((file->f_flags & O_APPEND) ? i_size_read(inode) : iocb->ki_pos);
+	ret = __generic_file_write_iter(iocb, from);
+	EXFAT_I(inode)->i_write_end = 0;
+	mutex_unlock(&inode->i_mutex);
+
+	if (ret > 0) {
+		ssize_t err;
+
+		err = generic_write_sync(file, iocb->ki_pos - ret, ret);
+		if (err < 0)
+			ret = err;
+	}
+	return ret;
+}
+#endif
+
 const struct file_operations exfat_file_operations = {
 	.llseek      = generic_file_llseek,
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,16,0)
 	.read        = do_sync_read,
 	.write       = do_sync_write,
 	.aio_read    = generic_file_aio_read,
-	.aio_write   = generic_file_aio_write,
+	.aio_write   = exfat_file_aio_write,
 #else
 	.read        = new_sync_read,
 	.write       = new_sync_write,
 	.read_iter   = generic_file_read_iter,
-	.write_iter  = generic_file_write_iter,
+	.write_iter  = exfat_file_write_iter,
 #endif
 	.mmap        = generic_file_mmap,
 	.release     = exfat_file_release,
@@ -1405,7 +1461,8 @@ const struct inode_operations exfat_file_inode_operations = {
 /*======================================================================*/
 
 static int exfat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
-					  unsigned long *mapped_blocks, int *create)
+					  unsigned long *mapped_blocks, unsigned long max_blocks,
+					  int *create)
 {
 	struct super_block *sb = inode->i_sb;
 	struct exfat_sb_info *sbi = EXFAT_SB(sb);
@@ -1414,7 +1471,7 @@ static int exfat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
 	const unsigned long blocksize = sb->s_blocksize;
 	const unsigned char blocksize_bits = sb->s_blocksize_bits;
 	sector_t last_block;
-	int err, clu_offset, sec_offset;
+	int err, clu_offset, sec_offset, num_clu = 1;
 	unsigned int cluster;
 
 	*phys = 0;
@@ -1441,9 +1498,15 @@ static int exfat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
 	clu_offset = sector >> p_fs->sectors_per_clu_bits;  /* cluster offset */
 	sec_offset = sector & (p_fs->sectors_per_clu - 1);  /* sector offset in cluster */
 
+	/* appending: ask for every cluster this request spans at once, so
+	 * the allocator can hand out one contiguous run */
+	if (*create)
+		num_clu = (sec_offset + max_blocks + p_fs->sectors_per_clu - 1) >>
+				  p_fs->sectors_per_clu_bits;
+
 	EXFAT_I(inode)->fid.size = i_size_read(inode);
 
-	err = FsMapCluster(inode, clu_offset, &cluster);
+	err = FsMapCluster(inode, clu_offset, &cluster, &num_clu);
 
 	if (err) {
 		if (err == FFS_FULL)
@@ -1452,7 +1515,14 @@ static int exfat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
 			return -EIO;
 	} else if (cluster != CLUSTER_32(~0)) {
 		*phys = START_SECTOR(cluster) + sec_offset;
-		*mapped_blocks = p_fs->sectors_per_clu - sec_offset;
+		*mapped_blocks = ((unsigned long) num_clu << p_fs->sectors_per_clu_bits) -
+						 sec_offset;
+
+		/* a contiguous (no FAT chain) file is one extent up to i_size,
+		 * so map it in one go and let mpage build large bios */
+		if ((*create == 0) && (EXFAT_I(inode)->fid.flags == 0x03) &&
+			(sector < last_block))
+			*mapped_blocks = last_block - sector;
 	}
 
 	return 0;
@@ -1469,7 +1539,7 @@ static int exfat_get_block(struct inode *inode, sector_t iblock,
 
 	__lock_super(sb);
 
-	err = exfat_bmap(inode, iblock, &phys, &mapped_blocks, &create);
+	err = exfat_bmap(inode, iblock, &phys, &mapped_blocks, max_blocks, &create);
 	if (err) {
 		__unlock_super(sb);
 		return err;
@@ -1832,6 +1902,7 @@ static struct inode *exfat_alloc_inode(struct super_block *sb)
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,4,00)
 	init_rwsem(&ei->truncate_lock);
 #endif
+	ei->i_write_end = 0;
 
 	return &ei->vfs_inode;
 }
@@ -101,6 +101,7 @@ struct exfat_inode_info {
 	char  *target;
 	/* NOTE: mmu_private is 64bits, so must hold ->i_mutex to access */
 	loff_t mmu_private;         /* physically allocated size */
+	loff_t i_write_end;         /* end of the buffered write in progress */
 	loff_t i_pos;               /* on-disk position of directory entry or 0 */
 	struct hlist_node i_hash_fat;	/* hash by i_location */
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,4,00)
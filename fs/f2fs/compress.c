@@ -0,0 +1,727 @@
+/*
+ * fs/f2fs/compress.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/fs.h>
+#include <linux/f2fs_fs.h>
+#include <linux/highmem.h>
+#include <linux/vmalloc.h>
+#include <linux/writeback.h>
+#include <linux/blkdev.h>
+#include <linux/lz4.h>
+
+#include "f2fs.h"
+#include "node.h"
+#include "segment.h"
+
+#define F2FS_CLUSTER_BYTES	(F2FS_CLUSTER_SIZE << PAGE_SHIFT)
+#define COMPRESS_HDR_SIZE	sizeof(struct f2fs_compress_header)
+
+struct compress_ctx {
+	void *rbuf;		/* raw cluster data */
+	void *cbuf;		/* header and compressed cluster data */
+	void *wrkmem;		/* working memory of LZ4 */
+};
+
+static int init_compress_ctx(struct compress_ctx *cc)
+{
+	cc->rbuf = f2fs_kvmalloc(F2FS_CLUSTER_BYTES, GFP_NOFS);
+	cc->cbuf = f2fs_kvmalloc(COMPRESS_HDR_SIZE +
+			lz4_compressbound(F2FS_CLUSTER_BYTES), GFP_NOFS);
+	cc->wrkmem = f2fs_kvmalloc(LZ4_MEM_COMPRESS, GFP_NOFS);
+
+	if (!cc->rbuf || !cc->cbuf || !cc->wrkmem) {
+		f2fs_kvfree(cc->rbuf);
+		f2fs_kvfree(cc->cbuf);
+		f2fs_kvfree(cc->wrkmem);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void destroy_compress_ctx(struct compress_ctx *cc)
+{
+	f2fs_kvfree(cc->rbuf);
+	f2fs_kvfree(cc->cbuf);
+	f2fs_kvfree(cc->wrkmem);
+}
+
+/*
+ * Clusters are aligned to the address slots of a dnode and never cross it,
+ * so the last cluster of a dnode can be shorter than F2FS_CLUSTER_SIZE.
+ */
+static void cluster_range(struct dnode_of_data *dn, unsigned int *ofs,
+							unsigned int *len)
+{
+	*ofs = dn->ofs_in_node & ~(F2FS_CLUSTER_SIZE - 1);
+	*len = min_t(unsigned int, F2FS_CLUSTER_SIZE,
+			ADDRS_PER_PAGE(dn->node_page, dn->inode) - *ofs);
+}
+
+static int next_dnode_step(struct dnode_of_data *dn, pgoff_t index)
+{
+	pgoff_t next = get_next_page_offset(dn, index);
+
+	return next > index ? next - index : 1;
+}
+
+static int read_cluster_blocks(struct f2fs_sb_info *sbi, block_t *blkaddr,
+				struct page **cpages, unsigned int nr_cpages)
+{
+	struct f2fs_io_info fio = {
+		.sbi = sbi,
+		.type = DATA,
+		.op = REQ_OP_READ,
+		.op_flags = REQ_SYNC,
+		.encrypted_page = NULL,
+	};
+	struct blk_plug plug;
+	unsigned int i;
+	int err = 0;
+
+	blk_start_plug(&plug);
+	for (i = 0; i < nr_cpages; i++) {
+		cpages[i] = f2fs_grab_cache_page(META_MAPPING(sbi),
+							blkaddr[i], false);
+		if (!cpages[i]) {
+			err = -ENOMEM;
+			break;
+		}
+
+		/* wait for the block to be moved by cleaning */
+		f2fs_wait_on_page_writeback(cpages[i], DATA, true);
+
+		fio.page = cpages[i];
+		fio.new_blkaddr = fio.old_blkaddr = blkaddr[i];
+		err = f2fs_submit_page_bio(&fio);
+		if (err) {
+			f2fs_put_page(cpages[i], 1);
+			cpages[i] = NULL;
+			break;
+		}
+	}
+	blk_finish_plug(&plug);
+
+	for (i = 0; i < nr_cpages && cpages[i]; i++) {
+		lock_page(cpages[i]);
+		if (unlikely(cpages[i]->mapping != META_MAPPING(sbi) ||
+					!PageUptodate(cpages[i])))
+			err = -EIO;
+	}
+	return err;
+}
+
+/*
+ * Fill the locked @page from its compressed cluster. Other pages of the
+ * cluster which are not cached yet are filled as well, so that sequential
+ * reads decompress each cluster only once.
+ * Returns -EAGAIN if the cluster is not compressed, otherwise @page is
+ * unlocked on return.
+ */
+int f2fs_read_compressed_page(struct inode *inode, struct page *page)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct address_space *mapping = inode->i_mapping;
+	struct page *cpages[F2FS_CLUSTER_SIZE] = { NULL, };
+	struct page *dpages[F2FS_CLUSTER_SIZE] = { NULL, };
+	block_t blkaddr[F2FS_CLUSTER_SIZE];
+	struct f2fs_compress_header *hdr;
+	struct dnode_of_data dn;
+	unsigned int ofs, len, nr_cpages = 0, nr_dpages = 0, i;
+	void *cbuf = NULL, *dbuf = NULL;
+	size_t clen, rlen, dlen;
+	pgoff_t start;
+	int err;
+
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	err = get_dnode_of_data(&dn, page->index, LOOKUP_NODE);
+	if (err == -ENOENT)
+		return -EAGAIN;
+	if (err)
+		goto out;
+
+	cluster_range(&dn, &ofs, &len);
+	if (datablock_addr(dn.node_page, ofs) != COMPRESS_ADDR) {
+		f2fs_put_dnode(&dn);
+		return -EAGAIN;
+	}
+
+	for (i = 1; i < len; i++) {
+		block_t addr = datablock_addr(dn.node_page, ofs + i);
+
+		if (addr == NULL_ADDR)
+			break;
+		blkaddr[nr_cpages++] = addr;
+	}
+	start = page->index - (dn.ofs_in_node - ofs);
+	f2fs_put_dnode(&dn);
+
+	if (unlikely(!nr_cpages)) {
+		err = -EIO;
+		goto corrupted;
+	}
+
+	err = read_cluster_blocks(sbi, blkaddr, cpages, nr_cpages);
+	if (err)
+		goto out;
+
+	cbuf = vmap(cpages, nr_cpages, VM_MAP, PAGE_KERNEL);
+	if (!cbuf) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	hdr = cbuf;
+	clen = le32_to_cpu(hdr->clen);
+	rlen = le32_to_cpu(hdr->rlen);
+	if (unlikely(clen + COMPRESS_HDR_SIZE > (nr_cpages << PAGE_SHIFT) ||
+			!rlen || rlen > (len << PAGE_SHIFT) ||
+			(rlen & (PAGE_SIZE - 1)))) {
+		err = -EIO;
+		goto corrupted;
+	}
+
+	nr_dpages = rlen >> PAGE_SHIFT;
+	if (page->index >= start + nr_dpages) {
+		/* beyond the compressed data, nothing was stored here */
+		zero_user_segment(page, 0, PAGE_SIZE);
+		nr_dpages = 0;
+		goto out;
+	}
+
+	for (i = 0; i < nr_dpages; i++) {
+		if (start + i == page->index) {
+			dpages[i] = page;
+			continue;
+		}
+
+		dpages[i] = grab_cache_page_nowait(mapping, start + i);
+		if (dpages[i] && PageUptodate(dpages[i])) {
+			f2fs_put_page(dpages[i], 1);
+			dpages[i] = NULL;
+		}
+		if (!dpages[i]) {
+			/* decompress into a scratch page instead */
+			dpages[i] = alloc_page(GFP_NOFS);
+			if (!dpages[i]) {
+				err = -ENOMEM;
+				goto out;
+			}
+		}
+	}
+
+	dbuf = vmap(dpages, nr_dpages, VM_MAP, PAGE_KERNEL);
+	if (!dbuf) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	dlen = rlen;
+	if (lz4_decompress_unknownoutputsize(cbuf + COMPRESS_HDR_SIZE, clen,
+							dbuf, &dlen) ||
+						dlen != rlen) {
+		err = -EIO;
+		goto corrupted;
+	}
+	stat_inc_decompr_cluster(inode);
+	goto out;
+
+corrupted:
+	f2fs_msg(sbi->sb, KERN_WARNING,
+		"%s: corrupted compressed cluster, ino = %lu, index = %lu",
+		__func__, inode->i_ino, page->index);
+	set_sbi_flag(sbi, SBI_NEED_FSCK);
+out:
+	if (dbuf)
+		vunmap(dbuf);
+	if (cbuf)
+		vunmap(cbuf);
+
+	for (i = 0; i < nr_dpages && dpages[i]; i++) {
+		if (dpages[i] == page)
+			continue;
+		if (!dpages[i]->mapping) {
+			__free_page(dpages[i]);
+			continue;
+		}
+		if (!err)
+			SetPageUptodate(dpages[i]);
+		f2fs_put_page(dpages[i], 1);
+	}
+
+	for (i = 0; i < nr_cpages && cpages[i]; i++) {
+		f2fs_put_page(cpages[i], 1);
+		invalidate_mapping_pages(META_MAPPING(sbi),
+						blkaddr[i], blkaddr[i]);
+	}
+
+	if (!err) {
+		SetPageUptodate(page);
+	} else {
+		ClearPageUptodate(page);
+		SetPageError(page);
+	}
+	unlock_page(page);
+	return err;
+}
+
+/*
+ * Write one block of a cluster out of place to a new block, through the
+ * meta mapping so that it does not disturb the cached data page.
+ */
+static int write_cluster_block(struct f2fs_sb_info *sbi,
+			struct dnode_of_data *dn, struct node_info *ni,
+			unsigned int ofs_in_node, void *src,
+			struct page *page, block_t *newaddr)
+{
+	struct f2fs_io_info fio = {
+		.sbi = sbi,
+		.type = DATA,
+		.op = REQ_OP_WRITE,
+		.op_flags = REQ_SYNC | REQ_NOIDLE,
+		.old_blkaddr = NEW_ADDR,
+		.page = page,
+	};
+	struct f2fs_summary sum;
+	struct page *cpage;
+	block_t blkaddr;
+
+	set_summary(&sum, dn->nid, ofs_in_node, ni->version);
+	allocate_data_block(sbi, NULL, NULL_ADDR, &blkaddr, &sum,
+							CURSEG_COLD_DATA);
+
+	cpage = f2fs_grab_cache_page(META_MAPPING(sbi), blkaddr, true);
+	if (!cpage) {
+		invalidate_blocks(sbi, blkaddr);
+		return -ENOMEM;
+	}
+
+	f2fs_wait_on_page_writeback(cpage, DATA, true);
+	memcpy(page_address(cpage), src, PAGE_SIZE);
+	SetPageUptodate(cpage);
+
+	set_page_dirty(cpage);
+	if (clear_page_dirty_for_io(cpage))
+		dec_page_count(sbi, F2FS_DIRTY_META);
+	set_page_writeback(cpage);
+
+	fio.encrypted_page = cpage;
+	fio.new_blkaddr = blkaddr;
+	f2fs_submit_page_mbio(&fio);
+	f2fs_put_page(cpage, 1);
+
+	*newaddr = blkaddr;
+	return 0;
+}
+
+/*
+ * Compress the cluster holding @index in place. Only clusters whose blocks
+ * are all written are compressed, and only if at least one block is saved.
+ * Returns the number of pages to advance, or a negative errno.
+ */
+static int compress_cluster(struct inode *inode, struct compress_ctx *cc,
+			pgoff_t index, pgoff_t end, bool *compressed)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct page *pages[F2FS_CLUSTER_SIZE] = { NULL, };
+	block_t old_addr[F2FS_CLUSTER_SIZE];
+	block_t new_addr[F2FS_CLUSTER_SIZE];
+	struct f2fs_compress_header *hdr = cc->cbuf;
+	struct dnode_of_data dn;
+	struct node_info ni;
+	unsigned int ofs, len, nr, nr_cpages, i;
+	size_t clen;
+	int step, err;
+
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	err = get_dnode_of_data(&dn, index, LOOKUP_NODE);
+	if (err == -ENOENT)
+		return next_dnode_step(&dn, index);
+	if (err)
+		return err;
+
+	cluster_range(&dn, &ofs, &len);
+	step = ofs + len - dn.ofs_in_node;
+	nr = min_t(pgoff_t, len, end - index);
+
+	if (dn.ofs_in_node != ofs || nr < 2)
+		goto skip;
+
+	if (datablock_addr(dn.node_page, ofs) == COMPRESS_ADDR) {
+		*compressed = true;
+		goto skip;
+	}
+
+	for (i = 0; i < len; i++) {
+		block_t blkaddr = datablock_addr(dn.node_page, ofs + i);
+
+		/* leave holes and preallocated blocks alone */
+		if (i >= nr) {
+			if (blkaddr != NULL_ADDR)
+				goto skip;
+			continue;
+		}
+		if (blkaddr == NULL_ADDR || blkaddr == NEW_ADDR)
+			goto skip;
+		old_addr[i] = blkaddr;
+	}
+	f2fs_put_dnode(&dn);
+
+	for (i = 0; i < nr; i++) {
+		void *kaddr;
+
+		pages[i] = get_lock_data_page(inode, index + i, false);
+		if (IS_ERR(pages[i])) {
+			err = PTR_ERR(pages[i]);
+			pages[i] = NULL;
+			goto put_pages;
+		}
+		if (PageDirty(pages[i]))
+			goto put_pages;
+
+		kaddr = kmap_atomic(pages[i]);
+		memcpy(cc->rbuf + (i << PAGE_SHIFT), kaddr, PAGE_SIZE);
+		kunmap_atomic(kaddr);
+	}
+
+	if (lz4_compress(cc->rbuf, nr << PAGE_SHIFT,
+			cc->cbuf + COMPRESS_HDR_SIZE, &clen, cc->wrkmem))
+		goto put_pages;
+
+	/* the first slot keeps COMPRESS_ADDR, so save one block at least */
+	nr_cpages = DIV_ROUND_UP(clen + COMPRESS_HDR_SIZE, PAGE_SIZE);
+	if (nr_cpages >= nr)
+		goto put_pages;
+
+	hdr->clen = cpu_to_le32(clen);
+	hdr->rlen = cpu_to_le32(nr << PAGE_SHIFT);
+	memset(cc->cbuf + COMPRESS_HDR_SIZE + clen, 0,
+		(nr_cpages << PAGE_SHIFT) - COMPRESS_HDR_SIZE - clen);
+
+	f2fs_lock_op(sbi);
+
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	err = get_dnode_of_data(&dn, index, LOOKUP_NODE);
+	if (err)
+		goto unlock_op;
+
+	/* cleaning may have moved the cluster before we locked its pages */
+	for (i = 0; i < nr; i++)
+		if (datablock_addr(dn.node_page, ofs + i) != old_addr[i])
+			goto put_dnode;
+
+	get_node_info(sbi, dn.nid, &ni);
+
+	for (i = 0; i < nr_cpages; i++) {
+		err = write_cluster_block(sbi, &dn, &ni, ofs + 1 + i,
+				cc->cbuf + (i << PAGE_SHIFT), pages[i],
+				&new_addr[i]);
+		if (err) {
+			while (i--)
+				invalidate_blocks(sbi, new_addr[i]);
+			goto put_dnode;
+		}
+	}
+
+	for (i = 0; i < nr; i++) {
+		dn.ofs_in_node = ofs + i;
+		if (i == 0)
+			dn.data_blkaddr = COMPRESS_ADDR;
+		else if (i <= nr_cpages)
+			dn.data_blkaddr = new_addr[i - 1];
+		else
+			dn.data_blkaddr = NULL_ADDR;
+		set_data_blkaddr(&dn);
+		invalidate_blocks(sbi, old_addr[i]);
+	}
+	dec_valid_block_count(sbi, inode, nr - nr_cpages);
+	stat_add_compr_saved_blocks(inode, nr - nr_cpages);
+	*compressed = true;
+put_dnode:
+	f2fs_put_dnode(&dn);
+unlock_op:
+	f2fs_unlock_op(sbi);
+put_pages:
+	for (i = 0; i < nr && pages[i]; i++)
+		f2fs_put_page(pages[i], 1);
+	return err ? err : step;
+skip:
+	f2fs_put_dnode(&dn);
+	return step;
+}
+
+/*
+ * Decompress the cluster holding @index in place; @index does not need to
+ * be the first page of the cluster, and @end is the first page past EOF.
+ * The cluster is read in through ->readpage and its pages are written to
+ * new blocks before the dnode is switched over to them, as
+ * compress_cluster() does the other way round, so a checkpoint never sees
+ * the cluster without valid blocks.
+ * Returns the number of pages to advance, or a negative errno.
+ */
+static int decompress_cluster(struct inode *inode, pgoff_t index,
+							pgoff_t end)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct address_space *mapping = inode->i_mapping;
+	struct page *pages[F2FS_CLUSTER_SIZE] = { NULL, };
+	block_t new_addr[F2FS_CLUSTER_SIZE];
+	struct dnode_of_data dn;
+	struct node_info ni;
+	unsigned int ofs, len, nr, nr_cpages = 0, i;
+	blkcnt_t count;
+	pgoff_t start;
+	int step, err;
+
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	err = get_dnode_of_data(&dn, index, LOOKUP_NODE);
+	if (err == -ENOENT)
+		return next_dnode_step(&dn, index);
+	if (err)
+		return err;
+
+	cluster_range(&dn, &ofs, &len);
+	step = ofs + len - dn.ofs_in_node;
+	start = index - (dn.ofs_in_node - ofs);
+	nr = start < end ? min_t(pgoff_t, len, end - start) : 0;
+
+	if (!nr || datablock_addr(dn.node_page, ofs) != COMPRESS_ADDR) {
+		f2fs_put_dnode(&dn);
+		return step;
+	}
+	f2fs_put_dnode(&dn);
+
+	for (i = 0; i < nr; i++) {
+		pages[i] = read_mapping_page(mapping, start + i, NULL);
+		if (IS_ERR(pages[i])) {
+			err = PTR_ERR(pages[i]);
+			pages[i] = NULL;
+			goto put_pages;
+		}
+		lock_page(pages[i]);
+		if (unlikely(pages[i]->mapping != mapping ||
+					!PageUptodate(pages[i]))) {
+			err = -EIO;
+			goto put_pages;
+		}
+	}
+
+	f2fs_lock_op(sbi);
+
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	err = get_dnode_of_data(&dn, start, LOOKUP_NODE);
+	if (err)
+		goto unlock_op;
+
+	if (datablock_addr(dn.node_page, ofs) != COMPRESS_ADDR)
+		goto put_dnode;
+
+	for (i = 1; i < len; i++)
+		if (datablock_addr(dn.node_page, ofs + i) != NULL_ADDR)
+			nr_cpages++;
+
+	if (unlikely(nr_cpages >= nr)) {
+		set_sbi_flag(sbi, SBI_NEED_FSCK);
+		err = -EIO;
+		goto put_dnode;
+	}
+
+	count = nr - nr_cpages;
+	if (unlikely(!inc_valid_block_count(sbi, inode, &count))) {
+		err = -ENOSPC;
+		goto put_dnode;
+	}
+	if (unlikely(count < nr - nr_cpages)) {
+		dec_valid_block_count(sbi, inode, count);
+		err = -ENOSPC;
+		goto put_dnode;
+	}
+
+	get_node_info(sbi, dn.nid, &ni);
+
+	for (i = 0; i < nr; i++) {
+		void *kaddr = kmap(pages[i]);
+
+		err = write_cluster_block(sbi, &dn, &ni, ofs + i, kaddr,
+						pages[i], &new_addr[i]);
+		kunmap(pages[i]);
+		if (err) {
+			while (i--)
+				invalidate_blocks(sbi, new_addr[i]);
+			dec_valid_block_count(sbi, inode, count);
+			goto put_dnode;
+		}
+	}
+
+	for (i = 0; i < len; i++) {
+		block_t blkaddr = datablock_addr(dn.node_page, ofs + i);
+
+		dn.ofs_in_node = ofs + i;
+		dn.data_blkaddr = i < nr ? new_addr[i] : NULL_ADDR;
+		if (blkaddr == dn.data_blkaddr)
+			continue;
+
+		set_data_blkaddr(&dn);
+		if (blkaddr != NULL_ADDR && blkaddr != COMPRESS_ADDR)
+			invalidate_blocks(sbi, blkaddr);
+	}
+put_dnode:
+	f2fs_put_dnode(&dn);
+unlock_op:
+	f2fs_unlock_op(sbi);
+put_pages:
+	for (i = 0; i < nr && pages[i]; i++)
+		f2fs_put_page(pages[i], 1);
+	return err ? err : step;
+}
+
+/*
+ * Decompress the clusters overlapping pages [@start, @end) before they are
+ * written to, so that data is never written into a compressed cluster.
+ * The caller holds inode_lock or i_compress_sem.
+ */
+int f2fs_decompress_range(struct inode *inode, pgoff_t start, pgoff_t end)
+{
+	pgoff_t index, last = DIV_ROUND_UP(i_size_read(inode), PAGE_SIZE);
+	int ret;
+
+	/* a cluster holding EOF can be written past EOF, so no cut at last */
+	for (index = start; index < end; index += ret) {
+		ret = decompress_cluster(inode, index, last);
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
+/*
+ * Compress a regular file in place. The caller holds inode_lock; writes
+ * decompress the clusters they touch, and f2fs_decompress_file() undoes
+ * the whole file.
+ */
+int f2fs_compress_file(struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct compress_ctx cc;
+	unsigned int nr_compressed = 0;
+	bool was_compressed = f2fs_compressed_file(inode);
+	pgoff_t index, end;
+	int ret = 0, err;
+
+	if (f2fs_has_inline_data(inode))
+		return 0;
+
+	/* kernels without compression support refuse to mount from now on */
+	if (!f2fs_sb_has_compression(sbi->sb)) {
+		F2FS_SET_FEATURE(sbi->sb, F2FS_FEATURE_COMPRESSION);
+		err = f2fs_commit_super(sbi, false);
+		if (err) {
+			F2FS_CLEAR_FEATURE(sbi->sb, F2FS_FEATURE_COMPRESSION);
+			return err;
+		}
+	}
+
+	err = init_compress_ctx(&cc);
+	if (err)
+		return err;
+
+	/* keep page faults from dirtying pages of a cluster being compressed */
+	down_write(&F2FS_I(inode)->i_compress_sem);
+
+	if (!was_compressed) {
+		file_set_compressed(inode);
+		stat_inc_compr_inode(inode);
+	}
+	/*
+	 * f2fs_may_extent_tree() keeps the cache off while the file is
+	 * compressed, so let it come back once the file is decompressed.
+	 */
+	if (F2FS_I(inode)->extent_tree) {
+		f2fs_drop_extent_tree(inode);
+		clear_inode_flag(inode, FI_NO_EXTENT);
+	}
+
+	err = filemap_write_and_wait(inode->i_mapping);
+	if (err)
+		goto out;
+
+	end = DIV_ROUND_UP(i_size_read(inode), PAGE_SIZE);
+	for (index = 0; index < end; index += ret) {
+		bool compressed = false;
+
+		if (fatal_signal_pending(current)) {
+			err = -EINTR;
+			break;
+		}
+
+		ret = compress_cluster(inode, &cc, index, end, &compressed);
+		if (ret < 0) {
+			err = ret;
+			break;
+		}
+		if (compressed)
+			nr_compressed++;
+
+		f2fs_balance_fs(sbi, true);
+	}
+out:
+	up_write(&F2FS_I(inode)->i_compress_sem);
+
+	/* nothing was worth compressing */
+	if (!was_compressed && !nr_compressed) {
+		stat_dec_compr_inode(inode);
+		file_clear_compressed(inode);
+	}
+	destroy_compress_ctx(&cc);
+
+	ret = f2fs_sync_fs(sbi->sb, 1);
+	return err ? err : ret;
+}
+
+/*
+ * Decompress all the clusters of a file compressed by f2fs_compress_file().
+ * The caller holds inode_lock.
+ */
+int f2fs_decompress_file(struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct address_space *mapping = inode->i_mapping;
+	pgoff_t index, end;
+	int ret = 0, err = 0;
+
+	if (!f2fs_compressed_file(inode))
+		return 0;
+
+	end = DIV_ROUND_UP(i_size_read(inode), PAGE_SIZE);
+	for (index = 0; index < end; index += ret) {
+		if (fatal_signal_pending(current)) {
+			err = -EINTR;
+			break;
+		}
+
+		ret = decompress_cluster(inode, index, end);
+		if (ret < 0) {
+			err = ret;
+			break;
+		}
+
+		f2fs_balance_fs(sbi, true);
+	}
+
+	if (!err)
+		err = filemap_write_and_wait(mapping);
+
+	/*
+	 * The checkpoint also waits for the blocks written through the meta
+	 * mapping, which readers only wait for while the file is compressed.
+	 */
+	ret = f2fs_sync_fs(sbi->sb, 1);
+	if (!err && !ret) {
+		stat_dec_compr_inode(inode);
+		file_clear_compressed(inode);
+	}
+	return err ? err : ret;
+}
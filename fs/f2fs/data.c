@@ -545,7 +545,8 @@ struct page *get_read_data_page(struct inode *inode, pgoff_t index,
 		.encrypted_page = NULL,
 	};
 
-	if (f2fs_encrypted_inode(inode) && S_ISREG(inode->i_mode))
+	if ((f2fs_encrypted_inode(inode) && S_ISREG(inode->i_mode)) ||
+			f2fs_compressed_file(inode))
 		return read_mapping_page(mapping, index, NULL);
 
 	page = f2fs_grab_cache_page(mapping, index, for_write);
@@ -749,6 +750,7 @@ alloc:
 static inline bool __force_buffered_io(struct inode *inode, int rw)
 {
 	return ((f2fs_encrypted_inode(inode) && S_ISREG(inode->i_mode)) ||
+			f2fs_compressed_file(inode) ||
 			(rw == WRITE && test_opt(F2FS_I_SB(inode), LFS)) ||
 			F2FS_I_SB(inode)->s_ndevs);
 }
@@ -768,6 +770,13 @@ int f2fs_preallocate_blocks(struct inode *inode, loff_t pos,
 
 	map.m_next_pgofs = NULL;
 
+	/*
+	 * Reserving blocks would fill the free slots of compressed clusters;
+	 * f2fs_write_begin() reserves them once the cluster is decompressed.
+	 */
+	if (f2fs_compressed_file(inode))
+		return 0;
+
 	if (dio) {
 		err = f2fs_convert_inline_inode(inode);
 		if (err)
@@ -868,6 +877,14 @@ next_dnode:
 next_block:
 	blkaddr = datablock_addr(dn.node_page, dn.ofs_in_node);
 
+	/* compressed clusters are read by f2fs_read_compressed_page() */
+	if (!create && f2fs_compressed_file(inode) &&
+					f2fs_cluster_compressed(&dn)) {
+		if (flag == F2FS_GET_BLOCK_BMAP)
+			map->m_pblk = 0;
+		goto sync_out;
+	}
+
 	if (blkaddr == NEW_ADDR || blkaddr == NULL_ADDR) {
 		if (create) {
 			if (unlikely(f2fs_cp_error(sbi))) {
@@ -1047,6 +1064,10 @@ int f2fs_fiemap(struct inode *inode, struct fiemap_extent_info *fieinfo,
 			return ret;
 	}
 
+	/* compressed clusters have no physical extent to report */
+	if (f2fs_compressed_file(inode))
+		return -EOPNOTSUPP;
+
 	inode_lock(inode);
 
 	if (logical_to_blk(inode, len) == 0)
@@ -1123,6 +1144,9 @@ static struct bio *f2fs_grab_bio(struct inode *inode, block_t blkaddr,
 
 		/* wait the page to be moved by cleaning */
 		f2fs_wait_on_encrypted_page_writeback(sbi, blkaddr);
+	} else if (f2fs_compressed_file(inode)) {
+		/* cleaning moves blocks of compressed files as meta pages */
+		f2fs_wait_on_encrypted_page_writeback(sbi, blkaddr);
 	}
 
 	bio = bio_alloc(GFP_KERNEL, min_t(int, nr_pages, BIO_MAX_PAGES));
@@ -1215,6 +1239,11 @@ got_it:
 				goto confused;
 			}
 		} else {
+			/* unmapped in a compressed file: compressed or a hole */
+			if (f2fs_compressed_file(inode) &&
+				f2fs_read_compressed_page(inode, page) != -EAGAIN)
+				goto next_page;
+
 			zero_user_segment(page, 0, PAGE_SIZE);
 			if (!PageUptodate(page))
 				SetPageUptodate(page);
@@ -1277,6 +1306,8 @@ static int f2fs_read_data_page(struct file *file, struct page *page)
 	/* If the file has inline data, try to read it directly */
 	if (f2fs_has_inline_data(inode))
 		ret = f2fs_read_inline_data(inode, page);
+	else if (f2fs_compressed_file(inode))
+		ret = f2fs_read_compressed_page(inode, page);
 	if (ret == -EAGAIN)
 		ret = f2fs_mpage_readpages(page->mapping, NULL, page, 1);
 	return ret;
@@ -1844,6 +1875,13 @@ static int f2fs_write_begin(struct file *file, struct address_space *mapping,
 
 	trace_f2fs_write_begin(inode, pos, len, flags);
 
+	/* write into plain blocks, not into a compressed cluster */
+	if (f2fs_compressed_file(inode)) {
+		err = f2fs_decompress_range(inode, index, index + 1);
+		if (err)
+			goto fail;
+	}
+
 	/*
 	 * We should check this at this moment to avoid deadlock on inode page
 	 * and #0 page. The locking rule for inline_data conversion should be:
@@ -2145,7 +2183,7 @@ static sector_t f2fs_bmap(struct address_space *mapping, sector_t block)
 {
 	struct inode *inode = mapping->host;
 
-	if (f2fs_has_inline_data(inode))
+	if (f2fs_has_inline_data(inode) || f2fs_compressed_file(inode))
 		return 0;
 
 	/* make sure allocating whole blocks */
@@ -111,6 +111,7 @@ struct f2fs_mount_info {
 
 #define F2FS_FEATURE_ENCRYPT	0x0001
 #define F2FS_FEATURE_BLKZONED	0x0002
+#define F2FS_FEATURE_COMPRESSION	0x2000	/* COMPRESS_ADDR in dnodes */
 
 #define F2FS_HAS_FEATURE(sb, mask)					\
 	((F2FS_SB(sb)->raw_super->feature & cpu_to_le32(mask)) != 0)
@@ -402,6 +403,8 @@ static inline bool __has_cursum_space(struct f2fs_journal *journal,
 						struct f2fs_move_range)
 #define F2FS_IOC_FLUSH_DEVICE		_IOW(F2FS_IOCTL_MAGIC, 10,	\
 						struct f2fs_flush_device)
+#define F2FS_IOC_DECOMPRESS_FILE	_IO(F2FS_IOCTL_MAGIC, 23)
+#define F2FS_IOC_COMPRESS_FILE		_IO(F2FS_IOCTL_MAGIC, 24)
 
 #define F2FS_IOC_SET_ENCRYPTION_POLICY	FS_IOC_SET_ENCRYPTION_POLICY
 #define F2FS_IOC_GET_ENCRYPTION_POLICY	FS_IOC_GET_ENCRYPTION_POLICY
@@ -576,6 +579,7 @@ struct f2fs_map_blocks {
 #define FADVISE_ENCRYPT_BIT	0x04
 #define FADVISE_ENC_NAME_BIT	0x08
 #define FADVISE_KEEP_SIZE_BIT	0x10
+#define FADVISE_COMPRESS_BIT	0x20
 
 #define file_is_cold(inode)	is_file(inode, FADVISE_COLD_BIT)
 #define file_wrong_pino(inode)	is_file(inode, FADVISE_LOST_PINO_BIT)
@@ -590,6 +594,9 @@ struct f2fs_map_blocks {
 #define file_set_enc_name(inode) set_file(inode, FADVISE_ENC_NAME_BIT)
 #define file_keep_isize(inode)	is_file(inode, FADVISE_KEEP_SIZE_BIT)
 #define file_set_keep_isize(inode) set_file(inode, FADVISE_KEEP_SIZE_BIT)
+#define file_is_compressed(inode) is_file(inode, FADVISE_COMPRESS_BIT)
+#define file_set_compressed(inode) set_file(inode, FADVISE_COMPRESS_BIT)
+#define file_clear_compressed(inode) clear_file(inode, FADVISE_COMPRESS_BIT)
 
 #define DEF_DIR_LEVEL		0
 
@@ -618,6 +625,7 @@ struct f2fs_inode_info {
 	struct mutex inmem_lock;	/* lock for inmemory pages */
 	struct extent_tree *extent_tree;	/* cached extent_tree entry */
 	struct rw_semaphore dio_rwsem[2];/* avoid racing between dio and gc */
+	struct rw_semaphore i_compress_sem;	/* compression vs. page_mkwrite */
 };
 
 static inline void get_extent_info(struct extent_info *ext,
@@ -1064,6 +1072,9 @@ struct f2fs_sb_info {
 	/* maximum # of trials to find a victim segment for SSR and GC */
 	unsigned int max_victim_search;
 
+	/* sections younger than this (in seconds) are left alone by GC_AT */
+	unsigned int gc_age_threshold;
+
 	/*
 	 * for stat information.
 	 * one is for the LFS mode, and the other is for the SSR mode.
@@ -1084,6 +1095,9 @@ struct f2fs_sb_info {
 	atomic_t vw_cnt;			/* # of volatile writes */
 	atomic_t max_aw_cnt;			/* max # of atomic writes */
 	atomic_t max_vw_cnt;			/* max # of volatile writes */
+	atomic_t compr_inode;			/* # of compressed inodes */
+	atomic64_t compr_saved_blocks;		/* # of blocks saved by compression */
+	atomic64_t decompr_cluster;		/* # of clusters decompressed */
 	int bg_gc;				/* background gc calls */
 	unsigned int ndirty_inode[NR_INODE_TYPE];	/* # of dirty inodes */
 #endif
@@ -2158,7 +2172,8 @@ static inline bool f2fs_may_extent_tree(struct inode *inode)
 	mode_t mode = inode->i_mode;
 
 	if (!test_opt(F2FS_I_SB(inode), EXTENT_CACHE) ||
-			is_inode_flag_set(inode, FI_NO_EXTENT))
+			is_inode_flag_set(inode, FI_NO_EXTENT) ||
+			file_is_compressed(inode))
 		return false;
 
 	return S_ISREG(mode);
@@ -2518,6 +2533,8 @@ struct f2fs_stat_info {
 	unsigned int undiscard_blks;
 	int inline_xattr, inline_inode, inline_dir, append, update, orphans;
 	int aw_cnt, max_aw_cnt, vw_cnt, max_vw_cnt;
+	int compr_inode;
+	unsigned long long compr_saved_blocks, decompr_cluster;
 	unsigned int valid_count, valid_node_count, valid_inode_count, discard_blks;
 	unsigned int bimodal, avg_vblocks;
 	int util_free, util_valid, util_invalid;
@@ -2583,6 +2600,20 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 		if (f2fs_has_inline_dentry(inode))			\
 			(atomic_dec(&F2FS_I_SB(inode)->inline_dir));	\
 	} while (0)
+#define stat_inc_compr_inode(inode)					\
+	do {								\
+		if (f2fs_compressed_file(inode))			\
+			(atomic_inc(&F2FS_I_SB(inode)->compr_inode));	\
+	} while (0)
+#define stat_dec_compr_inode(inode)					\
+	do {								\
+		if (f2fs_compressed_file(inode))			\
+			(atomic_dec(&F2FS_I_SB(inode)->compr_inode));	\
+	} while (0)
+#define stat_add_compr_saved_blocks(inode, blocks)			\
+		(atomic64_add(blocks, &F2FS_I_SB(inode)->compr_saved_blocks))
+#define stat_inc_decompr_cluster(inode)					\
+		(atomic64_inc(&F2FS_I_SB(inode)->decompr_cluster))
 #define stat_inc_seg_type(sbi, curseg)					\
 		((sbi)->segment_count[(curseg)->alloc_type]++)
 #define stat_inc_block_count(sbi, curseg)				\
@@ -2664,6 +2695,10 @@ void f2fs_destroy_root_stats(void);
 #define stat_dec_inline_inode(inode)			do { } while (0)
 #define stat_inc_inline_dir(inode)			do { } while (0)
 #define stat_dec_inline_dir(inode)			do { } while (0)
+#define stat_inc_compr_inode(inode)			do { } while (0)
+#define stat_dec_compr_inode(inode)			do { } while (0)
+#define stat_add_compr_saved_blocks(inode, blocks)	do { } while (0)
+#define stat_inc_decompr_cluster(inode)			do { } while (0)
 #define stat_inc_atomic_write(inode)			do { } while (0)
 #define stat_dec_atomic_write(inode)			do { } while (0)
 #define stat_update_max_atomic_write(inode)		do { } while (0)
@@ -2763,6 +2798,51 @@ void init_extent_cache_info(struct f2fs_sb_info *sbi);
 int __init create_extent_cache(void);
 void destroy_extent_cache(void);
 
+/*
+ * compress.c
+ */
+static inline bool f2fs_compressed_file(struct inode *inode)
+{
+	return S_ISREG(inode->i_mode) && file_is_compressed(inode);
+}
+
+/* whether the cluster holding dn->ofs_in_node is still compressed */
+static inline bool f2fs_cluster_compressed(struct dnode_of_data *dn)
+{
+	unsigned int ofs = dn->ofs_in_node & ~(F2FS_CLUSTER_SIZE - 1);
+
+	return datablock_addr(dn->node_page, ofs) == COMPRESS_ADDR;
+}
+
+#ifdef CONFIG_F2FS_FS_COMPRESSION
+int f2fs_read_compressed_page(struct inode *inode, struct page *page);
+int f2fs_decompress_range(struct inode *inode, pgoff_t start, pgoff_t end);
+int f2fs_compress_file(struct inode *inode);
+int f2fs_decompress_file(struct inode *inode);
+#else
+static inline int f2fs_read_compressed_page(struct inode *inode,
+							struct page *page)
+{
+	/* never hand out the raw compressed blocks as file data */
+	SetPageError(page);
+	unlock_page(page);
+	return -EOPNOTSUPP;
+}
+static inline int f2fs_decompress_range(struct inode *inode, pgoff_t start,
+							pgoff_t end)
+{
+	return f2fs_compressed_file(inode) ? -EOPNOTSUPP : 0;
+}
+static inline int f2fs_compress_file(struct inode *inode)
+{
+	return -EOPNOTSUPP;
+}
+static inline int f2fs_decompress_file(struct inode *inode)
+{
+	return f2fs_compressed_file(inode) ? -EOPNOTSUPP : 0;
+}
+#endif
+
 /*
  * crypto support
  */
@@ -2793,6 +2873,11 @@ static inline int f2fs_sb_mounted_blkzoned(struct super_block *sb)
 	return F2FS_HAS_FEATURE(sb, F2FS_FEATURE_BLKZONED);
 }
 
+static inline int f2fs_sb_has_compression(struct super_block *sb)
+{
+	return F2FS_HAS_FEATURE(sb, F2FS_FEATURE_COMPRESSION);
+}
+
 #ifdef CONFIG_BLK_DEV_ZONED
 static inline int get_blkz_type(struct f2fs_sb_info *sbi,
 			struct block_device *bdev, block_t blkaddr)
@@ -47,6 +47,15 @@ static int f2fs_vm_page_mkwrite(struct vm_area_struct *vma,
 
 	f2fs_bug_on(sbi, f2fs_has_inline_data(inode));
 
+	/* write into plain blocks, not into a compressed cluster */
+	down_read(&F2FS_I(inode)->i_compress_sem);
+	if (f2fs_compressed_file(inode)) {
+		err = f2fs_decompress_range(inode, page->index,
+							page->index + 1);
+		if (err)
+			goto out;
+	}
+
 	/* block allocation */
 	f2fs_lock_op(sbi);
 	set_new_dnode(&dn, inode, NULL, NULL, 0);
@@ -97,6 +106,7 @@ mapped:
 		f2fs_wait_on_encrypted_page_writeback(sbi, dn.data_blkaddr);
 
 out:
+	up_read(&F2FS_I(inode)->i_compress_sem);
 	sb_end_pagefault(inode->i_sb);
 	f2fs_update_time(sbi, REQ_TIME);
 	return block_page_mkwrite_return(err);
@@ -424,6 +434,10 @@ static loff_t f2fs_llseek(struct file *file, loff_t offset, int whence)
 	case SEEK_HOLE:
 		if (offset < 0)
 			return -ENXIO;
+		/* compressed clusters look sparse, report the file as data */
+		if (f2fs_compressed_file(inode))
+			return generic_file_llseek_size(file, offset, whence,
+						maxbytes, i_size_read(inode));
 		return f2fs_seek_block(file, offset, whence);
 	}
 
@@ -492,6 +506,11 @@ int truncate_data_blocks_range(struct dnode_of_data *dn, int count)
 
 		dn->data_blkaddr = NULL_ADDR;
 		set_data_blkaddr(dn);
+
+		/* the cluster flag does not own a block */
+		if (blkaddr == COMPRESS_ADDR)
+			continue;
+
 		invalidate_blocks(sbi, blkaddr);
 		if (dn->ofs_in_node == 0 && IS_INODE(dn->node_page))
 			clear_inode_flag(dn->inode, FI_FIRST_BLOCK_WRITTEN);
@@ -706,6 +725,16 @@ int f2fs_setattr(struct dentry *dentry, struct iattr *attr)
 				fscrypt_get_encryption_info(inode))
 			return -EACCES;
 
+		/* the cluster cut by the new EOF must not lose its blocks */
+		if (f2fs_compressed_file(inode) &&
+				attr->ia_size < i_size_read(inode)) {
+			pgoff_t index = attr->ia_size >> PAGE_SHIFT;
+
+			err = f2fs_decompress_range(inode, index, index + 1);
+			if (err)
+				return err;
+		}
+
 		if (attr->ia_size <= i_size_read(inode)) {
 			truncate_setsize(inode, attr->ia_size);
 			err = f2fs_truncate(inode);
@@ -1413,6 +1442,11 @@ static long f2fs_fallocate(struct file *file, int mode,
 
 	inode_lock(inode);
 
+	/* these work on block addresses, which compressed clusters lack */
+	ret = f2fs_decompress_file(inode);
+	if (ret)
+		goto out;
+
 	if (mode & FALLOC_FL_PUNCH_HOLE) {
 		if (offset >= inode->i_size)
 			goto out;
@@ -1484,6 +1518,9 @@ static int f2fs_ioc_getflags(struct file *filp, unsigned long arg)
 	struct inode *inode = file_inode(filp);
 	struct f2fs_inode_info *fi = F2FS_I(inode);
 	unsigned int flags = fi->i_flags & FS_FL_USER_VISIBLE;
+
+	if (f2fs_compressed_file(inode))
+		flags |= FS_COMPR_FL;
 	return put_user(flags, (int __user *)arg);
 }
 
@@ -1559,6 +1596,10 @@ static int f2fs_ioc_start_atomic_write(struct file *filp)
 	if (f2fs_is_atomic_file(inode))
 		goto out;
 
+	ret = f2fs_decompress_file(inode);
+	if (ret)
+		goto out;
+
 	ret = f2fs_convert_inline_inode(inode);
 	if (ret)
 		goto out;
@@ -1644,6 +1685,10 @@ static int f2fs_ioc_start_volatile_write(struct file *filp)
 	if (f2fs_is_volatile_file(inode))
 		goto out;
 
+	ret = f2fs_decompress_file(inode);
+	if (ret)
+		goto out;
+
 	ret = f2fs_convert_inline_inode(inode);
 	if (ret)
 		goto out;
@@ -2066,7 +2111,8 @@ static int f2fs_ioc_defragment(struct file *filp, unsigned long arg)
 	if (!capable(CAP_SYS_ADMIN))
 		return -EPERM;
 
-	if (!S_ISREG(inode->i_mode) || f2fs_is_atomic_file(inode))
+	if (!S_ISREG(inode->i_mode) || f2fs_is_atomic_file(inode) ||
+					f2fs_compressed_file(inode))
 		return -EINVAL;
 
 	if (f2fs_readonly(sbi->sb))
@@ -2136,6 +2182,13 @@ static int f2fs_move_file_range(struct file *file_in, loff_t pos_in,
 	if (src != dst)
 		inode_lock(dst);
 
+	/* block addresses are exchanged, so there must be no clusters */
+	ret = f2fs_decompress_file(src);
+	if (!ret && src != dst)
+		ret = f2fs_decompress_file(dst);
+	if (ret)
+		goto out_unlock;
+
 	ret = -EINVAL;
 	if (pos_in + len > src->i_size || pos_in + len < pos_in)
 		goto out_unlock;
@@ -2288,6 +2341,7 @@ static int f2fs_ioc_flush_device(struct file *filp, unsigned long arg)
 		}
 		sm->last_victim[GC_CB] = end_segno + 1;
 		sm->last_victim[GC_GREEDY] = end_segno + 1;
+		sm->last_victim[GC_AT] = end_segno + 1;
 		sm->last_victim[ALLOC_NEXT] = end_segno + 1;
 		ret = f2fs_gc(sbi, true, true, start_segno);
 		if (ret == -EAGAIN)
@@ -2301,6 +2355,65 @@ out:
 	return ret;
 }
 
+static int f2fs_ioc_compress_file(struct file *filp)
+{
+	struct inode *inode = file_inode(filp);
+	int ret;
+
+	if (!inode_owner_or_capable(inode))
+		return -EACCES;
+
+	if (!S_ISREG(inode->i_mode) || f2fs_encrypted_inode(inode))
+		return -EINVAL;
+
+	if (!(filp->f_mode & FMODE_WRITE))
+		return -EBADF;
+
+	ret = mnt_want_write_file(filp);
+	if (ret)
+		return ret;
+
+	inode_lock(inode);
+
+	if (f2fs_is_atomic_file(inode) || f2fs_is_volatile_file(inode)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = f2fs_compress_file(inode);
+out:
+	inode_unlock(inode);
+	mnt_drop_write_file(filp);
+	f2fs_update_time(F2FS_I_SB(inode), REQ_TIME);
+	return ret;
+}
+
+static int f2fs_ioc_decompress_file(struct file *filp)
+{
+	struct inode *inode = file_inode(filp);
+	int ret;
+
+	if (!inode_owner_or_capable(inode))
+		return -EACCES;
+
+	if (!S_ISREG(inode->i_mode))
+		return -EINVAL;
+
+	if (!(filp->f_mode & FMODE_WRITE))
+		return -EBADF;
+
+	ret = mnt_want_write_file(filp);
+	if (ret)
+		return ret;
+
+	inode_lock(inode);
+	ret = f2fs_decompress_file(inode);
+	inode_unlock(inode);
+
+	mnt_drop_write_file(filp);
+	f2fs_update_time(F2FS_I_SB(inode), REQ_TIME);
+	return ret;
+}
 
 long f2fs_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
@@ -2341,6 +2454,10 @@ long f2fs_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		return f2fs_ioc_move_range(filp, arg);
 	case F2FS_IOC_FLUSH_DEVICE:
 		return f2fs_ioc_flush_device(filp, arg);
+	case F2FS_IOC_COMPRESS_FILE:
+		return f2fs_ioc_compress_file(filp);
+	case F2FS_IOC_DECOMPRESS_FILE:
+		return f2fs_ioc_decompress_file(filp);
 	default:
 		return -ENOTTY;
 	}
@@ -2417,6 +2534,8 @@ long f2fs_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case F2FS_IOC_DEFRAGMENT:
 	case F2FS_IOC_MOVE_RANGE:
 	case F2FS_IOC_FLUSH_DEVICE:
+	case F2FS_IOC_COMPRESS_FILE:
+	case F2FS_IOC_DECOMPRESS_FILE:
 		break;
 	default:
 		return -ENOIOCTLCMD;
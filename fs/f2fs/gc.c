@@ -147,6 +147,8 @@ static int select_gc_type(struct f2fs_gc_kthread *gc_th, int gc_type)
 			gc_mode = GC_CB;
 		else if (gc_th->gc_idle == 2)
 			gc_mode = GC_GREEDY;
+		else if (gc_th->gc_idle == 3)
+			gc_mode = GC_AT;
 	}
 	return gc_mode;
 }
@@ -187,7 +189,7 @@ static unsigned int get_max_cost(struct f2fs_sb_info *sbi,
 		return sbi->blocks_per_seg;
 	if (p->gc_mode == GC_GREEDY)
 		return 2 * sbi->blocks_per_seg * p->ofs_unit;
-	else if (p->gc_mode == GC_CB)
+	else if (p->gc_mode == GC_CB || p->gc_mode == GC_AT)
 		return UINT_MAX;
 	else /* No other gc_mode */
 		return 0;
@@ -216,22 +218,29 @@ static unsigned int check_bg_victims(struct f2fs_sb_info *sbi)
 	return NULL_SEGNO;
 }
 
+static unsigned long long get_sec_mtime(struct f2fs_sb_info *sbi,
+						unsigned int segno)
+{
+	unsigned int start = GET_SEG_FROM_SEC(sbi, GET_SEC_FROM_SEG(sbi, segno));
+	unsigned long long mtime = 0;
+	unsigned int i;
+
+	for (i = 0; i < sbi->segs_per_sec; i++)
+		mtime += get_seg_entry(sbi, start + i)->mtime;
+
+	return div_u64(mtime, sbi->segs_per_sec);
+}
+
 static unsigned int get_cb_cost(struct f2fs_sb_info *sbi, unsigned int segno)
 {
 	struct sit_info *sit_i = SIT_I(sbi);
-	unsigned int secno = GET_SEC_FROM_SEG(sbi, segno);
-	unsigned int start = GET_SEG_FROM_SEC(sbi, secno);
-	unsigned long long mtime = 0;
+	unsigned long long mtime;
 	unsigned int vblocks;
 	unsigned char age = 0;
 	unsigned char u;
-	unsigned int i;
 
-	for (i = 0; i < sbi->segs_per_sec; i++)
-		mtime += get_seg_entry(sbi, start + i)->mtime;
+	mtime = get_sec_mtime(sbi, segno);
 	vblocks = get_valid_blocks(sbi, segno, true);
-
-	mtime = div_u64(mtime, sbi->segs_per_sec);
 	vblocks = div_u64(vblocks, sbi->segs_per_sec);
 
 	u = (vblocks * 100) >> sbi->log_blocks_per_seg;
@@ -258,6 +267,19 @@ static unsigned int get_greedy_cost(struct f2fs_sb_info *sbi,
 				valid_blocks * 2 : valid_blocks;
 }
 
+/*
+ * Young sections are likely to be invalidated by their owners soon, so
+ * migrating them only adds write amplification. They are never picked
+ * by GC_AT; older sections are ranked by cost-benefit.
+ */
+static unsigned int get_at_cost(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	if (get_sec_mtime(sbi, segno) + sbi->gc_age_threshold > get_mtime(sbi))
+		return UINT_MAX;
+
+	return get_cb_cost(sbi, segno);
+}
+
 static inline unsigned int get_gc_cost(struct f2fs_sb_info *sbi,
 			unsigned int segno, struct victim_sel_policy *p)
 {
@@ -267,10 +289,112 @@ static inline unsigned int get_gc_cost(struct f2fs_sb_info *sbi,
 	/* alloc_mode == LFS */
 	if (p->gc_mode == GC_GREEDY)
 		return get_greedy_cost(sbi, segno);
+	else if (p->gc_mode == GC_AT)
+		return get_at_cost(sbi, segno);
 	else
 		return get_cb_cost(sbi, segno);
 }
 
+/* caller should hold seglist_lock */
+static void update_victim_entry(struct f2fs_sb_info *sbi, unsigned int secno)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	struct victim_entry *ve = &dirty_i->victim_entries[secno];
+	unsigned int start = GET_SEG_FROM_SEC(sbi, secno);
+	unsigned int end = start + sbi->segs_per_sec;
+	unsigned int cost;
+
+	if (find_next_bit(dirty_i->dirty_segmap[DIRTY], end, start) >= end) {
+		list_del_init(&ve->list);
+		return;
+	}
+
+	cost = get_greedy_cost(sbi, start);
+	if (cost >= dirty_i->max_victim_cost)
+		cost = dirty_i->max_victim_cost - 1;
+
+	if (!list_empty(&ve->list) && ve->cost == cost)
+		return;
+
+	ve->cost = cost;
+	list_move_tail(&ve->list, &dirty_i->victim_cost_list[cost]);
+}
+
+/*
+ * Lowest cost-benefit cost any section in greedy bucket @cost can have:
+ * its valid blocks are at least half the bucket cost, and its age term
+ * at most 100. Buckets are walked by increasing cost, so this bound never
+ * decreases and the walk can stop once it reaches the best cost found.
+ */
+static unsigned int get_cb_cost_bound(struct f2fs_sb_info *sbi,
+						unsigned int cost)
+{
+	unsigned int vblocks = div_u64((cost + 1) / 2, sbi->segs_per_sec);
+	unsigned char u = (vblocks * 100) >> sbi->log_blocks_per_seg;
+
+	return UINT_MAX - ((100 * (100 - u) * 100) / (100 + u));
+}
+
+/*
+ * Pick the victim from the cost index instead of scanning the dirty
+ * segmap. Only sections marked stale since the last search are
+ * re-indexed, so the search cost no longer grows with the dirty segments.
+ * Greedy takes the first eligible section of the lowest bucket;
+ * cost-benefit and GC_AT evaluate the low buckets until no section left
+ * can beat the best one found, or until BG_GC's max_search is spent.
+ */
+static unsigned int get_victim_from_index(struct f2fs_sb_info *sbi,
+				int gc_type, struct victim_sel_policy *p)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	struct victim_entry *ve;
+	unsigned int secno, segno, cost, sec_cost;
+	unsigned int min_segno = NULL_SEGNO;
+	unsigned int nsearched = 0;
+
+	for_each_set_bit(secno, dirty_i->victim_stale_secmap, MAIN_SECS(sbi)) {
+		clear_bit(secno, dirty_i->victim_stale_secmap);
+		update_victim_entry(sbi, secno);
+	}
+
+	for (cost = 0; cost < dirty_i->max_victim_cost; cost++) {
+		if (p->gc_mode == GC_GREEDY) {
+			if (cost >= p->min_cost)
+				break;
+		} else if (get_cb_cost_bound(sbi, cost) >= p->min_cost) {
+			break;
+		}
+
+		list_for_each_entry(ve, &dirty_i->victim_cost_list[cost], list) {
+			secno = ve - dirty_i->victim_entries;
+			segno = GET_SEG_FROM_SEC(sbi, secno);
+
+			if (sec_usage_check(sbi, secno))
+				continue;
+			if (gc_type == BG_GC &&
+				test_bit(secno, dirty_i->victim_secmap))
+				continue;
+			if (gc_type == FG_GC && no_fggc_candidate(sbi, secno))
+				continue;
+
+			if (p->gc_mode == GC_GREEDY) {
+				p->min_cost = cost;
+				return segno;
+			}
+
+			sec_cost = get_gc_cost(sbi, segno, p);
+			if (sec_cost < p->min_cost) {
+				p->min_cost = sec_cost;
+				min_segno = segno;
+			}
+
+			if (++nsearched >= p->max_search)
+				return min_segno;
+		}
+	}
+	return min_segno;
+}
+
 static unsigned int count_bits(const unsigned long *addr,
 				unsigned int offset, unsigned int len)
 {
@@ -327,6 +451,13 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 			goto got_it;
 	}
 
+	if (p.alloc_mode == LFS) {
+		p.min_segno = get_victim_from_index(sbi, gc_type, &p);
+		if (p.min_segno != NULL_SEGNO)
+			goto got_it;
+		goto out;
+	}
+
 	while (1) {
 		unsigned long cost;
 		unsigned int segno;
@@ -805,9 +936,10 @@ next_step:
 			if (IS_ERR(inode) || is_bad_inode(inode))
 				continue;
 
-			/* if encrypted inode, let's go phase 3 */
-			if (f2fs_encrypted_inode(inode) &&
-						S_ISREG(inode->i_mode)) {
+			/* if encrypted or compressed inode, let's go phase 3 */
+			if ((f2fs_encrypted_inode(inode) &&
+						S_ISREG(inode->i_mode)) ||
+					f2fs_compressed_file(inode)) {
 				add_gc_inode(gc_list, inode);
 				continue;
 			}
@@ -845,7 +977,9 @@ next_step:
 
 			start_bidx = start_bidx_of_node(nofs, inode)
 								+ ofs_in_node;
-			if (f2fs_encrypted_inode(inode) && S_ISREG(inode->i_mode))
+			if ((f2fs_encrypted_inode(inode) &&
+					S_ISREG(inode->i_mode)) ||
+					f2fs_compressed_file(inode))
 				move_encrypted_block(inode, start_bidx, segno, off);
 			else
 				move_data_page(inode, start_bidx, gc_type, segno, off);
@@ -22,6 +22,9 @@
 /* Search max. number of dirty segments to select a victim segment */
 #define DEF_MAX_VICTIM_SEARCH 4096 /* covers 8GB */
 
+/* GC_AT leaves sections modified within this many seconds alone */
+#define DEF_GC_AGE_THRESHOLD	(60 * 60 * 24 * 7)	/* 7 days */
+
 struct f2fs_gc_kthread {
 	struct task_struct *f2fs_gc_task;
 	wait_queue_head_t gc_wait_queue_head;
@@ -171,6 +171,7 @@ static int do_read_inode(struct inode *inode)
 	stat_inc_inline_xattr(inode);
 	stat_inc_inline_inode(inode);
 	stat_inc_inline_dir(inode);
+	stat_inc_compr_inode(inode);
 
 	return 0;
 }
@@ -407,6 +408,7 @@ retry:
 	sb_end_intwrite(inode->i_sb);
 no_delete:
 	stat_dec_inline_xattr(inode);
+	stat_dec_compr_inode(inode);
 	stat_dec_inline_dir(inode);
 	stat_dec_inline_inode(inode);
 
@@ -432,6 +432,26 @@ retry_dn:
 			f2fs_i_size_write(inode,
 				(loff_t)(start + 1) << PAGE_SHIFT);
 
+		/*
+		 * dest is the compressed cluster flag, which owns no block;
+		 * invalidate src block and then set the flag.
+		 */
+		if (dest == COMPRESS_ADDR) {
+			truncate_data_blocks_range(&dn, 1);
+			dn.data_blkaddr = COMPRESS_ADDR;
+			set_data_blkaddr(&dn);
+			continue;
+		}
+
+		/*
+		 * src is the compressed cluster flag of a cluster which was
+		 * decompressed since, drop it and recover dest as into a hole.
+		 */
+		if (src == COMPRESS_ADDR) {
+			truncate_data_blocks_range(&dn, 1);
+			src = NULL_ADDR;
+		}
+
 		/*
 		 * dest is reserved block, invalidate src block
 		 * and then reserve one new block in dnode page.
@@ -670,6 +670,8 @@ static void __locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 		struct seg_entry *sentry = get_seg_entry(sbi, segno);
 		enum dirty_type t = sentry->type;
 
+		mark_victim_stale(sbi, segno);
+
 		if (unlikely(t >= DIRTY)) {
 			f2fs_bug_on(sbi, 1);
 			return;
@@ -694,6 +696,8 @@ static void __remove_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 		if (test_and_clear_bit(segno, dirty_i->dirty_segmap[t]))
 			dirty_i->nr_dirty[t]--;
 
+		mark_victim_stale(sbi, segno);
+
 		if (get_valid_blocks(sbi, segno, true) == 0)
 			clear_bit(GET_SEC_FROM_SEG(sbi, segno),
 						dirty_i->victim_secmap);
@@ -1635,6 +1639,9 @@ static void update_sit_entry(struct f2fs_sb_info *sbi, block_t blkaddr, int del)
 
 	if (sbi->segs_per_sec > 1)
 		get_sec_entry(sbi, segno)->valid_blocks += del;
+
+	/* the greedy cost changed, re-index it at the next victim search */
+	mark_victim_stale(sbi, segno);
 }
 
 void refresh_sit_entry(struct f2fs_sb_info *sbi, block_t old, block_t new)
@@ -3246,10 +3253,32 @@ static int init_victim_secmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
 	unsigned int bitmap_size = f2fs_bitmap_size(MAIN_SECS(sbi));
+	unsigned int i;
 
 	dirty_i->victim_secmap = f2fs_kvzalloc(bitmap_size, GFP_KERNEL);
 	if (!dirty_i->victim_secmap)
 		return -ENOMEM;
+
+	dirty_i->victim_stale_secmap = f2fs_kvzalloc(bitmap_size, GFP_KERNEL);
+	if (!dirty_i->victim_stale_secmap)
+		return -ENOMEM;
+
+	/* greedy cost is at most twice the valid blocks of a section */
+	dirty_i->max_victim_cost = 2 * sbi->blocks_per_seg * sbi->segs_per_sec;
+	dirty_i->victim_cost_list = f2fs_kvzalloc(sizeof(struct list_head) *
+				dirty_i->max_victim_cost, GFP_KERNEL);
+	if (!dirty_i->victim_cost_list)
+		return -ENOMEM;
+
+	dirty_i->victim_entries = f2fs_kvzalloc(sizeof(struct victim_entry) *
+				MAIN_SECS(sbi), GFP_KERNEL);
+	if (!dirty_i->victim_entries)
+		return -ENOMEM;
+
+	for (i = 0; i < dirty_i->max_victim_cost; i++)
+		INIT_LIST_HEAD(&dirty_i->victim_cost_list[i]);
+	for (i = 0; i < MAIN_SECS(sbi); i++)
+		INIT_LIST_HEAD(&dirty_i->victim_entries[i].list);
 	return 0;
 }
 
@@ -3257,6 +3286,7 @@ static int build_dirty_segmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i;
 	unsigned int bitmap_size, i;
+	int err;
 
 	/* allocate memory for dirty segments list information */
 	dirty_i = kzalloc(sizeof(struct dirty_seglist_info), GFP_KERNEL);
@@ -3274,8 +3304,13 @@ static int build_dirty_segmap(struct f2fs_sb_info *sbi)
 			return -ENOMEM;
 	}
 
+	/* the victim index is marked while the dirty segmap is built */
+	err = init_victim_secmap(sbi);
+	if (err)
+		return err;
+
 	init_dirty_segmap(sbi);
-	return init_victim_secmap(sbi);
+	return 0;
 }
 
 /*
@@ -3388,6 +3423,9 @@ static void destroy_victim_secmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
 	f2fs_kvfree(dirty_i->victim_secmap);
+	f2fs_kvfree(dirty_i->victim_stale_secmap);
+	f2fs_kvfree(dirty_i->victim_cost_list);
+	f2fs_kvfree(dirty_i->victim_entries);
 }
 
 static void destroy_dirty_segmap(struct f2fs_sb_info *sbi)
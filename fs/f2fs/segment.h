@@ -131,13 +131,15 @@ enum {
 };
 
 /*
- * In the victim_sel_policy->gc_mode, there are two gc, aka cleaning, modes.
+ * In the victim_sel_policy->gc_mode, there are three gc, aka cleaning, modes.
  * GC_CB is based on cost-benefit algorithm.
  * GC_GREEDY is based on greedy algorithm.
+ * GC_AT is cost-benefit restricted to sections older than gc_age_threshold.
  */
 enum {
 	GC_CB = 0,
 	GC_GREEDY,
+	GC_AT,
 	ALLOC_NEXT,
 	FLUSH_DEVICE,
 	MAX_GC_POLICY,
@@ -157,7 +159,7 @@ enum {
 /* for a function parameter to select a victim segment */
 struct victim_sel_policy {
 	int alloc_mode;			/* LFS or SSR */
-	int gc_mode;			/* GC_CB or GC_GREEDY */
+	int gc_mode;			/* GC_CB, GC_GREEDY or GC_AT */
 	unsigned long *dirty_segmap;	/* dirty segment bitmap */
 	unsigned int max_search;	/* maximum # of segments to search */
 	unsigned int offset;		/* last scanned bitmap offset */
@@ -261,12 +263,28 @@ enum dirty_type {
 	NR_DIRTY_TYPE
 };
 
+/* a dirty section linked into the greedy victim index */
+struct victim_entry {
+	struct list_head list;			/* link in victim_cost_list */
+	unsigned int cost;			/* greedy cost when indexed */
+};
+
 struct dirty_seglist_info {
 	const struct victim_selection *v_ops;	/* victim selction operation */
 	unsigned long *dirty_segmap[NR_DIRTY_TYPE];
 	struct mutex seglist_lock;		/* lock for segment bitmaps */
 	int nr_dirty[NR_DIRTY_TYPE];		/* # of dirty segments */
 	unsigned long *victim_secmap;		/* background GC victims */
+
+	/*
+	 * dirty sections bucketed by greedy cost; sections whose valid
+	 * blocks or dirty state changed are only marked in
+	 * victim_stale_secmap and re-bucketed at victim selection time.
+	 */
+	struct victim_entry *victim_entries;	/* one entry per section */
+	struct list_head *victim_cost_list;	/* one list per greedy cost */
+	unsigned int max_victim_cost;		/* # of victim_cost_list */
+	unsigned long *victim_stale_secmap;	/* sections to re-index */
 };
 
 /* victim selection function for cleaning and SSR */
@@ -752,6 +770,13 @@ static inline bool sec_usage_check(struct f2fs_sb_info *sbi, unsigned int secno)
 	return false;
 }
 
+static inline void mark_victim_stale(struct f2fs_sb_info *sbi,
+						unsigned int segno)
+{
+	set_bit(GET_SEC_FROM_SEG(sbi, segno),
+				DIRTY_I(sbi)->victim_stale_secmap);
+}
+
 /*
  * It is very important to gather dirty pages and write at once, so that we can
  * submit a big bio without interfering other data writes.
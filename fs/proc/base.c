@@ -1475,6 +1475,192 @@ static const struct file_operations proc_pid_sched_init_task_load_operations = {
 	.release	= single_release,
 };
 
+static int sched_boost_util_show(struct seq_file *m, void *v)
+{
+	struct inode *inode = m->private;
+	struct task_struct *p;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+
+	seq_printf(m, "%d\n", sched_get_task_boost_util(p));
+
+	put_task_struct(p);
+
+	return 0;
+}
+
+static ssize_t
+sched_boost_util_write(struct file *file, const char __user *buf,
+	    size_t count, loff_t *offset)
+{
+	struct inode *inode = file_inode(file);
+	struct task_struct *p;
+	char buffer[PROC_NUMBUF];
+	int boost_util, err;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count)) {
+		err = -EFAULT;
+		goto out;
+	}
+
+	err = kstrtoint(strstrip(buffer), 0, &boost_util);
+	if (err)
+		goto out;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+
+	err = sched_set_task_boost_util(p, boost_util);
+
+	put_task_struct(p);
+
+out:
+	return err < 0 ? err : count;
+}
+
+static int sched_boost_util_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, sched_boost_util_show, inode);
+}
+
+static const struct file_operations proc_pid_sched_boost_util_operations = {
+	.open		= sched_boost_util_open,
+	.read		= seq_read,
+	.write		= sched_boost_util_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int sched_prefer_big_show(struct seq_file *m, void *v)
+{
+	struct inode *inode = m->private;
+	struct task_struct *p;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+
+	seq_printf(m, "%d\n", sched_get_task_prefer_big(p));
+
+	put_task_struct(p);
+
+	return 0;
+}
+
+static ssize_t
+sched_prefer_big_write(struct file *file, const char __user *buf,
+	    size_t count, loff_t *offset)
+{
+	struct inode *inode = file_inode(file);
+	struct task_struct *p;
+	char buffer[PROC_NUMBUF];
+	int prefer_big, err;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count)) {
+		err = -EFAULT;
+		goto out;
+	}
+
+	err = kstrtoint(strstrip(buffer), 0, &prefer_big);
+	if (err)
+		goto out;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+
+	err = sched_set_task_prefer_big(p, prefer_big);
+
+	put_task_struct(p);
+
+out:
+	return err < 0 ? err : count;
+}
+
+static int sched_prefer_big_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, sched_prefer_big_show, inode);
+}
+
+static const struct file_operations proc_pid_sched_prefer_big_operations = {
+	.open		= sched_prefer_big_open,
+	.read		= seq_read,
+	.write		= sched_prefer_big_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int sched_boost_inherit_show(struct seq_file *m, void *v)
+{
+	struct inode *inode = m->private;
+	struct task_struct *p;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+
+	seq_printf(m, "%d\n", sched_get_task_boost_inherit(p));
+
+	put_task_struct(p);
+
+	return 0;
+}
+
+static ssize_t
+sched_boost_inherit_write(struct file *file, const char __user *buf,
+	    size_t count, loff_t *offset)
+{
+	struct inode *inode = file_inode(file);
+	struct task_struct *p;
+	char buffer[PROC_NUMBUF];
+	int boost_inherit, err;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count)) {
+		err = -EFAULT;
+		goto out;
+	}
+
+	err = kstrtoint(strstrip(buffer), 0, &boost_inherit);
+	if (err)
+		goto out;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+
+	err = sched_set_task_boost_inherit(p, boost_inherit);
+
+	put_task_struct(p);
+
+out:
+	return err < 0 ? err : count;
+}
+
+static int sched_boost_inherit_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, sched_boost_inherit_show, inode);
+}
+
+static const struct file_operations proc_pid_sched_boost_inherit_operations = {
+	.open		= sched_boost_inherit_open,
+	.read		= seq_read,
+	.write		= sched_boost_inherit_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int sched_group_id_show(struct seq_file *m, void *v)
 {
 	struct inode *inode = m->private;
@@ -2944,6 +3130,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 #endif
 #ifdef CONFIG_SCHED_HMP
 	REG("sched_init_task_load",      S_IRUGO|S_IWUSR, proc_pid_sched_init_task_load_operations),
+	REG("sched_boost_util",      S_IRUGO|S_IWUSR, proc_pid_sched_boost_util_operations),
+	REG("sched_prefer_big",      S_IRUGO|S_IWUSR, proc_pid_sched_prefer_big_operations),
+	REG("sched_boost_inherit",      S_IRUGO|S_IWUSR, proc_pid_sched_boost_inherit_operations),
 	REG("sched_group_id",      S_IRUGO|S_IWUGO, proc_pid_sched_group_id_operations),
 #endif
 #ifdef CONFIG_SCHED_DEBUG
@@ -25,6 +25,7 @@
 
 #define NULL_ADDR		((block_t)0)	/* used as block_t addresses */
 #define NEW_ADDR		((block_t)-1)	/* used as block_t addresses */
+#define COMPRESS_ADDR		((block_t)-2)	/* used as compressed data flag */
 
 #define F2FS_BYTES_TO_BLK(bytes)	((bytes) >> F2FS_BLKSIZE_BITS)
 #define F2FS_BLK_TO_BYTES(blk)		((blk) << F2FS_BLKSIZE_BITS)
@@ -183,6 +184,22 @@ struct f2fs_extent {
 	__le32 len;		/* lengh of the extent */
 } __packed;
 
+/*
+ * For compressed clusters
+ *
+ * A compressed cluster keeps COMPRESS_ADDR in its first address slot, the
+ * compressed blocks in the following slots and NULL_ADDR in the rest. The
+ * first compressed block starts with the header below. Volumes holding
+ * compressed clusters have F2FS_FEATURE_COMPRESSION set in the superblock.
+ */
+#define F2FS_CLUSTER_LOG_SIZE	2	/* 4 blocks per cluster */
+#define F2FS_CLUSTER_SIZE	(1 << F2FS_CLUSTER_LOG_SIZE)
+
+struct f2fs_compress_header {
+	__le32 clen;		/* compressed data length */
+	__le32 rlen;		/* decompressed data length */
+} __packed;
+
 #define F2FS_NAME_LEN		255
 #define F2FS_INLINE_XATTR_ADDRS	50	/* 200 bytes for inline xattrs */
 #define DEF_ADDRS_PER_INODE	923	/* Address Pointers in an Inode */
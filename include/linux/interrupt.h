@@ -234,6 +234,7 @@ extern int irq_can_set_affinity(unsigned int irq);
 extern int irq_select_affinity(unsigned int irq);
 
 extern int irq_set_affinity_hint(unsigned int irq, const struct cpumask *m);
+extern void irq_update_isolated(unsigned int cpu);
 
 /**
  * struct irq_affinity_notify - context for notification of IRQ affinity changes
@@ -272,6 +273,8 @@ static inline int irq_force_affinity(unsigned int irq, const struct cpumask *cpu
 	return 0;
 }
 
+static inline void irq_update_isolated(unsigned int cpu) { }
+
 static inline int irq_can_set_affinity(unsigned int irq)
 {
 	return 0;
@@ -22,6 +22,7 @@
 #include <linux/msm_ipc.h>
 #include <linux/device.h>
 #include <linux/kref.h>
+#include <linux/rcupdate.h>
 
 /* Maximum Wakeup Source Name Size */
 #define MAX_WS_NAME_SZ 32
@@ -101,6 +102,7 @@ struct comm_mode_info {
  * @num_tx_bytes: Number of bytes transmitted.
  * @num_rx_bytes: Number of bytes received.
  * @priv: Private information registered by the port owner.
+ * @rcu: Defers freeing the port past lockless lookups.
  */
 struct msm_ipc_port {
 	struct list_head list;
@@ -138,6 +140,7 @@ struct msm_ipc_port {
 	unsigned long num_tx_bytes;
 	unsigned long num_rx_bytes;
 	void *priv;
+	struct rcu_head rcu;
 };
 
 #ifdef CONFIG_IPC_ROUTER
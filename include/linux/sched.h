@@ -181,6 +181,17 @@ extern unsigned long avg_cpu_nr_running(unsigned int cpu);
 extern void sched_update_nr_prod(int cpu, long delta, bool inc);
 extern void sched_get_nr_running_avg(int *avg, int *iowait_avg, int *big_avg);
 
+/* Averages are scaled by 100, like those of sched_get_nr_running_avg() */
+struct sched_nr_avg {
+	int avg;
+	int big_avg;
+	int iowait_avg;
+	int max;
+};
+
+extern void sched_get_cluster_nr_running_avg(const struct cpumask *cpus,
+					     struct sched_nr_avg *stats);
+
 extern void calc_global_load(unsigned long ticks);
 extern void update_cpu_load_nohz(void);
 
@@ -988,6 +999,9 @@ void free_sched_domains(cpumask_var_t doms[], unsigned int ndoms);
 
 bool cpus_share_cache(int this_cpu, int that_cpu);
 
+extern int sched_isolate_cpu(int cpu);
+extern int sched_unisolate_cpu(int cpu);
+
 #else /* CONFIG_SMP */
 
 struct sched_domain_attr;
@@ -1003,6 +1017,16 @@ static inline bool cpus_share_cache(int this_cpu, int that_cpu)
 	return true;
 }
 
+static inline int sched_isolate_cpu(int cpu)
+{
+	return 0;
+}
+
+static inline int sched_unisolate_cpu(int cpu)
+{
+	return 0;
+}
+
 #endif	/* !CONFIG_SMP */
 
 
@@ -1076,6 +1100,7 @@ struct sched_statistics {
 #endif
 
 #define RAVG_HIST_SIZE_MAX  5
+#define NUM_BUSY_BUCKETS  10
 
 /* ravg represents frequency scaled cpu-demand of tasks */
 struct ravg {
@@ -1100,10 +1125,22 @@ struct ravg {
 	 *
 	 * 'prev_window' represents task's contribution to cpu busy time
 	 * statistics (rq->prev_runnable_sum) in previous window
+	 *
+	 * 'busy_buckets' is a decaying histogram of the task's past window
+	 * sums, in NUM_BUSY_BUCKETS equal slices of a window
+	 *
+	 * 'pred_demand' is the sum the task is predicted to reach in the
+	 * current window, from 'busy_buckets' and 'sum_history'. It is
+	 * raised within the window once 'sum' overtakes it.
+	 *
+	 * 'pred_window' is the prediction made as the previous window
+	 * ended, kept to measure the predictor's accuracy
 	 */
 	u64 mark_start;
 	u32 sum, demand;
+	u32 pred_demand, pred_window;
 	u32 sum_history[RAVG_HIST_SIZE_MAX];
+	u8 busy_buckets[NUM_BUSY_BUCKETS];
 #ifdef CONFIG_SCHED_FREQ_INPUT
 	u32 curr_window, prev_window;
 #endif
@@ -1244,6 +1281,17 @@ struct task_struct {
 	 * of this task
 	 */
 	u32 init_load_pct;
+	/*
+	 * Per-task boost: 'boost_util' clamps the task's demand from below
+	 * (in percent of a window) for placement and frequency selection,
+	 * 'boost_prefer_big' restricts it to the max capacity cluster.
+	 * Both are cleared on fork unless 'boost_inherit' is set.
+	 * 'boost_bucket' is the rq accounting slot taken at enqueue.
+	 */
+	u8 boost_util;
+	u8 boost_prefer_big;
+	u8 boost_inherit;
+	u8 boost_bucket;
 	u64 run_start;
 	u64 last_sleep_ts;
 	struct related_thread_group *grp;
@@ -1826,9 +1874,21 @@ extern void thread_group_cputime_adjusted(struct task_struct *p, cputime_t *ut,
 extern int task_free_register(struct notifier_block *n);
 extern int task_free_unregister(struct notifier_block *n);
 #ifdef CONFIG_SCHED_FREQ_INPUT
+/*
+ * Called on every window rollover of a cpu and whenever a migration
+ * changes its demand. @util is the cpu's demand in the same units as
+ * @max, the window size.
+ */
+struct freq_update_hook {
+	void (*func)(struct freq_update_hook *hook, u64 time,
+		     unsigned long util, unsigned long max);
+};
+
 extern int sched_set_window(u64 window_start, unsigned int window_size);
 extern unsigned long sched_get_busy(int cpu);
 extern void sched_set_io_is_busy(int val);
+extern void sched_set_freq_update_hook(int cpu, struct freq_update_hook *hook);
+extern void sched_clear_freq_update_hook(int cpu);
 #else
 static inline int sched_set_window(u64 window_start, unsigned int window_size)
 {
@@ -2036,6 +2096,12 @@ extern unsigned int sched_get_group_id(struct task_struct *p);
 extern int sched_set_boost(int enable);
 extern int sched_set_init_task_load(struct task_struct *p, int init_load_pct);
 extern u32 sched_get_init_task_load(struct task_struct *p);
+extern int sched_set_task_boost_util(struct task_struct *p, int util_pct);
+extern u32 sched_get_task_boost_util(struct task_struct *p);
+extern int sched_set_task_prefer_big(struct task_struct *p, int prefer_big);
+extern u32 sched_get_task_prefer_big(struct task_struct *p);
+extern int sched_set_task_boost_inherit(struct task_struct *p, int inherit);
+extern u32 sched_get_task_boost_inherit(struct task_struct *p);
 extern int sched_set_cpu_prefer_idle(int cpu, int prefer_idle);
 extern int sched_get_cpu_prefer_idle(int cpu);
 extern int sched_set_cpu_mostly_idle_load(int cpu, int mostly_idle_pct);
@@ -2045,6 +2111,14 @@ extern int sched_get_cpu_mostly_idle_nr_run(int cpu);
 extern int
 sched_set_cpu_mostly_idle_freq(int cpu, unsigned int mostly_idle_freq);
 extern unsigned int sched_get_cpu_mostly_idle_freq(int cpu);
+#define SCHED_MAX_ENERGY_STATES	32
+struct cpu_pstate_pwr;
+extern int sched_set_cpu_energy_costs(int cpu, unsigned int idle_power,
+				      const struct cpu_pstate_pwr *states,
+				      int nr_states);
+extern int sched_get_cpu_energy_costs(int cpu, unsigned int *idle_power,
+				      struct cpu_pstate_pwr *states,
+				      int max_states);
 
 #else
 static inline int sched_set_boost(int enable)
@@ -234,6 +234,11 @@ struct tcp_sock {
 	u32	prr_delivered;	/* Number of newly delivered packets to
 				 * receiver in Recovery. */
 	u32	prr_out;	/* Total number of pkts sent during Recovery. */
+	u32	delivered;	/* Total data packets delivered incl. rexmits */
+	u32	lost;		/* Total data packets lost incl. rexmits */
+	u32	first_tx_us;	/* start of window send phase, tcp_clock_us() */
+	u32	delivered_us;	/* time we reached "delivered", tcp_clock_us() */
+	u32	app_limited;	/* limited until "delivered" reaches this val */
 
  	u32	rcv_wnd;	/* Current receiver window		*/
 	u32	write_seq;	/* Tail(+1) of data held in tcp send buffer */
@@ -0,0 +1,75 @@
+/*
+ * Packet latency probes
+ *
+ * A sample of received packets is timestamped when the driver hands them
+ * to the stack, and the time each spends until the next probe point is
+ * counted in per-cpu histograms. Every kfree_skb() is also counted by
+ * its call site. Both are exported in /proc/net/skb_latency and cost a
+ * single patched branch while net.core.skb_latency_sample is 0.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#ifndef _NET_NET_LAT_H
+#define _NET_NET_LAT_H
+
+#include <linux/skbuff.h>
+#include <linux/static_key.h>
+
+/* Probe points, each measuring the time since the previous one */
+enum {
+	NET_LAT_NETIF_RCV,	/* driver rx to protocol dispatch */
+	NET_LAT_IP_RCV,		/* protocol dispatch to ip_rcv/ipv6_rcv */
+	NET_LAT_SK_ENQUEUE,	/* ip receive to socket receive queue */
+	NET_LAT_SK_DEQUEUE,	/* receive queue to recvmsg */
+	NET_LAT_STAGES
+};
+
+#define NET_LAT_BUCKETS		16
+
+#ifdef CONFIG_NET_LAT_PROBES
+
+extern struct static_key net_lat_needed;
+extern int sysctl_net_lat_sample;
+
+extern void __net_lat_rx(struct sk_buff *skb);
+extern void __net_lat_stage(struct sk_buff *skb, int stage);
+extern void __net_lat_drop(void *location);
+
+/* used where drivers hand packets to the stack, picks the samples */
+static inline void net_lat_rx(struct sk_buff *skb)
+{
+	if (static_key_false(&net_lat_needed))
+		__net_lat_rx(skb);
+}
+
+static inline void net_lat_stage(struct sk_buff *skb, int stage)
+{
+	if (static_key_false(&net_lat_needed) && skb->lat_stamp)
+		__net_lat_stage(skb, stage);
+}
+
+static inline void net_lat_drop(void *location)
+{
+	if (static_key_false(&net_lat_needed))
+		__net_lat_drop(location);
+}
+
+#else /* CONFIG_NET_LAT_PROBES */
+
+static inline void net_lat_rx(struct sk_buff *skb)
+{
+}
+
+static inline void net_lat_stage(struct sk_buff *skb, int stage)
+{
+}
+
+static inline void net_lat_drop(void *location)
+{
+}
+
+#endif /* CONFIG_NET_LAT_PROBES */
+#endif /* _NET_NET_LAT_H */
@@ -0,0 +1,14 @@
+#ifndef _NF_FLOW_TABLE_H
+#define _NF_FLOW_TABLE_H
+
+#include <linux/netdevice.h>
+
+/* Set by the flow table module while it is loaded. Called from
+ * __netif_receive_skb_core() for IPv4 packets after the taps and the
+ * device rx_handler have run; returns RX_HANDLER_CONSUMED when the
+ * packet was forwarded through an offloaded flow, RX_HANDLER_PASS to
+ * let the stack handle it.
+ */
+extern rx_handler_func_t __rcu *nf_flow_offload_hook;
+
+#endif /* _NF_FLOW_TABLE_H */
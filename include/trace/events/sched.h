@@ -159,6 +159,44 @@ TRACE_EVENT(sched_task_load,
 		__entry->sync, __entry->prefer_idle)
 );
 
+/*
+ * Every wakeup placement decision of select_best_cpu(). @energy is the
+ * estimate the energy aware path chose by; for other decisions the caller
+ * estimates it for @best_cpu, -1 if the cluster has no energy model.
+ */
+TRACE_EVENT(sched_energy_placement,
+
+	TP_PROTO(struct task_struct *p, int best_cpu, int energy_aware,
+		 s64 energy),
+
+	TP_ARGS(p, best_cpu, energy_aware, energy),
+
+	TP_STRUCT__entry(
+		__array(	char,	comm,	TASK_COMM_LEN	)
+		__field(	pid_t,	pid			)
+		__field(	int,	prev_cpu		)
+		__field(	int,	best_cpu		)
+		__field(unsigned int,	demand			)
+		__field(	int,	energy_aware		)
+		__field(	s64,	energy			)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+		__entry->pid		= p->pid;
+		__entry->prev_cpu	= task_cpu(p);
+		__entry->best_cpu	= best_cpu;
+		__entry->demand		= p->ravg.demand;
+		__entry->energy_aware	= energy_aware;
+		__entry->energy		= energy;
+	),
+
+	TP_printk("%d (%s): prev_cpu=%d best_cpu=%d demand=%u energy_aware=%d energy=%lld",
+		__entry->pid, __entry->comm, __entry->prev_cpu,
+		__entry->best_cpu, __entry->demand, __entry->energy_aware,
+		__entry->energy)
+);
+
 TRACE_EVENT(sched_set_preferred_cluster,
 
 	TP_PROTO(struct related_thread_group *grp, u64 total_demand),
@@ -367,6 +405,43 @@ TRACE_EVENT(sched_update_history,
 		__entry->nr_small_tasks)
 );
 
+TRACE_EVENT(sched_update_pred_demand,
+
+	TP_PROTO(struct rq *rq, struct task_struct *p, u32 runtime,
+		 unsigned int pred_demand),
+
+	TP_ARGS(rq, p, runtime, pred_demand),
+
+	TP_STRUCT__entry(
+		__array(	char,	comm,   TASK_COMM_LEN	)
+		__field(	pid_t,	pid			)
+		__field(unsigned int,	runtime			)
+		__field(unsigned int,	pred_demand		)
+		__field(unsigned int,	demand			)
+		__array(	u8,	bucket, NUM_BUSY_BUCKETS)
+		__field(	 int,	cpu			)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+		__entry->pid            = p->pid;
+		__entry->runtime        = runtime;
+		__entry->pred_demand    = pred_demand;
+		__entry->demand         = p->ravg.demand;
+		memcpy(__entry->bucket, p->ravg.busy_buckets,
+					NUM_BUSY_BUCKETS * sizeof(u8));
+		__entry->cpu            = rq->cpu;
+	),
+
+	TP_printk("%d (%s): runtime %u pred_demand %u demand %u cpu %d (buckets: %u %u %u %u %u %u %u %u %u %u)",
+		__entry->pid, __entry->comm,
+		__entry->runtime, __entry->pred_demand, __entry->demand,
+		__entry->cpu, __entry->bucket[0], __entry->bucket[1],
+		__entry->bucket[2], __entry->bucket[3], __entry->bucket[4],
+		__entry->bucket[5], __entry->bucket[6], __entry->bucket[7],
+		__entry->bucket[8], __entry->bucket[9])
+);
+
 TRACE_EVENT(sched_reset_all_window_stats,
 
 	TP_PROTO(u64 window_start, u64 window_size, u64 time_taken,
@@ -632,6 +707,38 @@ TRACE_EVENT(sched_cpu_hotplug,
 		__entry->status ? "online" : "offline", __entry->error)
 );
 
+/*
+ * Tracepoint for a CPU being isolated/unisolated:
+ */
+TRACE_EVENT(sched_isolate,
+
+	TP_PROTO(unsigned int requested_cpu, unsigned int isolated_cpus,
+		 u64 start_time, unsigned char isolate, int error),
+
+	TP_ARGS(requested_cpu, isolated_cpus, start_time, isolate, error),
+
+	TP_STRUCT__entry(
+		__field(	u32,	requested_cpu		)
+		__field(	u32,	isolated_cpus		)
+		__field(	u32,	time			)
+		__field(	unsigned char,	isolate		)
+		__field(	int,	error			)
+	),
+
+	TP_fast_assign(
+		__entry->requested_cpu	= requested_cpu;
+		__entry->isolated_cpus	= isolated_cpus;
+		__entry->time		= div64_u64(sched_clock() - start_time,
+						    1000);
+		__entry->isolate	= isolate;
+		__entry->error		= error;
+	),
+
+	TP_printk("iso cpu=%u cpus=0x%x time=%u us isolated=%d error=%d",
+		__entry->requested_cpu, __entry->isolated_cpus,
+		__entry->time, __entry->isolate, __entry->error)
+);
+
 /*
  * Tracepoint for load balancing:
  */
@@ -33,6 +33,7 @@
 #define RMNET_INGRESS_FORMAT_MAP_COMMANDS       (1<<4)
 #define RMNET_INGRESS_FORMAT_MAP_CKSUMV3        (1<<5)
 #define RMNET_INGRESS_FORMAT_MAP_CKSUMV4        (1<<6)
+#define RMNET_INGRESS_FORMAT_FLOW_HASH          (1<<7)
 
 /* ***************** Netlink API ******************************************** */
 #define RMNET_NETLINK_PROTO 31
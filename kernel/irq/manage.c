@@ -148,9 +148,27 @@ int irq_do_set_affinity(struct irq_data *data, const struct cpumask *mask,
 {
 	struct irq_desc *desc = irq_data_to_desc(data);
 	struct irq_chip *chip = irq_data_get_irq_chip(data);
+	const struct cpumask *target = mask;
+	cpumask_t avail;
 	int ret;
 
-	ret = chip->irq_set_affinity(data, mask, force);
+	/*
+	 * Isolated cpus are kept out of what the chip is given: the rest
+	 * of @mask is used, or every online cpu that is not isolated if
+	 * that leaves none. data->affinity keeps @mask itself, so the
+	 * requested affinity comes back in full on unisolation.
+	 */
+	if (!irqd_is_per_cpu(data) &&
+	    cpumask_intersects(mask, cpu_isolated_mask)) {
+		cpumask_andnot(&avail, mask, cpu_isolated_mask);
+		if (!cpumask_intersects(&avail, cpu_online_mask))
+			cpumask_andnot(&avail, cpu_online_mask,
+				       cpu_isolated_mask);
+		if (!cpumask_empty(&avail))
+			target = &avail;
+	}
+
+	ret = chip->irq_set_affinity(data, target, force);
 	switch (ret) {
 	case IRQ_SET_MASK_OK:
 		cpumask_copy(data->affinity, mask);
@@ -203,6 +221,41 @@ int __irq_set_affinity(unsigned int irq, const struct cpumask *mask, bool force)
 }
 EXPORT_SYMBOL(irq_set_affinity);
 
+/**
+ *	irq_update_isolated - reapply affinities after @cpu changed isolation
+ *	@cpu:	cpu that has just been isolated or unisolated
+ *
+ *	Sets the affinity of every interrupt that may fire on @cpu again,
+ *	which moves it off @cpu or back onto it. Per cpu interrupts stay.
+ *	The affinity user space set is left as it was.
+ */
+void irq_update_isolated(unsigned int cpu)
+{
+	struct irq_desc *desc;
+	struct irq_data *data;
+	cpumask_var_t mask;
+	unsigned long flags;
+	unsigned int irq;
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		return;
+
+	for_each_irq_desc(irq, desc) {
+		raw_spin_lock_irqsave(&desc->lock, flags);
+		data = irq_desc_get_irq_data(desc);
+
+		if (!irqd_is_per_cpu(data) &&
+		    cpumask_test_cpu(cpu, data->affinity)) {
+			cpumask_copy(mask, data->affinity);
+			irq_set_affinity_locked(data, mask, false);
+		}
+
+		raw_spin_unlock_irqrestore(&desc->lock, flags);
+	}
+
+	free_cpumask_var(mask);
+}
+
 int irq_set_affinity_hint(unsigned int irq, const struct cpumask *m)
 {
 	unsigned long flags;
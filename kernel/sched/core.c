@@ -76,6 +76,7 @@
 #include <linux/cpufreq.h>
 #include <linux/syscore_ops.h>
 #include <linux/nospec.h>
+#include <linux/of.h>
 
 #include <asm/switch_to.h>
 #include <asm/tlb.h>
@@ -694,6 +695,9 @@ static int _get_nohz_timer_target_hmp(void)
 		int cpu_cost = power_cost_at_freq(i, cpu_max_possible_freq(i));
 		int cstate = rq->cstate;
 
+		if (cpu_isolated(i))
+			continue;
+
 		if (power_delta_exceeded(cpu_cost, min_cost)) {
 			if (cpu_cost > min_cost)
 				continue;
@@ -747,18 +751,28 @@ int get_nohz_timer_target(void)
 			return lower_power_cpu;
 	}
 
-	if (!idle_cpu(cpu))
+	if (!idle_cpu(cpu) && !cpu_isolated(cpu))
 		return cpu;
 
 	rcu_read_lock();
 	for_each_domain(cpu, sd) {
 		for_each_cpu(i, sched_domain_span(sd)) {
-			if (!idle_cpu(i)) {
+			if (!idle_cpu(i) && !cpu_isolated(i)) {
 				cpu = i;
 				goto unlock;
 			}
 		}
 	}
+
+	/* an isolated cpu hands its timers to any other one */
+	if (cpu_isolated(cpu)) {
+		for_each_online_cpu(i) {
+			if (!cpu_isolated(i)) {
+				cpu = i;
+				break;
+			}
+		}
+	}
 unlock:
 	rcu_read_unlock();
 	return cpu;
@@ -898,6 +912,8 @@ sched_set_cpu_cstate(int cpu, int cstate, int wakeup_energy, int wakeup_latency)
 	rq->cstate = cstate; /* C1, C2 etc */
 	rq->wakeup_energy = wakeup_energy;
 	rq->wakeup_latency = wakeup_latency;
+
+	sched_cluster_update_cstate(rq);
 }
 
 #else /* !CONFIG_SMP */
@@ -1019,6 +1035,7 @@ static void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 	update_rq_clock(rq);
 	sched_info_queued(p);
 	p->sched_class->enqueue_task(rq, p, flags);
+	inc_rq_boost(rq, p);
 	trace_sched_enq_deq_task(p, 1, cpumask_bits(&p->cpus_allowed)[0]);
 }
 
@@ -1027,6 +1044,8 @@ static void dequeue_task(struct rq *rq, struct task_struct *p, int flags)
 	update_rq_clock(rq);
 	sched_info_dequeued(p);
 	p->sched_class->dequeue_task(rq, p, flags);
+	dec_rq_boost(rq, p);
+	sched_cluster_update_load(rq);
 	trace_sched_enq_deq_task(p, 0, cpumask_bits(&p->cpus_allowed)[0]);
 }
 
@@ -1244,7 +1263,7 @@ static DEFINE_MUTEX(cluster_lock);
 int num_clusters;
 static cpumask_t all_cluster_cpus = CPU_MASK_NONE;
 DECLARE_BITMAP(all_cluster_ids, NR_CPUS);
-static struct sched_cluster *sched_cluster[NR_CPUS];
+struct sched_cluster *sched_cluster[NR_CPUS];
 
 unsigned int max_possible_efficiency = 1;
 unsigned int min_possible_efficiency = UINT_MAX;
@@ -1311,6 +1330,138 @@ unsigned long __weak arch_get_cpu_efficiency(int cpu)
 	return SCHED_LOAD_SCALE;
 }
 
+static struct sched_cluster_energy *alloc_cluster_energy(int nr_states)
+{
+	struct sched_cluster_energy *em;
+
+	if (nr_states <= 0 || nr_states > SCHED_MAX_ENERGY_STATES)
+		return NULL;
+
+	em = kzalloc(sizeof(*em) + nr_states * sizeof(em->states[0]),
+		     GFP_KERNEL);
+	if (em)
+		em->nr_states = nr_states;
+
+	return em;
+}
+
+static int cluster_energy_valid(struct sched_cluster_energy *em)
+{
+	int i;
+
+	for (i = 0; i < em->nr_states; i++) {
+		if (!em->states[i].freq || !em->states[i].power)
+			return 0;
+		if (i && em->states[i].freq <= em->states[i - 1].freq)
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * The energy model is described by the "sched-energy-costs" phandle of
+ * the cluster's first cpu node:
+ *
+ *	busy-cost-data = <freq_khz power ...>;
+ *	idle-cost-data = <power>;
+ */
+static void cluster_energy_from_dt(struct sched_cluster *cluster)
+{
+	struct sched_cluster_energy *em;
+	struct device_node *cn, *np;
+	int i, len, nr_states;
+
+	cn = of_get_cpu_node(cluster_first_cpu(cluster), NULL);
+	if (!cn)
+		return;
+
+	np = of_parse_phandle(cn, "sched-energy-costs", 0);
+	of_node_put(cn);
+	if (!np)
+		return;
+
+	if (!of_find_property(np, "busy-cost-data", &len))
+		goto out;
+
+	nr_states = len / (2 * sizeof(u32));
+	em = alloc_cluster_energy(nr_states);
+	if (!em)
+		goto out;
+
+	for (i = 0; i < nr_states; i++) {
+		of_property_read_u32_index(np, "busy-cost-data", 2 * i,
+					   &em->states[i].freq);
+		of_property_read_u32_index(np, "busy-cost-data", 2 * i + 1,
+					   &em->states[i].power);
+	}
+	of_property_read_u32(np, "idle-cost-data", &em->idle_power);
+
+	if (!cluster_energy_valid(em)) {
+		pr_warn("sched: invalid energy costs for cpu%d\n",
+			cluster_first_cpu(cluster));
+		kfree(em);
+		goto out;
+	}
+
+	rcu_assign_pointer(cluster->energy, em);
+out:
+	of_node_put(np);
+}
+
+int sched_set_cpu_energy_costs(int cpu, unsigned int idle_power,
+			       const struct cpu_pstate_pwr *states,
+			       int nr_states)
+{
+	struct sched_cluster *cluster = cpu_rq(cpu)->cluster;
+	struct sched_cluster_energy *em, *old;
+
+	/* writing no busy states removes the model */
+	if (!nr_states) {
+		em = NULL;
+	} else {
+		em = alloc_cluster_energy(nr_states);
+		if (!em)
+			return -EINVAL;
+
+		em->idle_power = idle_power;
+		memcpy(em->states, states, nr_states * sizeof(*states));
+		if (!cluster_energy_valid(em)) {
+			kfree(em);
+			return -EINVAL;
+		}
+	}
+
+	mutex_lock(&cluster_lock);
+	old = rcu_dereference_protected(cluster->energy,
+					lockdep_is_held(&cluster_lock));
+	rcu_assign_pointer(cluster->energy, em);
+	mutex_unlock(&cluster_lock);
+
+	if (old)
+		kfree_rcu(old, rcu);
+
+	return 0;
+}
+
+int sched_get_cpu_energy_costs(int cpu, unsigned int *idle_power,
+			       struct cpu_pstate_pwr *states, int max_states)
+{
+	struct sched_cluster_energy *em;
+	int nr_states = 0;
+
+	rcu_read_lock();
+	em = rcu_dereference(cpu_rq(cpu)->cluster->energy);
+	if (em) {
+		nr_states = min(em->nr_states, max_states);
+		*idle_power = em->idle_power;
+		memcpy(states, em->states, nr_states * sizeof(*states));
+	}
+	rcu_read_unlock();
+
+	return nr_states;
+}
+
 static void add_cluster(struct cpufreq_policy *policy)
 {
 	struct sched_cluster *cluster;
@@ -1322,11 +1473,13 @@ static void add_cluster(struct cpufreq_policy *policy)
 
 	INIT_LIST_HEAD(&cluster->list);
 	cpumask_copy(&cluster->cpus, policy->related_cpus);
+	cluster->least_loaded_cpu = cpu;
 	cluster->cur_freq = policy->cur;
 	cluster->max_freq = policy->max;
 	cluster->min_freq = policy->min;
 	cluster->max_possible_freq = policy->cpuinfo.max_freq;
 	cluster->efficiency = arch_get_cpu_efficiency(cpu);
+	cluster_energy_from_dt(cluster);
 
 	if (cluster->efficiency > max_possible_efficiency)
 		max_possible_efficiency = cluster->efficiency;
@@ -1721,6 +1874,12 @@ unsigned int __read_mostly sysctl_sched_grp_task_active_windows = 1;
  */
 unsigned int __read_mostly sysctl_sched_enable_thread_grouping = 0;
 
+/*
+ * Let the predicted window demand of tasks drive placement and cpu
+ * frequency in addition to their window history.
+ */
+unsigned int __read_mostly sysctl_sched_enable_prediction = 1;
+
 #ifdef CONFIG_SCHED_FREQ_INPUT
 
 static __read_mostly unsigned int sched_migration_fixup = 1;
@@ -1895,6 +2054,22 @@ static inline unsigned int load_to_freq(struct rq *rq, u64 load)
 	return freq;
 }
 
+/*
+ * Busy time of the cpu's last window, raised to the summed predicted
+ * demand of the tasks queued on it when prediction is enabled.
+ */
+static inline u64 freq_busy_time(struct rq *rq)
+{
+	u64 pred;
+
+	if (!sysctl_sched_enable_prediction)
+		return rq->prev_runnable_sum;
+
+	pred = min_t(u64, rq->hmp_stats.pred_demands_sum, sched_ravg_window);
+
+	return max(rq->prev_runnable_sum, pred);
+}
+
 /* Should scheduler alert governor for changing frequency? */
 static int send_notification(struct rq *rq)
 {
@@ -1906,7 +2081,7 @@ static int send_notification(struct rq *rq)
 		return 0;
 
 	cur_freq = load_to_freq(rq, rq->old_busy_time);
-	freq_required = load_to_freq(rq, rq->prev_runnable_sum);
+	freq_required = load_to_freq(rq, freq_busy_time(rq));
 
 	if (nearly_same_freq(cur_freq, freq_required))
 		return 0;
@@ -1921,11 +2096,63 @@ static int send_notification(struct rq *rq)
 	return rc;
 }
 
+/*
+ * Governors that want window statistics pushed to them instead of
+ * polling sched_get_busy() install a per-cpu hook. The hook runs from
+ * scheduler context with preemption disabled and must not sleep.
+ */
+static DEFINE_PER_CPU(struct freq_update_hook __rcu *, freq_update_hook);
+
+void sched_set_freq_update_hook(int cpu, struct freq_update_hook *hook)
+{
+	rcu_assign_pointer(per_cpu(freq_update_hook, cpu), hook);
+}
+
+/* Callers must synchronize_sched() before freeing the hook */
+void sched_clear_freq_update_hook(int cpu)
+{
+	rcu_assign_pointer(per_cpu(freq_update_hook, cpu), NULL);
+}
+
+/*
+ * Frequency demand of a cpu: the busy time of the last complete window
+ * (see freq_busy_time()) or the demand of the tasks runnable on it,
+ * whichever is higher, in reference to the cpu's own max frequency.
+ */
+static inline unsigned long cpu_freq_demand(struct rq *rq)
+{
+	u64 load = max(freq_busy_time(rq),
+		       rq->hmp_stats.cumulative_runnable_avg);
+
+	load = scale_load_to_cpu(load, cpu_of(rq));
+	load = max(load, rq_boost_load(rq));
+
+	return min_t(u64, load, sched_ravg_window);
+}
+
+static void sched_freq_update(struct rq *rq, u64 wallclock)
+{
+	struct freq_update_hook *hook;
+
+	hook = rcu_dereference_sched(per_cpu(freq_update_hook, cpu_of(rq)));
+	if (hook)
+		hook->func(hook, wallclock, cpu_freq_demand(rq),
+			   sched_ravg_window);
+}
+
 /* Alert governor if there is a need to change frequency */
 void check_for_freq_change(struct rq *rq)
 {
 	int cpu = cpu_of(rq);
 
+	if (!sched_enable_hmp)
+		return;
+
+	/* migrations move demand between windows; push it right away */
+	rcu_read_lock_sched();
+	sched_freq_update(rq, sched_ktime_clock());
+	rcu_read_unlock_sched();
+
 	if (!send_notification(rq))
 		return;
 
@@ -2189,6 +2416,8 @@ static inline void update_cpu_busy_time(struct task_struct *p, struct rq *rq,
 {
 }
 
+static inline void sched_freq_update(struct rq *rq, u64 wallclock) { }
+
 #endif	/* CONFIG_SCHED_FREQ_INPUT */
 
 static int account_busy_for_task_demand(struct task_struct *p, int event)
@@ -2209,6 +2438,204 @@ static int account_busy_for_task_demand(struct task_struct *p, int event)
 	return 1;
 }
 
+/*
+ * Window demand prediction
+ *
+ * Each task keeps a histogram of the windows it was busy in, bucketed
+ * by how busy it was. A bucket gains BUCKET_INC_STEP for every window
+ * landing in it and all others lose BUCKET_DEC_STEP, so the histogram
+ * follows a change of behaviour within a few windows. A task that has
+ * been busy for 'runtime' is predicted to end up in the lowest recently
+ * used bucket at or above runtime's: periodic bursty tasks then get
+ * their burst level predicted as soon as they start a burst, where
+ * 'demand' only catches up windows later.
+ */
+#define BUCKET_INC_STEP		8
+#define BUCKET_DEC_STEP		2
+
+static inline int busy_to_bucket(u32 runtime)
+{
+	int bidx = mult_frac(runtime, NUM_BUSY_BUCKETS, max_task_load());
+
+	return min(bidx, NUM_BUSY_BUCKETS - 1);
+}
+
+static void bucket_increase(u8 *buckets, int idx)
+{
+	int i;
+
+	for (i = 0; i < NUM_BUSY_BUCKETS; i++) {
+		if (i == idx)
+			buckets[i] = min_t(int, buckets[i] + BUCKET_INC_STEP,
+					   U8_MAX);
+		else if (buckets[i] > BUCKET_DEC_STEP)
+			buckets[i] -= BUCKET_DEC_STEP;
+		else
+			buckets[i] = 0;
+	}
+}
+
+/*
+ * The prediction is the average of the history entries that fall in
+ * the chosen bucket, or the bucket's midpoint if none do, and never
+ * less than what the task has already run.
+ */
+static u32 get_pred_busy(struct task_struct *p, int start, u32 runtime)
+{
+	u32 *hist = p->ravg.sum_history;
+	u32 dmin, dmax, pred;
+	u64 sum = 0;
+	int i, first, nr = 0;
+
+	for (first = start; first < NUM_BUSY_BUCKETS; first++) {
+		if (p->ravg.busy_buckets[first])
+			break;
+	}
+
+	if (first >= NUM_BUSY_BUCKETS)
+		return runtime;
+
+	dmin = mult_frac(max_task_load(), first, NUM_BUSY_BUCKETS);
+	dmax = mult_frac(max_task_load(), first + 1, NUM_BUSY_BUCKETS);
+	/* the top bucket also holds fully busy windows */
+	if (first == NUM_BUSY_BUCKETS - 1)
+		dmax++;
+
+	for (i = 0; i < sched_ravg_hist_size; i++) {
+		if (hist[i] >= dmin && hist[i] < dmax) {
+			sum += hist[i];
+			nr++;
+		}
+	}
+
+	if (nr)
+		pred = div64_u64(sum, nr);
+	else
+		pred = dmin + (dmax - dmin) / 2;
+
+	return max(pred, runtime);
+}
+
+struct sched_pred_stats {
+	u64 windows;
+	u64 under, over;	/* off by more than a bucket */
+	u64 abs_err;
+};
+
+static DEFINE_PER_CPU(struct sched_pred_stats, sched_pred_stats);
+
+#ifdef CONFIG_DEBUG_FS
+
+static int sched_pred_stats_show(struct seq_file *m, void *v)
+{
+	struct sched_pred_stats *ps;
+	int cpu;
+
+	seq_printf(m, "cpu windows under over avg_err_us\n");
+	for_each_possible_cpu(cpu) {
+		ps = &per_cpu(sched_pred_stats, cpu);
+		seq_printf(m, "%d %llu %llu %llu %llu\n", cpu, ps->windows,
+			   ps->under, ps->over, ps->windows ?
+			   div64_u64(ps->abs_err, ps->windows * NSEC_PER_USEC) :
+			   0);
+	}
+
+	return 0;
+}
+
+/* Any write clears the counters */
+static ssize_t sched_pred_stats_write(struct file *filp,
+				      const char __user *ubuf, size_t cnt,
+				      loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(sched_pred_stats, cpu), 0,
+		       sizeof(struct sched_pred_stats));
+
+	return cnt;
+}
+
+static int sched_pred_stats_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, sched_pred_stats_show, NULL);
+}
+
+static const struct file_operations sched_pred_stats_fops = {
+	.open		= sched_pred_stats_open,
+	.write		= sched_pred_stats_write,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static __init int sched_pred_stats_init(void)
+{
+	debugfs_create_file("sched_pred_stats", 0644, NULL, NULL,
+			    &sched_pred_stats_fops);
+
+	return 0;
+}
+late_initcall(sched_pred_stats_init);
+
+#endif	/* CONFIG_DEBUG_FS */
+
+/* Score the prediction made for the window that just ended */
+static void account_pred_error(struct rq *rq, struct task_struct *p,
+			       u32 runtime)
+{
+	struct sched_pred_stats *ps = &per_cpu(sched_pred_stats, cpu_of(rq));
+	u32 pred = p->ravg.pred_window;
+	u32 slack = max_task_load() / NUM_BUSY_BUCKETS;
+
+	ps->windows++;
+	if (pred > runtime) {
+		ps->abs_err += pred - runtime;
+		if (pred - runtime > slack)
+			ps->over++;
+	} else {
+		ps->abs_err += runtime - pred;
+		if (runtime - pred > slack)
+			ps->under++;
+	}
+}
+
+static inline bool task_counts_in_hmp_stats(struct task_struct *p)
+{
+	/*
+	 * A throttled deadline sched class task gets dequeued without
+	 * changing p->on_rq. Since the dequeue decrements hmp stats
+	 * avoid decrementing it here again.
+	 */
+	return p->on_rq && (!task_has_dl_policy(p) || !p->dl.dl_throttled);
+}
+
+/*
+ * Raise the prediction of a task that is already busier in the current
+ * window than predicted, rather than waiting for the window to end.
+ */
+static void update_task_pred_demand(struct rq *rq, struct task_struct *p)
+{
+	u32 sum = p->ravg.sum;
+	u32 pred;
+
+	if (sum <= p->ravg.pred_demand || is_idle_task(p) || exiting_task(p))
+		return;
+
+	pred = get_pred_busy(p, busy_to_bucket(sum), sum);
+
+	if (task_counts_in_hmp_stats(p))
+		p->sched_class->dec_hmp_sched_stats(rq, p);
+
+	p->ravg.pred_demand = pred;
+
+	if (task_counts_in_hmp_stats(p))
+		p->sched_class->inc_hmp_sched_stats(rq, p);
+
+	trace_sched_update_pred_demand(rq, p, sum, pred);
+}
+
 /*
  * Called when new window is starting for a task, to record cpu usage over
  * recently concluded window(s). Normally 'samples' should be 1. It can be > 1
@@ -2220,13 +2647,16 @@ static void update_history(struct rq *rq, struct task_struct *p,
 {
 	u32 *hist = &p->ravg.sum_history[0];
 	int ridx, widx;
-	u32 max = 0, avg, demand;
+	u32 max = 0, avg, demand, pred;
 	u64 sum = 0;
 
 	/* Ignore windows where task had no activity */
 	if (!runtime || is_idle_task(p) || exiting_task(p) || !samples)
 			goto done;
 
+	if (samples == 1)
+		account_pred_error(rq, p, runtime);
+
 	/* Push new 'runtime' value onto stack */
 	widx = sched_ravg_hist_size - 1;
 	ridx = widx - samples;
@@ -2246,12 +2676,7 @@ static void update_history(struct rq *rq, struct task_struct *p,
 
 	p->ravg.sum = 0;
 
-	/*
-	 * A throttled deadline sched class task gets dequeued without
-	 * changing p->on_rq. Since the dequeue decrements hmp stats
-	 * avoid decrementing it here again.
-	 */
-	if (p->on_rq && (!task_has_dl_policy(p) || !p->dl.dl_throttled))
+	if (task_counts_in_hmp_stats(p))
 		p->sched_class->dec_hmp_sched_stats(rq, p);
 
 	avg = div64_u64(sum, sched_ravg_hist_size);
@@ -2267,9 +2692,18 @@ static void update_history(struct rq *rq, struct task_struct *p,
 
 	p->ravg.demand = demand;
 
-	if (p->on_rq && (!task_has_dl_policy(p) || !p->dl.dl_throttled))
+	/*
+	 * Expect the next window to be at least as busy as the one that
+	 * ended, then record that one in the histogram.
+	 */
+	pred = get_pred_busy(p, busy_to_bucket(runtime), runtime);
+	bucket_increase(p->ravg.busy_buckets, busy_to_bucket(runtime));
+	p->ravg.pred_demand = p->ravg.pred_window = pred;
+
+	if (task_counts_in_hmp_stats(p))
 		p->sched_class->inc_hmp_sched_stats(rq, p);
 
+	trace_sched_update_pred_demand(rq, p, runtime, pred);
 done:
 	trace_sched_update_history(rq, p, runtime, samples, event);
 }
@@ -2389,6 +2823,9 @@ static void update_task_demand(struct task_struct *p, struct rq *rq,
 static void update_task_ravg(struct task_struct *p, struct rq *rq,
 	     int event, u64 wallclock, u64 irqtime)
 {
+	bool rollover;
+	u64 prev_load;
+
 	if (sched_use_pelt || !rq->window_start || sched_disable_window_stats)
 		return;
 
@@ -2399,9 +2836,20 @@ static void update_task_ravg(struct task_struct *p, struct rq *rq,
 	if (!p->ravg.mark_start)
 		goto done;
 
+	/* rq window sums are rolled over only on behalf of rq->curr */
+	rollover = p == rq->curr && p->ravg.mark_start < rq->window_start;
+
+	prev_load = rq->hmp_stats.cumulative_runnable_avg;
 	update_task_demand(p, rq, event, wallclock);
+	update_task_pred_demand(rq, p);
 	update_cpu_busy_time(p, rq, event, wallclock, irqtime);
 
+	if (rq->hmp_stats.cumulative_runnable_avg > prev_load)
+		sched_cluster_invalidate_load(rq);
+
+	if (rollover)
+		sched_freq_update(rq, wallclock);
+
 done:
 	trace_sched_update_task_ravg(p, rq, event, wallclock, irqtime);
 
@@ -2700,7 +3148,7 @@ unsigned long sched_get_busy(int cpu)
 	 */
 	raw_spin_lock_irqsave(&rq->lock, flags);
 	update_task_ravg(rq->curr, rq, TASK_UPDATE, sched_ktime_clock(), 0);
-	load = rq->old_busy_time = rq->prev_runnable_sum;
+	load = rq->old_busy_time = freq_busy_time(rq);
 
 	/*
 	 * Scale load in reference to cluster->max_possible_freq.
@@ -2725,6 +3173,10 @@ unsigned long sched_get_busy(int cpu)
 		rq->notifier_sent = 0;
 	}
 
+	/* boosted tasks clamp the demand in reference to cluster->max_freq */
+	load = max(load, scale_load_to_freq(rq_boost_load(rq), cpu_max_freq(cpu),
+					    cpu_max_possible_freq(cpu)));
+
 	load = div64_u64(load, NSEC_PER_USEC);
 
 	raw_spin_unlock_irqrestore(&rq->lock, flags);
@@ -3436,6 +3888,7 @@ static int select_fallback_rq(int cpu, struct task_struct *p)
 	int nid = cpu_to_node(cpu);
 	const struct cpumask *nodemask = NULL;
 	enum { cpuset, possible, fail } state = cpuset;
+	bool allow_isolated = false;
 	int dest_cpu;
 
 	/*
@@ -3452,6 +3905,8 @@ static int select_fallback_rq(int cpu, struct task_struct *p)
 				continue;
 			if (!cpu_active(dest_cpu))
 				continue;
+			if (cpu_isolated(dest_cpu))
+				continue;
 			if (cpumask_test_cpu(dest_cpu, tsk_cpus_allowed(p)))
 				return dest_cpu;
 		}
@@ -3464,9 +3919,17 @@ static int select_fallback_rq(int cpu, struct task_struct *p)
 				continue;
 			if (!cpu_active(dest_cpu))
 				continue;
+			if (!allow_isolated && cpu_isolated(dest_cpu))
+				continue;
 			goto out;
 		}
 
+		/* An isolated cpu still beats breaking the affinity */
+		if (!allow_isolated) {
+			allow_isolated = true;
+			continue;
+		}
+
 		switch (state) {
 		case cpuset:
 			/* No more Mr. Nice Guy. */
@@ -3520,7 +3983,8 @@ int select_task_rq(struct task_struct *p, int sd_flags, int wake_flags)
 	 *   not worry about this generic constraint ]
 	 */
 	if (unlikely(!cpumask_test_cpu(cpu, tsk_cpus_allowed(p)) ||
-		     !cpu_online(cpu)))
+		     !cpu_online(cpu) ||
+		     (cpu_isolated(cpu) && p->nr_cpus_allowed > 1)))
 		cpu = select_fallback_rq(task_cpu(p), p);
 
 	return cpu;
@@ -8039,6 +8503,210 @@ static int migration_cpu_stop(void *data)
 	return 0;
 }
 
+/*
+ * Core isolation
+ *
+ * An isolated cpu stays online but is left out of task placement and
+ * load balancing, receives no unbound timers or irqs, and has its
+ * migratable tasks pushed away. Tasks bound to it, such as per cpu
+ * kthreads, keep running there. Nothing per cpu is torn down, so a cpu
+ * can be isolated and brought back far faster than hotplug allows.
+ * Requests nest: a cpu is unisolated once every isolation is undone.
+ */
+static DEFINE_MUTEX(cpu_isolation_mutex);
+static DEFINE_PER_CPU(int, cpu_isolation_vote);
+
+/*
+ * The next queued task on @rq that may run elsewhere, deadline tasks
+ * first, then real time, then fair ones. Queued deadline and real time
+ * tasks that are not pinned are all on their class's pushable list; the
+ * first @dl_skip and @rt_skip entries there already failed to move.
+ */
+static struct task_struct *
+isolated_next_task(struct rq *rq, int dl_skip, int rt_skip)
+{
+	struct task_struct *p;
+	struct sched_entity *se;
+	struct rb_node *node;
+
+	for (node = rq->dl.pushable_dl_tasks_leftmost; node;
+	     node = rb_next(node)) {
+		if (dl_skip-- > 0)
+			continue;
+		return rb_entry(node, struct task_struct, pushable_dl_tasks);
+	}
+
+	plist_for_each_entry(p, &rq->rt.pushable_tasks, pushable_tasks) {
+		if (rt_skip-- > 0)
+			continue;
+		return p;
+	}
+
+	list_for_each_entry(se, &rq->cfs_tasks, group_node) {
+		p = container_of(se, struct task_struct, se);
+		if (p->nr_cpus_allowed > 1)
+			return p;
+	}
+
+	return NULL;
+}
+
+/*
+ * Push the queued tasks that may run elsewhere off @rq's cpu. Sleeping
+ * tasks are kept off it by select_task_rq() when they wake. A task that
+ * can't be moved is passed over: a fair one goes to the tail of
+ * cfs_tasks, the others are skipped in their pushable lists.
+ */
+static void migrate_isolated_tasks(struct rq *rq)
+{
+	int cpu = cpu_of(rq), dest_cpu, tries = rq->nr_running;
+	int dl_skip = 0, rt_skip = 0;
+	struct task_struct *p;
+	int moved;
+
+	while (tries-- > 0) {
+		p = isolated_next_task(rq, dl_skip, rt_skip);
+		if (!p)
+			break;
+
+		get_task_struct(p);
+
+		dest_cpu = select_fallback_rq(cpu, p);
+		if (dest_cpu != cpu) {
+			raw_spin_unlock(&rq->lock);
+			moved = __migrate_task(p, cpu, dest_cpu);
+			raw_spin_lock(&rq->lock);
+		} else {
+			moved = 0;
+		}
+
+		if (!moved && p->on_rq && task_rq(p) == rq) {
+			if (dl_task(p))
+				dl_skip++;
+			else if (rt_task(p))
+				rt_skip++;
+			else if (p->sched_class == &fair_sched_class)
+				list_move_tail(&p->se.group_node,
+					       &rq->cfs_tasks);
+		}
+
+		put_task_struct(p);
+	}
+}
+
+static int isolate_cpu_stop(void *data)
+{
+	struct rq *rq = this_rq();
+
+	local_irq_disable();
+	raw_spin_lock(&rq->lock);
+	migrate_isolated_tasks(rq);
+	raw_spin_unlock(&rq->lock);
+	local_irq_enable();
+
+	return 0;
+}
+
+/*
+ * sched_isolate_cpu - stop using @cpu for anything that can run elsewhere
+ *
+ * At least one online cpu is always left unisolated.
+ */
+int sched_isolate_cpu(int cpu)
+{
+	u64 start_time = sched_clock();
+	cpumask_t avail;
+	int ret = 0;
+
+	if (cpu < 0 || cpu >= nr_cpu_ids)
+		return -EINVAL;
+
+	get_online_cpus();
+	mutex_lock(&cpu_isolation_mutex);
+
+	if (per_cpu(cpu_isolation_vote, cpu)) {
+		per_cpu(cpu_isolation_vote, cpu)++;
+		goto out;
+	}
+
+	cpumask_andnot(&avail, cpu_online_mask, cpu_isolated_mask);
+	if (!cpu_online(cpu) || cpumask_weight(&avail) < 2) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	per_cpu(cpu_isolation_vote, cpu) = 1;
+	set_cpu_isolated(cpu, true);
+
+	stop_one_cpu(cpu, isolate_cpu_stop, NULL);
+	irq_update_isolated(cpu);
+
+out:
+	mutex_unlock(&cpu_isolation_mutex);
+	put_online_cpus();
+
+	trace_sched_isolate(cpu, cpumask_bits(cpu_isolated_mask)[0],
+			    start_time, 1, ret);
+
+	return ret;
+}
+EXPORT_SYMBOL(sched_isolate_cpu);
+
+/*
+ * sched_unisolate_cpu - undo one sched_isolate_cpu() of @cpu
+ *
+ * Irqs whose affinity includes @cpu may fire on it again.
+ */
+int sched_unisolate_cpu(int cpu)
+{
+	u64 start_time = sched_clock();
+	int ret = 0;
+
+	if (cpu < 0 || cpu >= nr_cpu_ids)
+		return -EINVAL;
+
+	mutex_lock(&cpu_isolation_mutex);
+
+	if (!per_cpu(cpu_isolation_vote, cpu)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (--per_cpu(cpu_isolation_vote, cpu))
+		goto out;
+
+	set_cpu_isolated(cpu, false);
+	irq_update_isolated(cpu);
+
+	/* let it pull work right away rather than at its next tick */
+	preempt_disable();
+	if (cpu_online(cpu))
+		smp_send_reschedule(cpu);
+	preempt_enable();
+
+out:
+	mutex_unlock(&cpu_isolation_mutex);
+
+	trace_sched_isolate(cpu, cpumask_bits(cpu_isolated_mask)[0],
+			    start_time, 0, ret);
+
+	return ret;
+}
+EXPORT_SYMBOL(sched_unisolate_cpu);
+
+#ifdef CONFIG_HOTPLUG_CPU
+/* A cpu that goes offline drops every isolation request on it */
+static void clear_cpu_isolation(int cpu)
+{
+	mutex_lock(&cpu_isolation_mutex);
+	if (per_cpu(cpu_isolation_vote, cpu)) {
+		per_cpu(cpu_isolation_vote, cpu) = 0;
+		set_cpu_isolated(cpu, false);
+	}
+	mutex_unlock(&cpu_isolation_mutex);
+}
+#endif
+
 #ifdef CONFIG_HOTPLUG_CPU
 
 /*
@@ -8376,6 +9044,7 @@ migration_call(struct notifier_block *nfb, unsigned long action, void *hcpu)
 
 	case CPU_DEAD:
 		clear_hmp_request(cpu);
+		clear_cpu_isolation(cpu);
 		calc_load_migrate(rq);
 		break;
 #endif
@@ -10169,6 +10838,8 @@ void __init sched_init(void)
 
 #endif /* CONFIG_CGROUP_SCHED */
 
+	sched_nr_avg_init();
+
 	for_each_possible_cpu(i) {
 		struct rq *rq;
 
@@ -10237,6 +10908,7 @@ void __init sched_init(void)
 #ifdef CONFIG_SCHED_HMP
 		cpumask_set_cpu(i, &rq->freq_domain_cpumask);
 		rq->hmp_stats.cumulative_runnable_avg = 0;
+		rq->hmp_stats.pred_demands_sum = 0;
 		rq->window_start = 0;
 		rq->hmp_stats.nr_small_tasks = rq->hmp_stats.nr_big_tasks = 0;
 		rq->hmp_flags = 0;
@@ -11103,6 +11775,48 @@ static int cpu_upmigrate_discourage_write_u64(struct cgroup *cgrp,
 	return 0;
 }
 
+static u64 cpu_boost_util_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+
+	return tg->boost_util;
+}
+
+/*
+ * Tasks of the group pick up a new boost from their next enqueue, which
+ * for the interactive threads this is meant for comes soon enough.
+ */
+static int cpu_boost_util_write_u64(struct cgroup *cgrp, struct cftype *cft,
+				    u64 boost_util)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+
+	if (boost_util > 100)
+		return -EINVAL;
+
+	tg->boost_util = boost_util;
+
+	return 0;
+}
+
+static u64 cpu_boost_prefer_big_read_u64(struct cgroup *cgrp,
+					 struct cftype *cft)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+
+	return tg->boost_prefer_big;
+}
+
+static int cpu_boost_prefer_big_write_u64(struct cgroup *cgrp,
+					  struct cftype *cft, u64 prefer_big)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+
+	tg->boost_prefer_big = prefer_big > 0;
+
+	return 0;
+}
+
 #endif	/* CONFIG_SCHED_HMP */
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -11394,6 +12108,16 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_upmigrate_discourage_read_u64,
 		.write_u64 = cpu_upmigrate_discourage_write_u64,
 	},
+	{
+		.name = "boost_util",
+		.read_u64 = cpu_boost_util_read_u64,
+		.write_u64 = cpu_boost_util_write_u64,
+	},
+	{
+		.name = "boost_prefer_big",
+		.read_u64 = cpu_boost_prefer_big_read_u64,
+		.write_u64 = cpu_boost_prefer_big_write_u64,
+	},
 #endif
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
@@ -1181,9 +1181,10 @@ static int find_later_rq(struct task_struct *task)
 	cpumask_copy(later_mask, task_rq(task)->rd->span);
 	cpumask_and(later_mask, later_mask, cpu_active_mask);
 	cpumask_and(later_mask, later_mask, &task->cpus_allowed);
+	cpumask_andnot(later_mask, later_mask, cpu_isolated_mask);
 	best_cpu = cpudl_find(&task_rq(task)->rd->cpudl,
 			task, later_mask);
-	if (best_cpu == -1)
+	if (best_cpu == -1 || cpu_isolated(best_cpu))
 		return -1;
 
 	/*
@@ -1412,6 +1413,10 @@ static int pull_dl_task(struct rq *this_rq)
 	if (likely(!dl_overloaded(this_rq)))
 		return 0;
 
+	/* an isolated cpu takes no work from others */
+	if (cpu_isolated(this_cpu))
+		return 0;
+
 	/*
 	 * Match the barrier from dl_set_overloaded; this guarantees that if we
 	 * see overloaded we must also see the dlo_mask bit.
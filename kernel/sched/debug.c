@@ -330,6 +330,8 @@ do {									\
 	P(hmp_stats.nr_small_tasks);
 	SEQ_printf(m, "  .%-30s: %llu\n", "hmp_stats.cumulative_runnable_avg",
 			rq->hmp_stats.cumulative_runnable_avg);
+	SEQ_printf(m, "  .%-30s: %llu\n", "hmp_stats.pred_demands_sum",
+			rq->hmp_stats.pred_demands_sum);
 #endif
 #undef P
 #undef PN
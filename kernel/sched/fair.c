@@ -1399,6 +1399,13 @@ unsigned int __read_mostly sysctl_sched_spill_nr_run = 10;
  */
 unsigned int __read_mostly sysctl_sched_enable_power_aware = 1;
 
+/*
+ * Place tasks that are not latency sensitive by the estimated energy
+ * delta of the per-cluster energy model. Has no effect until an energy
+ * model is present for every cluster the task may run on.
+ */
+unsigned int __read_mostly sysctl_sched_enable_energy_aware = 1;
+
 /*
  * This specifies the maximum percent power difference between 2
  * CPUs for them to be considered identical in terms of their
@@ -1560,6 +1567,58 @@ int sched_set_init_task_load(struct task_struct *p, int init_load_pct)
 	return 0;
 }
 
+u32 sched_get_task_boost_util(struct task_struct *p)
+{
+	return p->boost_util;
+}
+
+int sched_set_task_boost_util(struct task_struct *p, int util_pct)
+{
+	if (util_pct < 0 || util_pct > 100)
+		return -EINVAL;
+
+	if (util_pct > p->boost_util && !capable(CAP_SYS_NICE))
+		return -EPERM;
+
+	p->boost_util = util_pct;
+
+	return 0;
+}
+
+u32 sched_get_task_prefer_big(struct task_struct *p)
+{
+	return p->boost_prefer_big;
+}
+
+int sched_set_task_prefer_big(struct task_struct *p, int prefer_big)
+{
+	if (prefer_big && !p->boost_prefer_big && !capable(CAP_SYS_NICE))
+		return -EPERM;
+
+	p->boost_prefer_big = !!prefer_big;
+
+	return 0;
+}
+
+u32 sched_get_task_boost_inherit(struct task_struct *p)
+{
+	return p->boost_inherit;
+}
+
+/*
+ * Passing the boost on to children extends it just like raising it,
+ * so it needs the same privilege.
+ */
+int sched_set_task_boost_inherit(struct task_struct *p, int inherit)
+{
+	if (inherit && !p->boost_inherit && !capable(CAP_SYS_NICE))
+		return -EPERM;
+
+	p->boost_inherit = !!inherit;
+
+	return 0;
+}
+
 int sched_set_cpu_prefer_idle(int cpu, int prefer_idle)
 {
 	struct rq *rq = cpu_rq(cpu);
@@ -1649,6 +1708,27 @@ static inline int upmigrate_discouraged(struct task_struct *p)
 
 #endif
 
+static inline int task_boosted(struct task_struct *p)
+{
+	return task_boost_util(p) || task_boost_prefer_big(p);
+}
+
+/*
+ * Demand used to place a task: its window load raised to its predicted
+ * demand and to its boost clamp. Big/small task classification keeps
+ * using the plain load so that the rq counters stay consistent while
+ * the other two change.
+ */
+static inline u64 task_placement_load(struct task_struct *p)
+{
+	u64 load = task_load(p);
+
+	if (sysctl_sched_enable_prediction && !sched_use_pelt)
+		load = max_t(u64, load, p->ravg.pred_demand);
+
+	return max_t(u64, load, pct_to_real(task_boost_util(p)));
+}
+
 /* Is a task "big" on its current cpu */
 static inline int is_big_task(struct task_struct *p)
 {
@@ -1831,6 +1911,9 @@ static int task_load_will_fit(struct task_struct *p, u64 task_load, int cpu)
 	if (cpu_capacity(cpu) == max_capacity)
 		return 1;
 
+	if (task_boost_prefer_big(p))
+		return 0;
+
 	if (sched_boost()) {
 		if (cpu_capacity(cpu) > cpu_capacity(prev_cpu))
 			return 1;
@@ -1852,7 +1935,7 @@ static int task_load_will_fit(struct task_struct *p, u64 task_load, int cpu)
 
 static int task_will_fit(struct task_struct *p, int cpu)
 {
-	u64 tload = scale_load_to_cpu(task_load(p), cpu);
+	u64 tload = scale_load_to_cpu(task_placement_load(p), cpu);
 	return task_load_will_fit(p, tload, cpu);
 }
 
@@ -1914,11 +1997,42 @@ int power_delta_exceeded(unsigned int cpu_cost, unsigned int base_cost)
 	return abs(delta) > cost_limit;
 }
 
+static struct cpu_pstate_pwr *
+energy_state(struct sched_cluster_energy *em, unsigned int freq)
+{
+	int i;
+
+	for (i = 0; i < em->nr_states - 1; i++) {
+		if (em->states[i].freq >= freq)
+			break;
+	}
+
+	return &em->states[i];
+}
+
 unsigned int power_cost_at_freq(int cpu, unsigned int freq)
 {
 	int i = 0;
 	struct cpu_pwr_stats *per_cpu_info = get_cpu_pwr_stats();
+	struct sched_cluster_energy *em;
 	struct cpu_pstate_pwr *costs;
+	unsigned int power = 0;
+
+	if (!freq)
+		freq = min_max_freq;
+
+	/* Fall back to the cluster energy model before guessing */
+	if (sysctl_sched_enable_power_aware &&
+	    (!per_cpu_info || !per_cpu_info[cpu].ptable)) {
+		rcu_read_lock();
+		em = rcu_dereference(cpu_rq(cpu)->cluster->energy);
+		if (em)
+			power = energy_state(em, freq)->power;
+		rcu_read_unlock();
+
+		if (power)
+			return power;
+	}
 
 	if (!per_cpu_info || !per_cpu_info[cpu].ptable ||
 	    !sysctl_sched_enable_power_aware)
@@ -1930,9 +2044,6 @@ unsigned int power_cost_at_freq(int cpu, unsigned int freq)
 		return cpu_efficiency(cpu) *
 				(cpu_max_possible_freq(cpu) / 1024);
 
-	if (!freq)
-		freq = min_max_freq;
-
 	costs = per_cpu_info[cpu].ptable;
 
 	while (costs[i].freq != 0) {
@@ -1969,6 +2080,117 @@ unsigned int power_cost(u64 task_load, int cpu)
 	return power_cost_at_freq(cpu, task_freq);
 }
 
+/*
+ * Energy (power * usec) @cluster spends over one window when @extra
+ * load is added to @cpu. The cluster runs at the frequency its busiest
+ * cpu needs; each cpu pays busy power for its busy time at that
+ * frequency and idle power for the rest of the window.
+ */
+static u64 cluster_energy(struct sched_cluster *cluster,
+			  struct sched_cluster_energy *em, int cpu,
+			  u64 extra, int sync)
+{
+	u64 window = max_task_load(), max_load = 0, energy = 0;
+	unsigned int fmax = cluster->max_freq, freq;
+	struct cpu_pstate_pwr *state;
+	int i;
+
+	for_each_cpu_and(i, &cluster->cpus, cpu_online_mask) {
+		u64 load = cpu_load_sync(i, sync);
+
+		if (i == cpu)
+			load += extra;
+		max_load = max(max_load, load);
+	}
+
+	freq = div64_u64(min(max_load, window) * fmax, window);
+	state = energy_state(em, max(freq, cluster->min_freq));
+
+	for_each_cpu_and(i, &cluster->cpus, cpu_online_mask) {
+		u64 busy = cpu_load_sync(i, sync);
+
+		if (i == cpu)
+			busy += extra;
+		/* load is in reference to fmax, stretch it to state->freq */
+		busy = div64_u64(busy * fmax, state->freq);
+		busy = min(busy, window);
+
+		energy += busy * state->power +
+			  (window - busy) * em->idle_power;
+	}
+
+	return div64_u64(energy, NSEC_PER_USEC);
+}
+
+/*
+ * Estimated energy cost of waking @p on @cpu, or -1 if its cluster has
+ * no energy model. Caller must hold rcu_read_lock().
+ */
+static s64 sched_energy_delta(struct task_struct *p, int cpu, int sync)
+{
+	struct sched_cluster *cluster = cpu_rq(cpu)->cluster;
+	struct sched_cluster_energy *em = rcu_dereference(cluster->energy);
+	u64 tload;
+
+	if (!em)
+		return -1;
+
+	tload = scale_load_to_cpu(task_load(p), cpu);
+
+	return cluster_energy(cluster, em, cpu, tload, sync) -
+	       cluster_energy(cluster, em, cpu, 0, sync);
+}
+
+/*
+ * Pick the cpu where @p fits, without crossing the spill threshold, at
+ * the least estimated energy. Returns -1 when some candidate cluster
+ * has no energy model so that placement falls back to power_cost().
+ */
+static int energy_aware_cpu(struct task_struct *p, int sync, s64 *energy)
+{
+	struct sched_cluster *base_cluster = NULL;
+	struct sched_cluster_energy *em;
+	int i, best_cpu = -1, prev_cpu = task_cpu(p);
+	u64 tload;
+	s64 base = 0, delta, min_delta = LLONG_MAX;
+	cpumask_t search_cpus;
+
+	cpumask_and(&search_cpus, tsk_cpus_allowed(p), cpu_online_mask);
+	cpumask_andnot(&search_cpus, &search_cpus, cpu_isolated_mask);
+	for_each_cpu(i, &search_cpus) {
+		struct rq *rq = cpu_rq(i);
+
+		em = rcu_dereference(rq->cluster->energy);
+		if (!em)
+			return -1;
+
+		if (sched_cpu_high_irqload(i) || is_reserved(i))
+			continue;
+
+		tload = scale_load_to_cpu(task_placement_load(p), i);
+		if (!task_load_will_fit(p, tload, i) ||
+		    spill_threshold_crossed(tload, cpu_load_sync(i, sync), rq))
+			continue;
+
+		/* the energy without @p is common to a cluster's cpus */
+		if (rq->cluster != base_cluster) {
+			base_cluster = rq->cluster;
+			base = cluster_energy(base_cluster, em, i, 0, sync);
+		}
+
+		delta = cluster_energy(rq->cluster, em, i, tload, sync) - base;
+		if (delta < min_delta || (delta == min_delta && i == prev_cpu)) {
+			min_delta = delta;
+			best_cpu = i;
+		}
+	}
+
+	if (best_cpu >= 0)
+		*energy = min_delta;
+
+	return best_cpu;
+}
+
 static int best_small_task_cpu(struct task_struct *p, int sync)
 {
 	int best_busy_cpu = -1, fallback_cpu = -1;
@@ -1987,6 +2209,7 @@ static int best_small_task_cpu(struct task_struct *p, int sync)
 	hmp_capable = !cpumask_full(&temp);
 
 	cpumask_and(&search_cpu, tsk_cpus_allowed(p), cpu_online_mask);
+	cpumask_andnot(&search_cpu, &search_cpu, cpu_isolated_mask);
 	if (unlikely(!cpumask_test_cpu(i, &search_cpu))) {
 		i = cpumask_first(&search_cpu);
 		if (i >= nr_cpu_ids)
@@ -2035,6 +2258,7 @@ static int best_small_task_cpu(struct task_struct *p, int sync)
 		return min_cstate_cpu;
 
 	cpumask_and(&search_cpu, tsk_cpus_allowed(p), cpu_online_mask);
+	cpumask_andnot(&search_cpu, &search_cpu, cpu_isolated_mask);
 	cpumask_andnot(&search_cpu, &search_cpu, &fb_search_cpu);
 	for_each_cpu(i, &search_cpu) {
 		rq = cpu_rq(i);
@@ -2191,6 +2415,7 @@ static int select_packing_target(struct task_struct *p, int best_cpu)
 		return best_cpu;
 
 	cpumask_and(&search_cpus, tsk_cpus_allowed(p), cpu_online_mask);
+	cpumask_andnot(&search_cpus, &search_cpus, cpu_isolated_mask);
 	cpumask_and(&search_cpus, &search_cpus, &rq->freq_domain_cpumask);
 
 	/* Pick the first lowest power cpu as target */
@@ -2221,6 +2446,95 @@ static inline int wake_to_idle(struct task_struct *p)
 			 (p->flags & PF_WAKE_UP_IDLE);
 }
 
+/*
+ * Latency sensitive tasks keep the load/cstate based placement of
+ * select_best_cpu(); energy only decides for everyone else.
+ */
+static inline int
+energy_aware_wakeup(struct task_struct *p, int reason, int boost,
+		    struct sched_cluster *pref_cluster)
+{
+	return sysctl_sched_enable_energy_aware && !reason && !boost &&
+		!pref_cluster && !wake_to_idle(p) && !task_boosted(p) &&
+		TASK_NICE(p) >= 0;
+}
+
+static inline int pick_idle_cpu(struct cpumask *idle, int prev_cpu)
+{
+	int cpu;
+
+	if (cpumask_test_cpu(prev_cpu, idle) && idle_cpu(prev_cpu) &&
+	    !sched_cpu_high_irqload(prev_cpu))
+		return prev_cpu;
+
+	for_each_cpu(cpu, idle) {
+		if (idle_cpu(cpu) && !sched_cpu_high_irqload(cpu))
+			return cpu;
+	}
+
+	return -1;
+}
+
+/*
+ * Cluster first wakeup path: walk the clusters in power order and, in
+ * the first one the task fits, take a cpu straight from the cluster's
+ * wakeup summary instead of scanning all of them. Returns -1 when the
+ * summaries offer nothing, leaving the decision to the full scan.
+ */
+static int select_best_cluster_cpu(struct task_struct *p, int sync)
+{
+	int i, cpu, ll, prefer_idle, prev_cpu = task_cpu(p);
+	struct sched_cluster *cluster;
+	struct cpumask cpus, idle;
+	u64 tload, cpu_load;
+
+	for (i = 0; i < num_clusters; i++) {
+		cluster = ACCESS_ONCE(sched_cluster[i]);
+		if (!cluster)
+			continue;
+
+		cpumask_and(&cpus, &cluster->cpus, tsk_cpus_allowed(p));
+		cpumask_and(&cpus, &cpus, cpu_online_mask);
+		cpumask_andnot(&cpus, &cpus, cpu_isolated_mask);
+		cpu = cpumask_first(&cpus);
+		if (cpu >= nr_cpu_ids)
+			continue;
+
+		tload = scale_load_to_cpu(task_placement_load(p), cpu);
+		if (!task_load_will_fit(p, tload, cpu))
+			continue;
+
+		prefer_idle = cpu_rq(cpu)->prefer_idle;
+
+		ll = ACCESS_ONCE(cluster->least_loaded_cpu);
+		if (ll < 0 || !cpumask_test_cpu(ll, &cpus) ||
+		    sched_cpu_high_irqload(ll))
+			ll = -1;
+
+		if (ll >= 0) {
+			cpu_load = cpu_load_sync(ll, sync);
+			if (!prefer_idle &&
+			    mostly_idle_cpu_sync(ll, cpu_load, sync))
+				return ll;
+		}
+
+		cpumask_and(&idle, &cpus, &cluster->shallow_idle_cpus);
+		cpu = pick_idle_cpu(&idle, prev_cpu);
+		if (cpu >= 0)
+			return cpu;
+
+		cpumask_and(&idle, &cpus, &cluster->idle_cpus);
+		cpu = pick_idle_cpu(&idle, prev_cpu);
+		if (cpu >= 0)
+			return cpu;
+
+		if (ll >= 0 && eligible_cpu(tload, cpu_load, ll, sync))
+			return ll;
+	}
+
+	return -1;
+}
+
 /* return cheapest cpu that can fit this task */
 static int select_best_cpu(struct task_struct *p, int target, int reason,
 			   int sync)
@@ -2240,6 +2554,8 @@ static int select_best_cpu(struct task_struct *p, int target, int reason,
 	struct rq *trq;
 	struct related_thread_group *grp;
 	struct sched_cluster *pref_cluster = NULL;
+	int energy_aware = 0;
+	s64 energy = -1;
 
 	rcu_read_lock();	/* Protected access to p->grp */
 
@@ -2271,14 +2587,37 @@ static int select_best_cpu(struct task_struct *p, int target, int reason,
 		sync = 0;
 	}
 
+	/* boosted tasks are never packed as small tasks */
+	if (task_boosted(p))
+		small_task = 0;
+
+	if (energy_aware_wakeup(p, reason, boost, pref_cluster)) {
+		best_cpu = energy_aware_cpu(p, sync, &energy);
+		if (best_cpu >= 0) {
+			energy_aware = 1;
+			prefer_idle = 0;
+			goto out;
+		}
+	}
+
 	if (small_task && !boost) {
 		best_cpu = best_small_task_cpu(p, sync);
 		prefer_idle = 0;	/* For sched_task_load tracepoint */
 		goto done;
 	}
 
+	/* small tasks keep their packing placement above */
+	if (!reason && !boost && !pref_cluster && !prefer_idle_override) {
+		best_cpu = select_best_cluster_cpu(p, sync);
+		if (best_cpu >= 0) {
+			prefer_idle = 0;	/* For sched_task_load tracepoint */
+			goto done;
+		}
+	}
+
 	trq = task_rq(p);
 	cpumask_and(&search_cpus, tsk_cpus_allowed(p), cpu_online_mask);
+	cpumask_andnot(&search_cpus, &search_cpus, cpu_isolated_mask);
 	for_each_cpu(i, &search_cpus) {
 		struct rq *rq = cpu_rq(i);
 
@@ -2296,7 +2635,7 @@ static int select_best_cpu(struct task_struct *p, int target, int reason,
 			continue;
 		}
 
-		tload =  scale_load_to_cpu(task_load(p), i);
+		tload = scale_load_to_cpu(task_placement_load(p), i);
 		if (skip_cpu(trq, rq, i, tload, reason))
 			continue;
 
@@ -2440,6 +2779,12 @@ done:
 
 	if (cpu_mostly_idle_freq(best_cpu) && !prefer_idle_override)
 		best_cpu = select_packing_target(p, best_cpu);
+out:
+	if (trace_sched_energy_placement_enabled()) {
+		if (!energy_aware)
+			energy = sched_energy_delta(p, best_cpu, sync);
+		trace_sched_energy_placement(p, best_cpu, energy_aware, energy);
+	}
 
 	rcu_read_unlock();
 
@@ -2498,8 +2843,10 @@ dec_rq_hmp_stats(struct rq *rq, struct task_struct *p, int change_cra)
 static void reset_hmp_stats(struct hmp_sched_stats *stats, int reset_cra)
 {
 	stats->nr_big_tasks = stats->nr_small_tasks = 0;
-	if (reset_cra)
+	if (reset_cra) {
 		stats->cumulative_runnable_avg = 0;
+		stats->pred_demands_sum = 0;
+	}
 }
 
 
@@ -2920,7 +3267,8 @@ static inline int find_new_hmp_ilb(int call_cpu, int type)
 	for_each_domain(call_cpu, sd) {
 		for_each_cpu(i, sched_domain_span(sd)) {
 			dst_rq = cpu_rq(i);
-			if (!idle_cpu(i) || (type == NOHZ_KICK_RESTRICT
+			if (!idle_cpu(i) || cpu_isolated(i) ||
+			    (type == NOHZ_KICK_RESTRICT
 				  && cpu_capacity(i) > cpu_capacity(call_cpu)))
 				continue;
 
@@ -2962,6 +3310,7 @@ static int lower_power_cpu_available(struct task_struct *p, int cpu)
 	 * CPU which can be ensured by task_will_fit() prior to this.
 	 */
 	cpumask_and(&search_cpus, tsk_cpus_allowed(p), cpu_online_mask);
+	cpumask_andnot(&search_cpus, &search_cpus, cpu_isolated_mask);
 	cpumask_and(&search_cpus, &search_cpus, &rq->freq_domain_cpumask);
 	cpumask_clear_cpu(lowest_power_cpu, &search_cpus);
 
@@ -3008,6 +3357,9 @@ static inline int migration_needed(struct rq *rq, struct task_struct *p)
 		return 0;
 	}
 
+	if (task_boost_prefer_big(p) && cpu_capacity(cpu) != max_capacity)
+		return UP_MIGRATION;
+
 	if (!preferred_cluster(rq->cluster, p))
 		return PREFERRED_CLUSTER_MIGRATION;
 
@@ -3076,7 +3428,7 @@ void check_for_migration(struct rq *rq, struct task_struct *p)
 	raw_spin_lock(&migration_lock);
 	new_cpu = select_best_cpu(p, cpu, reason, 0);
 
-	if (new_cpu != cpu) {
+	if (new_cpu != cpu && !cpu_isolated(new_cpu)) {
 		active_balance = kick_active_balance(rq, p, new_cpu);
 		if (active_balance)
 			mark_reserved(new_cpu);
@@ -3215,6 +3567,11 @@ void init_new_task_load(struct task_struct *p)
 	u32 init_load_pct = current->init_load_pct;
 
 	p->init_load_pct = 0;
+	p->boost_bucket = 0;
+	if (!p->boost_inherit) {
+		p->boost_util = 0;
+		p->boost_prefer_big = 0;
+	}
 	memset(&p->ravg, 0, sizeof(struct ravg));
 	p->se.avg.decay_count	= 0;
 	p->grp = NULL;
@@ -3732,6 +4089,7 @@ static void init_cfs_rq_hmp_stats(struct cfs_rq *cfs_rq)
 	cfs_rq->hmp_stats.nr_big_tasks = 0;
 	cfs_rq->hmp_stats.nr_small_tasks = 0;
 	cfs_rq->hmp_stats.cumulative_runnable_avg = 0;
+	cfs_rq->hmp_stats.pred_demands_sum = 0;
 }
 
 static void inc_cfs_rq_hmp_stats(struct cfs_rq *cfs_rq,
@@ -3757,6 +4115,7 @@ static void inc_throttled_cfs_rq_hmp_stats(struct hmp_sched_stats *stats,
 	stats->nr_small_tasks += cfs_rq->hmp_stats.nr_small_tasks;
 	stats->cumulative_runnable_avg +=
 				cfs_rq->hmp_stats.cumulative_runnable_avg;
+	stats->pred_demands_sum += cfs_rq->hmp_stats.pred_demands_sum;
 }
 
 static void dec_throttled_cfs_rq_hmp_stats(struct hmp_sched_stats *stats,
@@ -3766,9 +4125,11 @@ static void dec_throttled_cfs_rq_hmp_stats(struct hmp_sched_stats *stats,
 	stats->nr_small_tasks -= cfs_rq->hmp_stats.nr_small_tasks;
 	stats->cumulative_runnable_avg -=
 				cfs_rq->hmp_stats.cumulative_runnable_avg;
+	stats->pred_demands_sum -= cfs_rq->hmp_stats.pred_demands_sum;
 
 	BUG_ON(stats->nr_big_tasks < 0 || stats->nr_small_tasks < 0 ||
-		(s64)stats->cumulative_runnable_avg < 0);
+		(s64)stats->cumulative_runnable_avg < 0 ||
+		(s64)stats->pred_demands_sum < 0);
 }
 
 #else	/* CONFIG_CFS_BANDWIDTH */
@@ -7880,6 +8241,9 @@ void idle_balance(int this_cpu, struct rq *this_rq)
 
 	this_rq->idle_stamp = rq_clock(this_rq);
 
+	if (cpu_isolated(this_cpu))
+		return;
+
 	if (this_rq->avg_idle < sysctl_sched_migration_cost ||
 	    !this_rq->rd->overload)
 		return;
@@ -8093,10 +8457,13 @@ static inline int find_new_ilb(int call_cpu, int type)
 	if (sched_enable_hmp)
 		return find_new_hmp_ilb(call_cpu, type);
 
-	ilb = cpumask_first(nohz.idle_cpus_mask);
-
-	if (ilb < nr_cpu_ids && idle_cpu(ilb))
-		return ilb;
+	for_each_cpu(ilb, nohz.idle_cpus_mask) {
+		if (cpu_isolated(ilb))
+			continue;
+		if (idle_cpu(ilb))
+			return ilb;
+		break;
+	}
 
 	return nr_cpu_ids;
 }
@@ -8339,7 +8706,8 @@ static void nohz_idle_balance(int this_cpu, enum cpu_idle_type idle)
 		balance_cpu = select_lowest_power_cpu(&cpus_to_balance);
 
 		cpumask_clear_cpu(balance_cpu, &cpus_to_balance);
-		if (balance_cpu == this_cpu || !idle_cpu(balance_cpu))
+		if (balance_cpu == this_cpu || !idle_cpu(balance_cpu) ||
+		    cpu_isolated(balance_cpu))
 			continue;
 
 		/*
@@ -8508,7 +8876,9 @@ static void run_rebalance_domains(struct softirq_action *h)
 	enum cpu_idle_type idle = this_rq->idle_balance ?
 						CPU_IDLE : CPU_NOT_IDLE;
 
-	rebalance_domains(this_cpu, idle);
+	/* an isolated cpu pulls no work for itself */
+	if (!cpu_isolated(this_cpu))
+		rebalance_domains(this_cpu, idle);
 
 	/*
 	 * If this cpu has a pending nohz_balance_kick, then do the
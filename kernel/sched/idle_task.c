@@ -16,6 +16,7 @@ select_task_rq_idle(struct task_struct *p, int sd_flag, int flags)
 
 static void pre_schedule_idle(struct rq *rq, struct task_struct *prev)
 {
+	sched_cluster_idle_exit(rq);
 	idle_exit_fair(rq);
 	rq_last_tick_reset(rq);
 }
@@ -23,6 +24,7 @@ static void pre_schedule_idle(struct rq *rq, struct task_struct *prev)
 static void post_schedule_idle(struct rq *rq)
 {
 	idle_enter_fair(rq);
+	sched_cluster_idle_enter(rq);
 }
 #endif /* CONFIG_SMP */
 /*
@@ -7,6 +7,7 @@
 #include <linux/spinlock.h>
 #include <linux/stop_machine.h>
 #include <linux/tick.h>
+#include <linux/cpu.h>
 
 #include "cpupri.h"
 #include "cpudeadline.h"
@@ -209,6 +210,9 @@ struct cfs_bandwidth {
 #endif
 };
 
+/* Boosted tasks are accounted per rq in 10% steps of their min utilization */
+#define SCHED_BOOST_BUCKETS	10
+
 /* task group related information */
 struct task_group {
 	struct cgroup_subsys_state css;
@@ -216,6 +220,8 @@ struct task_group {
 	bool notify_on_migrate;
 #ifdef CONFIG_SCHED_HMP
 	bool upmigrate_discouraged;
+	bool boost_prefer_big;
+	unsigned int boost_util;
 #endif
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -326,6 +332,19 @@ struct cfs_bandwidth { };
 struct hmp_sched_stats {
 	int nr_big_tasks, nr_small_tasks;
 	u64 cumulative_runnable_avg;
+	u64 pred_demands_sum;
+};
+
+/*
+ * Energy model of a cluster: busy power of one of its cpus at each
+ * frequency, in ascending frequency order, and the power of one idle
+ * cpu. Replaced as a whole under RCU.
+ */
+struct sched_cluster_energy {
+	struct rcu_head rcu;
+	unsigned int idle_power;
+	int nr_states;
+	struct cpu_pstate_pwr states[0];
 };
 
 struct sched_cluster {
@@ -343,8 +362,21 @@ struct sched_cluster {
 	 */
 	unsigned int cur_freq, max_freq, min_freq, max_possible_freq;
 	unsigned int mostly_idle_freq;
+	struct sched_cluster_energy __rcu *energy;
+
+	/*
+	 * Wakeup summary, maintained by the member cpus at enqueue/dequeue
+	 * and idle entry/exit without any lock. It is only a hint, so
+	 * select_best_cpu() revalidates the cpu it picks from it.
+	 */
+	struct cpumask idle_cpus;
+	struct cpumask shallow_idle_cpus;	/* idle, no deeper than C1 */
+	int least_loaded_cpu;
 };
 
+extern int num_clusters;
+extern struct sched_cluster *sched_cluster[NR_CPUS];
+
 extern unsigned long all_cluster_ids[];
 
 static inline int cluster_first_cpu(struct sched_cluster *cluster)
@@ -672,6 +704,7 @@ struct rq {
 	struct sched_cluster *cluster;
 	struct cpumask freq_domain_cpumask;
 	struct hmp_sched_stats hmp_stats;
+	unsigned int nr_boosted[SCHED_BOOST_BUCKETS];
 
 	u64 window_start;
 	int prefer_idle;
@@ -1026,6 +1059,8 @@ inc_cumulative_runnable_avg(struct hmp_sched_stats *stats,
 			(sched_disable_window_stats ? 0 : p->ravg.demand);
 
 	stats->cumulative_runnable_avg += task_load;
+	if (!sched_use_pelt)
+		stats->pred_demands_sum += p->ravg.pred_demand;
 }
 
 static inline void
@@ -1041,8 +1076,11 @@ dec_cumulative_runnable_avg(struct hmp_sched_stats *stats,
 			(sched_disable_window_stats ? 0 : p->ravg.demand);
 
 	stats->cumulative_runnable_avg -= task_load;
+	if (!sched_use_pelt)
+		stats->pred_demands_sum -= p->ravg.pred_demand;
 
 	BUG_ON((s64)stats->cumulative_runnable_avg < 0);
+	BUG_ON((s64)stats->pred_demands_sum < 0);
 }
 
 #define pct_to_real(tunable)	\
@@ -1205,6 +1243,54 @@ static inline void clear_reserved(int cpu)
 	clear_bit(CPU_RESERVED, &rq->hmp_flags);
 }
 
+/*
+ * Move the least loaded hint to @rq when it drops below the current
+ * one, or when there is no hint. Called where the load of @rq goes
+ * down; sched_cluster_invalidate_load() drops the hint where the load
+ * of its cpu goes up, so wakeups do not keep piling onto it.
+ */
+static inline void sched_cluster_update_load(struct rq *rq)
+{
+	struct sched_cluster *cluster = rq->cluster;
+	int ll = ACCESS_ONCE(cluster->least_loaded_cpu);
+
+	if (ll == cpu_of(rq))
+		return;
+
+	if (ll < 0 || !cpumask_test_cpu(ll, &cluster->cpus) ||
+	    rq->hmp_stats.cumulative_runnable_avg <
+			cpu_rq(ll)->hmp_stats.cumulative_runnable_avg)
+		cluster->least_loaded_cpu = cpu_of(rq);
+}
+
+static inline void sched_cluster_invalidate_load(struct rq *rq)
+{
+	if (ACCESS_ONCE(rq->cluster->least_loaded_cpu) == cpu_of(rq))
+		rq->cluster->least_loaded_cpu = -1;
+}
+
+static inline void sched_cluster_idle_enter(struct rq *rq)
+{
+	cpumask_set_cpu(cpu_of(rq), &rq->cluster->idle_cpus);
+	cpumask_set_cpu(cpu_of(rq), &rq->cluster->shallow_idle_cpus);
+	sched_cluster_update_load(rq);
+}
+
+static inline void sched_cluster_idle_exit(struct rq *rq)
+{
+	cpumask_clear_cpu(cpu_of(rq), &rq->cluster->shallow_idle_cpus);
+	cpumask_clear_cpu(cpu_of(rq), &rq->cluster->idle_cpus);
+}
+
+/* C-state index 1 is the shallowest low power mode */
+static inline void sched_cluster_update_cstate(struct rq *rq)
+{
+	if (rq->cstate > 1)
+		cpumask_clear_cpu(cpu_of(rq), &rq->cluster->shallow_idle_cpus);
+	else if (cpumask_test_cpu(cpu_of(rq), &rq->cluster->idle_cpus))
+		cpumask_set_cpu(cpu_of(rq), &rq->cluster->shallow_idle_cpus);
+}
+
 int mostly_idle_cpu(int cpu);
 extern void check_for_migration(struct rq *rq, struct task_struct *p);
 extern void pre_big_small_task_count_change(const struct cpumask *cpus);
@@ -1228,6 +1314,12 @@ static inline void set_hmp_defaults(void) { }
 
 static inline void clear_reserved(int cpu) { }
 
+static inline void sched_cluster_idle_enter(struct rq *rq) { }
+static inline void sched_cluster_idle_exit(struct rq *rq) { }
+static inline void sched_cluster_update_cstate(struct rq *rq) { }
+static inline void sched_cluster_update_load(struct rq *rq) { }
+static inline void sched_cluster_invalidate_load(struct rq *rq) { }
+
 static inline unsigned int power_cost(u64 task_load, int cpu)
 {
 	return SCHED_POWER_SCALE;
@@ -1295,6 +1387,71 @@ static inline bool task_notify_on_migrate(struct task_struct *p)
 }
 #endif /* CONFIG_CGROUP_SCHED */
 
+#ifdef CONFIG_SCHED_HMP
+
+/* A task is boosted by the larger of its own and its cpu cgroup's boost */
+static inline unsigned int task_boost_util(struct task_struct *p)
+{
+#ifdef CONFIG_CGROUP_SCHED
+	return max_t(unsigned int, p->boost_util, task_group(p)->boost_util);
+#else
+	return p->boost_util;
+#endif
+}
+
+static inline int task_boost_prefer_big(struct task_struct *p)
+{
+#ifdef CONFIG_CGROUP_SCHED
+	if (task_group(p)->boost_prefer_big)
+		return 1;
+#endif
+	return p->boost_prefer_big;
+}
+
+/*
+ * Enqueued boosted tasks are counted per bucket so that the frequency
+ * paths can raise a cpu's demand to the highest clamp runnable there.
+ * The bucket is remembered in the task, so a boost changed while the
+ * task is queued takes effect from its next enqueue.
+ */
+static inline void inc_rq_boost(struct rq *rq, struct task_struct *p)
+{
+	unsigned int bucket = DIV_ROUND_UP(task_boost_util(p) *
+					   SCHED_BOOST_BUCKETS, 100);
+
+	p->boost_bucket = bucket;
+	if (bucket)
+		rq->nr_boosted[bucket - 1]++;
+}
+
+static inline void dec_rq_boost(struct rq *rq, struct task_struct *p)
+{
+	if (p->boost_bucket)
+		rq->nr_boosted[p->boost_bucket - 1]--;
+	p->boost_bucket = 0;
+}
+
+/* Minimum window demand for @rq's cpu implied by its boosted tasks */
+static inline u64 rq_boost_load(struct rq *rq)
+{
+	int i;
+
+	for (i = SCHED_BOOST_BUCKETS; i > 0; i--) {
+		if (rq->nr_boosted[i - 1])
+			return div64_u64((u64)i * sched_ravg_window,
+					 SCHED_BOOST_BUCKETS);
+	}
+
+	return 0;
+}
+
+#else	/* CONFIG_SCHED_HMP */
+
+static inline void inc_rq_boost(struct rq *rq, struct task_struct *p) { }
+static inline void dec_rq_boost(struct rq *rq, struct task_struct *p) { }
+
+#endif	/* CONFIG_SCHED_HMP */
+
 static inline void __set_task_cpu(struct task_struct *p, unsigned int cpu)
 {
 	set_task_rq(p, cpu);
@@ -1660,6 +1817,7 @@ extern void sysrq_sched_debug_show(void);
 #endif
 extern void sched_init_granularity(void);
 extern void update_max_interval(void);
+extern void sched_nr_avg_init(void);
 
 extern void init_sched_dl_class(void);
 extern void init_sched_rt_class(void);
@@ -1728,6 +1886,7 @@ static inline void inc_nr_running(struct rq *rq)
 #ifdef CONFIG_INTELLI_HOTPLUG
 	write_seqcount_end(&nr_stats->ave_seqcnt);
 #endif
+	sched_cluster_invalidate_load(rq);
 
 	if (rq->nr_running >= 2) {
 #ifdef CONFIG_SMP
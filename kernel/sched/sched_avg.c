@@ -18,26 +18,67 @@
 #include <linux/hrtimer.h>
 #include <linux/sched.h>
 #include <linux/math64.h>
+#include <linux/seqlock.h>
 #include <trace/events/sched.h>
 
 #include "sched.h"
 
-static DEFINE_PER_CPU(u64, nr_prod_sum);
-static DEFINE_PER_CPU(u64, last_time);
-static DEFINE_PER_CPU(u64, nr_big_prod_sum);
-static DEFINE_PER_CPU(u64, nr);
-
-static DEFINE_PER_CPU(unsigned long, iowait_prod_sum);
-static DEFINE_PER_CPU(spinlock_t, nr_lock) = __SPIN_LOCK_UNLOCKED(nr_lock);
+/*
+ * Per cpu accumulation of nr_running, big task and iowait counts over
+ * time. Updates come from inc/dec_nr_running() under the cpu's rq->lock,
+ * which already serializes them, so the sums are only guarded by a
+ * seqcount for the readers. The sums are never reset: readers keep the
+ * values they saw last and work on the difference, which keeps them
+ * off the enqueue path entirely.
+ */
+struct nr_avg_stats {
+	seqcount_t seq;
+	u64 last_time;
+	u64 nr;
+	u64 nr_prod_sum;
+	u64 nr_big_prod_sum;
+	u64 iowait_prod_sum;
+	/* highest nr_running seen in epoch 'max_epoch' */
+	u64 nr_max;
+	unsigned int max_epoch;
+};
+
+static DEFINE_PER_CPU(struct nr_avg_stats, nr_avg_stats);
+
+/* Poller state and the per cpu results of the last poll */
+struct nr_avg_snap {
+	u64 nr_prod_sum;
+	u64 nr_big_prod_sum;
+	u64 iowait_prod_sum;
+	struct sched_nr_avg avg;
+};
+
+static DEFINE_PER_CPU(struct nr_avg_snap, nr_avg_snap);
+static unsigned int nr_max_epoch;
 static s64 last_get_time;
 
+/* Called from sched_init() before any task is enqueued */
+void __init sched_nr_avg_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		seqcount_init(&per_cpu(nr_avg_stats, cpu).seq);
+}
+
+static inline u64 div_avg(u64 sum, u64 diff)
+{
+	return div64_u64(sum * 100, diff);
+}
+
 /**
  * sched_get_nr_running_avg
  * @return: Average nr_running, iowait and nr_big_tasks value since last poll.
  *	    Returns the avg * 100 to return up to two decimal points
  *	    of accuracy.
  *
- * Obtains the average nr_running value since the last poll.
+ * Obtains the average nr_running value since the last poll and records
+ * the per cpu averages for sched_get_cluster_nr_running_avg().
  * This function may not be called concurrently with itself
  */
 void sched_get_nr_running_avg(int *avg, int *iowait_avg, int *big_avg)
@@ -46,6 +87,7 @@ void sched_get_nr_running_avg(int *avg, int *iowait_avg, int *big_avg)
 	u64 curr_time = sched_clock();
 	u64 diff = curr_time - last_get_time;
 	u64 tmp_avg = 0, tmp_iowait = 0, tmp_big_avg = 0;
+	unsigned int epoch = ACCESS_ONCE(nr_max_epoch);
 
 	*avg = 0;
 	*iowait_avg = 0;
@@ -54,39 +96,54 @@ void sched_get_nr_running_avg(int *avg, int *iowait_avg, int *big_avg)
 	if (!diff)
 		return;
 
-	/* read and reset nr_running counts */
 	for_each_possible_cpu(cpu) {
-		unsigned long flags;
-
-		spin_lock_irqsave(&per_cpu(nr_lock, cpu), flags);
-		curr_time = sched_clock();
-		diff = curr_time - per_cpu(last_time, cpu);
-		BUG_ON((s64)diff < 0);
-
-		tmp_avg += per_cpu(nr_prod_sum, cpu);
-		tmp_avg += per_cpu(nr, cpu) * diff;
-
-		tmp_big_avg += per_cpu(nr_big_prod_sum, cpu);
-		tmp_big_avg += nr_eligible_big_tasks(cpu) * diff;
-
-		tmp_iowait += per_cpu(iowait_prod_sum, cpu);
-		tmp_iowait +=  nr_iowait_cpu(cpu) * diff;
-
-		per_cpu(last_time, cpu) = curr_time;
-
-		per_cpu(nr_prod_sum, cpu) = 0;
-		per_cpu(nr_big_prod_sum, cpu) = 0;
-		per_cpu(iowait_prod_sum, cpu) = 0;
-
-		spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
+		struct nr_avg_stats *s = &per_cpu(nr_avg_stats, cpu);
+		struct nr_avg_snap *snap = &per_cpu(nr_avg_snap, cpu);
+		u64 nr_sum, big_sum, iowait_sum, nr_max, delta;
+		unsigned int seq;
+
+		do {
+			seq = read_seqcount_begin(&s->seq);
+			curr_time = sched_clock();
+			delta = curr_time - s->last_time;
+			if ((s64)delta < 0)
+				delta = 0;
+
+			nr_sum = s->nr_prod_sum + s->nr * delta;
+			big_sum = s->nr_big_prod_sum +
+				  nr_eligible_big_tasks(cpu) * delta;
+			iowait_sum = s->iowait_prod_sum +
+				     nr_iowait_cpu(cpu) * delta;
+			nr_max = s->nr;
+			if (s->max_epoch == epoch)
+				nr_max = max(nr_max, s->nr_max);
+		} while (read_seqcount_retry(&s->seq, seq));
+
+		snap->avg.avg = div_avg(nr_sum - snap->nr_prod_sum, diff);
+		snap->avg.big_avg = div_avg(big_sum - snap->nr_big_prod_sum,
+					    diff);
+		snap->avg.iowait_avg = div_avg(iowait_sum -
+					       snap->iowait_prod_sum, diff);
+		snap->avg.max = nr_max;
+
+		tmp_avg += nr_sum - snap->nr_prod_sum;
+		tmp_big_avg += big_sum - snap->nr_big_prod_sum;
+		tmp_iowait += iowait_sum - snap->iowait_prod_sum;
+
+		snap->nr_prod_sum = nr_sum;
+		snap->nr_big_prod_sum = big_sum;
+		snap->iowait_prod_sum = iowait_sum;
 	}
 
+	/* start a new window for the nr_running maxima */
+	ACCESS_ONCE(nr_max_epoch) = epoch + 1;
+
 	diff = curr_time - last_get_time;
 	last_get_time = curr_time;
 
-	*avg = (int)div64_u64(tmp_avg * 100, diff);
-	*big_avg = (int)div64_u64(tmp_big_avg * 100, diff);
-	*iowait_avg = (int)div64_u64(tmp_iowait * 100, diff);
+	*avg = (int)div_avg(tmp_avg, diff);
+	*big_avg = (int)div_avg(tmp_big_avg, diff);
+	*iowait_avg = (int)div_avg(tmp_iowait, diff);
 
 	trace_sched_get_nr_running_avg(*avg, *big_avg, *iowait_avg);
 
@@ -96,6 +153,34 @@ void sched_get_nr_running_avg(int *avg, int *iowait_avg, int *big_avg)
 }
 EXPORT_SYMBOL(sched_get_nr_running_avg);
 
+/**
+ * sched_get_cluster_nr_running_avg
+ * @cpus: The cpus to aggregate, typically a cluster.
+ * @stats: Sum of the cpus' averages and the highest nr_running seen on
+ *	   any of them over the interval of the last poll.
+ *
+ * Reads the results of the last sched_get_nr_running_avg() without
+ * taking any lock; it may race with a poll and mix two intervals.
+ */
+void sched_get_cluster_nr_running_avg(const struct cpumask *cpus,
+				      struct sched_nr_avg *stats)
+{
+	struct sched_nr_avg *avg;
+	int cpu;
+
+	memset(stats, 0, sizeof(*stats));
+
+	for_each_cpu(cpu, cpus) {
+		avg = &per_cpu(nr_avg_snap, cpu).avg;
+
+		stats->avg += ACCESS_ONCE(avg->avg);
+		stats->big_avg += ACCESS_ONCE(avg->big_avg);
+		stats->iowait_avg += ACCESS_ONCE(avg->iowait_avg);
+		stats->max = max(stats->max, ACCESS_ONCE(avg->max));
+	}
+}
+EXPORT_SYMBOL(sched_get_cluster_nr_running_avg);
+
 /**
  * sched_update_nr_prod
  * @cpu: The core id of the nr running driver.
@@ -103,27 +188,34 @@ EXPORT_SYMBOL(sched_get_nr_running_avg);
  * @inc: Whether we are increasing or decreasing the count
  * @return: N/A
  *
- * Update average with latest nr_running value for CPU
+ * Update average with latest nr_running value for CPU. Called with the
+ * cpu's rq->lock held.
  */
 void sched_update_nr_prod(int cpu, long delta, bool inc)
 {
-	u64 diff;
-	u64 curr_time;
-	unsigned long flags, nr_running;
+	struct nr_avg_stats *s = &per_cpu(nr_avg_stats, cpu);
+	unsigned int epoch = ACCESS_ONCE(nr_max_epoch);
+	u64 diff, curr_time, nr_running;
 
-	spin_lock_irqsave(&per_cpu(nr_lock, cpu), flags);
-	nr_running = per_cpu(nr, cpu);
+	write_seqcount_begin(&s->seq);
+	nr_running = s->nr;
 	curr_time = sched_clock();
-	diff = curr_time - per_cpu(last_time, cpu);
+	diff = curr_time - s->last_time;
 	BUG_ON((s64)diff < 0);
-	per_cpu(last_time, cpu) = curr_time;
-	per_cpu(nr, cpu) = nr_running + (inc ? delta : -delta);
+	s->last_time = curr_time;
+	s->nr = nr_running + (inc ? delta : -delta);
 
-	BUG_ON((s64)per_cpu(nr, cpu) < 0);
+	BUG_ON((s64)s->nr < 0);
 
-	per_cpu(nr_prod_sum, cpu) += nr_running * diff;
-	per_cpu(nr_big_prod_sum, cpu) += nr_eligible_big_tasks(cpu) * diff;
-	per_cpu(iowait_prod_sum, cpu) += nr_iowait_cpu(cpu) * diff;
-	spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
+	s->nr_prod_sum += nr_running * diff;
+	s->nr_big_prod_sum += nr_eligible_big_tasks(cpu) * diff;
+	s->iowait_prod_sum += nr_iowait_cpu(cpu) * diff;
+
+	if (s->max_epoch != epoch) {
+		s->max_epoch = epoch;
+		s->nr_max = nr_running;
+	}
+	s->nr_max = max(s->nr_max, s->nr);
+	write_seqcount_end(&s->seq);
 }
 EXPORT_SYMBOL(sched_update_nr_prod);
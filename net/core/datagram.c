@@ -56,6 +56,8 @@
 #include <net/sock.h>
 #include <net/tcp_states.h>
 #include <trace/events/skb.h>
+#include <net/busy_poll.h>
+#include <net/net_lat.h>
 
 /*
  *	Is a socket 'connection oriented' ?
@@ -232,8 +234,10 @@ struct sk_buff *__skb_recv_datagram(struct sock *sk, unsigned int flags,
 					goto unlock_err;
 
 				atomic_inc(&skb->users);
-			} else
+			} else {
 				__skb_unlink(skb, queue);
+				net_lat_stage(skb, NET_LAT_SK_DEQUEUE);
+			}
 
 			spin_unlock_irqrestore(&queue->lock, cpu_flags);
 			*off = _off;
@@ -241,6 +245,10 @@ struct sk_buff *__skb_recv_datagram(struct sock *sk, unsigned int flags,
 		}
 		spin_unlock_irqrestore(&queue->lock, cpu_flags);
 
+		if (sk_can_busy_loop(sk) &&
+		    sk_busy_loop(sk, flags & MSG_DONTWAIT))
+			continue;
+
 		/* User doesn't want to wait */
 		error = -EAGAIN;
 		if (!timeo)
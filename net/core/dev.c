@@ -129,6 +129,10 @@
 #include <linux/inetdevice.h>
 #include <linux/cpu_rmap.h>
 #include <linux/static_key.h>
+#include <linux/hashtable.h>
+#include <net/busy_poll.h>
+#include <net/net_lat.h>
+#include <net/netfilter/nf_flow_table.h>
 
 #include "net-sysfs.h"
 
@@ -144,6 +148,12 @@ struct list_head ptype_base[PTYPE_HASH_SIZE] __read_mostly;
 struct list_head ptype_all __read_mostly;	/* Taps */
 static struct list_head offload_base __read_mostly;
 
+/* protects napi_hash addition/deletion and napi_gen_id */
+static DEFINE_SPINLOCK(napi_hash_lock);
+
+static unsigned int napi_gen_id;
+static DEFINE_HASHTABLE(napi_hash, 8);
+
 /*
  * The @dev_base_head list is protected by @dev_base_lock and the rtnl
  * semaphore.
@@ -3202,6 +3212,7 @@ int netif_rx(struct sk_buff *skb)
 		return NET_RX_DROP;
 
 	net_timestamp_check(netdev_tstamp_prequeue, skb);
+	net_lat_rx(skb);
 
 	trace_netif_rx(skb);
 #ifdef CONFIG_RPS
@@ -3443,6 +3454,11 @@ void netdev_rx_handler_unregister(struct net_device *dev)
 }
 EXPORT_SYMBOL_GPL(netdev_rx_handler_unregister);
 
+#if IS_ENABLED(CONFIG_NF_FLOW_TABLE_IPV4)
+rx_handler_func_t __rcu *nf_flow_offload_hook __read_mostly;
+EXPORT_SYMBOL_GPL(nf_flow_offload_hook);
+#endif
+
 /*
  * Limit the use of PFMEMALLOC reserves to those protocols that implement
  * the special handling of PFMEMALLOC skbs.
@@ -3571,6 +3587,21 @@ ncls:
 		skb->vlan_tci = 0;
 	}
 
+#if IS_ENABLED(CONFIG_NF_FLOW_TABLE_IPV4)
+	rx_handler = rcu_dereference(nf_flow_offload_hook);
+	if (rx_handler && !pfmemalloc &&
+	    skb->protocol == cpu_to_be16(ETH_P_IP)) {
+		if (pt_prev) {
+			ret = deliver_skb(skb, pt_prev, orig_dev);
+			pt_prev = NULL;
+		}
+		if (rx_handler(&skb) == RX_HANDLER_CONSUMED) {
+			ret = NET_RX_SUCCESS;
+			goto out;
+		}
+	}
+#endif
+
 	/* deliver only exact match when indicated */
 	null_or_dev = deliver_exact ? skb->dev : NULL;
 
@@ -3609,6 +3640,8 @@ static int __netif_receive_skb(struct sk_buff *skb)
 {
 	int ret;
 
+	net_lat_stage(skb, NET_LAT_NETIF_RCV);
+
 	if (sk_memalloc_socks() && skb_pfmemalloc(skb)) {
 		unsigned long pflags = current->flags;
 
@@ -3650,6 +3683,7 @@ int netif_receive_skb(struct sk_buff *skb)
 	int ret;
 
 	net_timestamp_check(netdev_tstamp_prequeue, skb);
+	net_lat_rx(skb);
 
 	if (skb_defer_rx_timestamp(skb))
 		return NET_RX_SUCCESS;
@@ -3928,6 +3962,8 @@ static void skb_gro_reset_offset(struct sk_buff *skb)
 
 gro_result_t napi_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 {
+	net_lat_rx(skb);
+	skb_mark_napi_id(skb, napi);
 	skb_gro_reset_offset(skb);
 
 	return napi_skb_finish(dev_gro_receive(napi, skb), skb);
@@ -3943,6 +3979,9 @@ static void napi_reuse_skb(struct napi_struct *napi, struct sk_buff *skb)
 	skb->dev = napi->dev;
 	skb->skb_iif = 0;
 	skb->truesize = SKB_TRUESIZE(skb_end_offset(skb));
+#ifdef CONFIG_NET_LAT_PROBES
+	skb->lat_stamp = 0;
+#endif
 
 	napi->skb = skb;
 }
@@ -4029,6 +4068,9 @@ gro_result_t napi_gro_frags(struct napi_struct *napi)
 	if (!skb)
 		return GRO_DROP;
 
+	net_lat_rx(skb);
+	skb_mark_napi_id(skb, napi);
+
 	return napi_frags_finish(napi, skb, dev_gro_receive(napi, skb));
 }
 EXPORT_SYMBOL(napi_gro_frags);
@@ -4158,7 +4200,7 @@ void __napi_complete(struct napi_struct *n)
 	BUG_ON(!test_bit(NAPI_STATE_SCHED, &n->state));
 	BUG_ON(n->gro_list);
 
-	list_del(&n->poll_list);
+	list_del_init(&n->poll_list);
 	smp_mb__before_atomic();
 	sd->current_napi = NULL;
 	clear_bit(NAPI_STATE_SCHED, &n->state);
@@ -4183,6 +4225,119 @@ void napi_complete(struct napi_struct *n)
 }
 EXPORT_SYMBOL(napi_complete);
 
+/* must be called under rcu_read_lock(), as we dont take a reference */
+struct napi_struct *napi_by_id(unsigned int napi_id)
+{
+	unsigned int hash = napi_id % HASH_SIZE(napi_hash);
+	struct napi_struct *napi;
+
+	hlist_for_each_entry_rcu(napi, &napi_hash[hash], napi_hash_node)
+		if (napi->napi_id == napi_id)
+			return napi;
+
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(napi_by_id);
+
+void napi_hash_add(struct napi_struct *napi)
+{
+	if (!test_and_set_bit(NAPI_STATE_HASHED, &napi->state)) {
+
+		spin_lock(&napi_hash_lock);
+
+		/* 0 is not a valid id, we also skip an id that is taken
+		 * we expect both events to be extremely rare
+		 */
+		napi->napi_id = 0;
+		while (!napi->napi_id) {
+			napi->napi_id = ++napi_gen_id;
+			if (napi_by_id(napi->napi_id))
+				napi->napi_id = 0;
+		}
+
+		hlist_add_head_rcu(&napi->napi_hash_node,
+			&napi_hash[napi->napi_id % HASH_SIZE(napi_hash)]);
+
+		spin_unlock(&napi_hash_lock);
+	}
+}
+EXPORT_SYMBOL_GPL(napi_hash_add);
+
+/* Warning : caller is responsible to make sure rcu grace period
+ * is respected before freeing memory containing @napi
+ */
+void napi_hash_del(struct napi_struct *napi)
+{
+	spin_lock(&napi_hash_lock);
+
+	if (test_and_clear_bit(NAPI_STATE_HASHED, &napi->state))
+		hlist_del_rcu(&napi->napi_hash_node);
+
+	spin_unlock(&napi_hash_lock);
+}
+EXPORT_SYMBOL_GPL(napi_hash_del);
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+#define BUSY_POLL_BUDGET 8
+
+/**
+ *	sk_busy_loop - poll the NAPI context a socket last received from
+ *	@sk: socket to poll for
+ *	@nonblock: poll once instead of spinning up to sk_ll_usec
+ *
+ * Runs the driver's NAPI poll routine directly from process context,
+ * so packets reach @sk without waiting for the interrupt and softirq
+ * round trip. Returns true if the receive queue of @sk is non-empty.
+ */
+bool sk_busy_loop(struct sock *sk, int nonblock)
+{
+	unsigned long end_time = !nonblock ? sk_busy_loop_end_time(sk) : 0;
+	struct napi_struct *napi;
+	bool rc = false;
+	int work;
+
+	rcu_read_lock();
+
+	napi = napi_by_id(sk->sk_napi_id);
+	if (!napi)
+		goto out;
+
+	do {
+		work = 0;
+		local_bh_disable();
+		/* skip the context if it is disabled or already being
+		 * polled by its softirq or by another busy poller
+		 */
+		if (napi_schedule_prep(napi)) {
+			void *have = netpoll_poll_lock(napi);
+
+			work = napi->poll(napi, BUSY_POLL_BUDGET);
+			trace_napi_poll(napi);
+			/* the driver only completes when it ran out of
+			 * work, hand the rest back to net_rx_action()
+			 */
+			if (work == BUSY_POLL_BUDGET) {
+				napi_complete(napi);
+				napi_schedule(napi);
+			}
+			netpoll_poll_unlock(have);
+		}
+		if (work > 0)
+			NET_ADD_STATS_BH(sock_net(sk),
+					 LINUX_MIB_BUSYPOLLRXPACKETS, work);
+		local_bh_enable();
+		cpu_relax();
+	} while (!nonblock && skb_queue_empty(&sk->sk_receive_queue) &&
+		 !need_resched() && !busy_loop_timeout(end_time));
+
+	rc = !skb_queue_empty(&sk->sk_receive_queue);
+out:
+	rcu_read_unlock();
+	return rc;
+}
+EXPORT_SYMBOL(sk_busy_loop);
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
 void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 		    int (*poll)(struct napi_struct *, int), int weight)
 {
@@ -0,0 +1,216 @@
+/*
+ * Packet latency probes
+ *
+ * Sampled packets carry the time of the last probe point they passed in
+ * skb->lat_stamp; each later probe point counts the difference in a
+ * per-cpu histogram and restamps the packet. The stamp is cleared once
+ * the packet is handed to the reader of its socket. Drops are counted
+ * per kfree_skb() call site in a small per-cpu table, which needs no
+ * locking and no allocation in the fast path.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/export.h>
+#include <linux/hash.h>
+#include <linux/init.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <net/net_namespace.h>
+#include <net/net_lat.h>
+
+#define NET_LAT_DROP_BITS	5
+#define NET_LAT_DROP_SLOTS	(1 << NET_LAT_DROP_BITS)
+#define NET_LAT_DROP_PROBES	4
+
+struct net_lat_drop_site {
+	void		*location;
+	unsigned long	count;
+};
+
+struct net_lat_stats {
+	u32				hist[NET_LAT_STAGES][NET_LAT_BUCKETS];
+	struct net_lat_drop_site	drops[NET_LAT_DROP_SLOTS];
+	unsigned long			drops_other;
+};
+
+struct static_key net_lat_needed __read_mostly;
+EXPORT_SYMBOL(net_lat_needed);
+
+int sysctl_net_lat_sample __read_mostly;
+
+static DEFINE_PER_CPU(struct net_lat_stats, net_lat_stats);
+static DEFINE_PER_CPU(unsigned int, net_lat_seq);
+
+static const char *const net_lat_stage_names[NET_LAT_STAGES] = {
+	[NET_LAT_NETIF_RCV]	= "netif_rcv",
+	[NET_LAT_IP_RCV]	= "ip_rcv",
+	[NET_LAT_SK_ENQUEUE]	= "sk_enqueue",
+	[NET_LAT_SK_DEQUEUE]	= "sk_dequeue",
+};
+
+/* usec resolution is plenty and keeps the stamp in 32 bits */
+static inline u32 net_lat_clock(void)
+{
+	return (u32)(local_clock() >> 10) ? : 1;
+}
+
+static inline int net_lat_bucket(s32 usecs)
+{
+	if (usecs <= 0)
+		return 0;
+	return min_t(int, fls(usecs >> 3), NET_LAT_BUCKETS - 1);
+}
+
+void __net_lat_rx(struct sk_buff *skb)
+{
+	int rate = ACCESS_ONCE(sysctl_net_lat_sample);
+
+	/* GRO and RPS may bring the same packet through here twice */
+	if (skb->lat_stamp || rate <= 0)
+		return;
+
+	if (this_cpu_inc_return(net_lat_seq) % rate)
+		return;
+
+	skb->lat_stamp = net_lat_clock();
+}
+
+void __net_lat_stage(struct sk_buff *skb, int stage)
+{
+	u32 now = net_lat_clock();
+
+	this_cpu_inc(net_lat_stats.hist[stage]
+		     [net_lat_bucket((s32)(now - skb->lat_stamp))]);
+	skb->lat_stamp = stage == NET_LAT_SK_DEQUEUE ? 0 : now;
+}
+EXPORT_SYMBOL(__net_lat_stage);
+
+void __net_lat_drop(void *location)
+{
+	struct net_lat_stats *stats;
+	struct net_lat_drop_site *site;
+	unsigned long flags;
+	unsigned int slot;
+	int i;
+
+	/* kfree_skb() may run from any context, including an interrupt
+	 * taken while this cpu is claiming a slot.
+	 */
+	local_irq_save(flags);
+	stats = &__get_cpu_var(net_lat_stats);
+	slot = hash_ptr(location, NET_LAT_DROP_BITS);
+	for (i = 0; i < NET_LAT_DROP_PROBES; i++) {
+		site = &stats->drops[(slot + i) & (NET_LAT_DROP_SLOTS - 1)];
+		if (site->location == location || !site->location) {
+			site->location = location;
+			site->count++;
+			goto out;
+		}
+	}
+	stats->drops_other++;
+out:
+	local_irq_restore(flags);
+}
+
+static int net_lat_show(struct seq_file *seq, void *v)
+{
+	struct net_lat_drop_site *sites;
+	unsigned long other = 0;
+	int stage, b, cpu, i, j, nr = 0;
+	u64 sum;
+
+	sites = kcalloc(nr_cpu_ids * NET_LAT_DROP_SLOTS, sizeof(*sites),
+			GFP_KERNEL);
+	if (!sites)
+		return -ENOMEM;
+
+	seq_puts(seq, "usecs:");
+	for (b = 0; b < NET_LAT_BUCKETS - 1; b++)
+		seq_printf(seq, " <%u", 8U << b);
+	seq_printf(seq, " >=%u\n", 8U << (NET_LAT_BUCKETS - 2));
+
+	for (stage = 0; stage < NET_LAT_STAGES; stage++) {
+		seq_printf(seq, "%s:", net_lat_stage_names[stage]);
+		for (b = 0; b < NET_LAT_BUCKETS; b++) {
+			sum = 0;
+			for_each_possible_cpu(cpu) {
+				struct net_lat_stats *stats;
+
+				stats = &per_cpu(net_lat_stats, cpu);
+				sum += stats->hist[stage][b];
+			}
+			seq_printf(seq, " %llu", sum);
+		}
+		seq_putc(seq, '\n');
+	}
+
+	/* Merge the per-cpu drop tables by call site */
+	for_each_possible_cpu(cpu) {
+		struct net_lat_stats *stats = &per_cpu(net_lat_stats, cpu);
+
+		other += stats->drops_other;
+		for (i = 0; i < NET_LAT_DROP_SLOTS; i++) {
+			struct net_lat_drop_site *site = &stats->drops[i];
+
+			if (!site->location)
+				continue;
+			for (j = 0; j < nr; j++)
+				if (sites[j].location == site->location)
+					break;
+			if (j == nr)
+				sites[nr++].location = site->location;
+			sites[j].count += site->count;
+		}
+	}
+
+	seq_puts(seq, "drops:\n");
+	for (j = 0; j < nr; j++)
+		seq_printf(seq, "%10lu %pS\n", sites[j].count,
+			   sites[j].location);
+	seq_printf(seq, "%10lu other\n", other);
+
+	kfree(sites);
+	return 0;
+}
+
+static int net_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, net_lat_show, NULL);
+}
+
+/* Any write clears the histograms and the drop counts */
+static ssize_t net_lat_write(struct file *file, const char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(net_lat_stats, cpu), 0,
+		       sizeof(struct net_lat_stats));
+	return count;
+}
+
+static const struct file_operations net_lat_fops = {
+	.owner		= THIS_MODULE,
+	.open		= net_lat_open,
+	.read		= seq_read,
+	.write		= net_lat_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init net_lat_init(void)
+{
+	if (!proc_create("skb_latency", S_IRUGO | S_IWUSR, init_net.proc_net,
+			 &net_lat_fops))
+		return -ENOMEM;
+	return 0;
+}
+subsys_initcall(net_lat_init);
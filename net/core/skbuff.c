@@ -68,6 +68,7 @@
 #include <net/sock.h>
 #include <net/checksum.h>
 #include <net/xfrm.h>
+#include <net/net_lat.h>
 
 #include <asm/uaccess.h>
 #include <trace/events/skb.h>
@@ -609,6 +610,7 @@ void kfree_skb(struct sk_buff *skb)
 	else if (likely(!atomic_dec_and_test(&skb->users)))
 		return;
 	trace_kfree_skb(skb, __builtin_return_address(0));
+	net_lat_drop(__builtin_return_address(0));
 	__kfree_skb(skb);
 }
 EXPORT_SYMBOL(kfree_skb);
@@ -712,6 +714,13 @@ static void __copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 	new->vlan_tci		= old->vlan_tci;
 
 	skb_copy_secmark(new, old);
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	new->napi_id	= old->napi_id;
+#endif
+#ifdef CONFIG_NET_LAT_PROBES
+	new->lat_stamp	= old->lat_stamp;
+#endif
 }
 
 /*
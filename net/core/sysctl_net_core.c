@@ -19,6 +19,8 @@
 #include <net/ip.h>
 #include <net/sock.h>
 #include <net/net_ratelimit.h>
+#include <net/busy_poll.h>
+#include <net/net_lat.h>
 
 static int zero = 0;
 static int ushort_max = USHRT_MAX;
@@ -90,6 +92,28 @@ static int rps_sock_flow_sysctl(ctl_table *table, int write,
 }
 #endif /* CONFIG_RPS */
 
+#ifdef CONFIG_NET_LAT_PROBES
+static int net_lat_sysctl(ctl_table *table, int write,
+			  void __user *buffer, size_t *lenp, loff_t *ppos)
+{
+	static DEFINE_MUTEX(net_lat_mutex);
+	int ret, old;
+
+	mutex_lock(&net_lat_mutex);
+	old = sysctl_net_lat_sample;
+	ret = proc_dointvec_minmax(table, write, buffer, lenp, ppos);
+	if (write && !ret) {
+		if (!old && sysctl_net_lat_sample)
+			static_key_slow_inc(&net_lat_needed);
+		else if (old && !sysctl_net_lat_sample)
+			static_key_slow_dec(&net_lat_needed);
+	}
+	mutex_unlock(&net_lat_mutex);
+
+	return ret;
+}
+#endif /* CONFIG_NET_LAT_PROBES */
+
 static struct ctl_table net_core_table[] = {
 #ifdef CONFIG_NET
 	{
@@ -184,6 +208,34 @@ static struct ctl_table net_core_table[] = {
 	},
 #endif
 #endif /* CONFIG_NET */
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	{
+		.procname	= "busy_poll",
+		.data		= &sysctl_net_busy_poll,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.extra1		= &zero,
+		.proc_handler	= proc_dointvec_minmax
+	},
+	{
+		.procname	= "busy_read",
+		.data		= &sysctl_net_busy_read,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.extra1		= &zero,
+		.proc_handler	= proc_dointvec_minmax
+	},
+#endif
+#ifdef CONFIG_NET_LAT_PROBES
+	{
+		.procname	= "skb_latency_sample",
+		.data		= &sysctl_net_lat_sample,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.extra1		= &zero,
+		.proc_handler	= net_lat_sysctl
+	},
+#endif
 	{
 		.procname	= "netdev_budget",
 		.data		= &netdev_budget,
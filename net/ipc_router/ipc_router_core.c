@@ -26,6 +26,7 @@
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
 #include <linux/rwsem.h>
+#include <linux/rculist.h>
 #include <linux/ipc_logging.h>
 #include <linux/uaccess.h>
 #include <linux/ipc_router.h>
@@ -69,6 +70,12 @@ if (msm_ipc_router_debug_mask & RTR_DBG) \
 static LIST_HEAD(control_ports);
 static DECLARE_RWSEM(control_ports_lock_lha5);
 
+/* The local port, server and routing tables below are looked up under
+ * rcu_read_lock() on the send and receive paths. Their rw_semaphores
+ * only serialize the updaters and the slow paths that walk the tables,
+ * and entries are freed an RCU grace period after their last reference
+ * is dropped, so a reader must use kref_get_unless_zero().
+ */
 #define LP_HASH_SIZE 32
 static struct list_head local_ports[LP_HASH_SIZE];
 static DECLARE_RWSEM(local_ports_lock_lhc2);
@@ -91,6 +98,7 @@ struct msm_ipc_server {
 	int next_pdev_id;
 	int synced_sec_rule;
 	struct list_head server_port_list;
+	struct rcu_head rcu;
 };
 
 struct msm_ipc_server_port {
@@ -98,6 +106,7 @@ struct msm_ipc_server_port {
 	struct platform_device *pdev;
 	struct msm_ipc_port_addr server_addr;
 	struct msm_ipc_router_xprt_info *xprt_info;
+	struct rcu_head rcu;
 };
 
 struct msm_ipc_resume_tx_port {
@@ -129,6 +138,7 @@ struct msm_ipc_router_remote_port {
 	struct list_head conn_info_list;
 	void *sec_rule;
 	struct msm_ipc_server *server;
+	struct rcu_head rcu;
 };
 
 struct msm_ipc_router_xprt_info {
@@ -158,6 +168,7 @@ struct msm_ipc_routing_table_entry {
 	struct rw_semaphore lock_lha4;
 	unsigned long num_tx_bytes;
 	unsigned long num_rx_bytes;
+	struct rcu_head rcu;
 };
 
 #define LOG_CTX_NAME_LEN 32
@@ -358,14 +369,14 @@ static void ipc_router_log_msg(void *log_ctx, uint32_t xchng_type,
 	}
 }
 
-/* Must be called with routing_table_lock_lha3 locked. */
+/* Must be called with routing_table_lock_lha3 locked or under RCU. */
 static struct msm_ipc_routing_table_entry *lookup_routing_table(
 	uint32_t node_id)
 {
 	uint32_t key = (node_id % RT_HASH_SIZE);
 	struct msm_ipc_routing_table_entry *rt_entry;
 
-	list_for_each_entry(rt_entry, &routing_table[key], list) {
+	list_for_each_entry_rcu(rt_entry, &routing_table[key], list) {
 		if (rt_entry->node_id == node_id)
 			return rt_entry;
 	}
@@ -409,7 +420,7 @@ static struct msm_ipc_routing_table_entry *create_routing_table_entry(
 		rt_entry->neighbor_node_id = xprt_info->remote_node_id;
 
 	key = (node_id % RT_HASH_SIZE);
-	list_add_tail(&rt_entry->list, &routing_table[key]);
+	list_add_tail_rcu(&rt_entry->list, &routing_table[key]);
 out_create_rtentry1:
 	kref_get(&rt_entry->ref);
 out_create_rtentry2:
@@ -431,11 +442,11 @@ static struct msm_ipc_routing_table_entry *ipc_router_get_rtentry_ref(
 {
 	struct msm_ipc_routing_table_entry *rt_entry;
 
-	down_read(&routing_table_lock_lha3);
+	rcu_read_lock();
 	rt_entry = lookup_routing_table(node_id);
-	if (rt_entry)
-		kref_get(&rt_entry->ref);
-	up_read(&routing_table_lock_lha3);
+	if (rt_entry && !kref_get_unless_zero(&rt_entry->ref))
+		rt_entry = NULL;
+	rcu_read_unlock();
 	return rt_entry;
 }
 
@@ -456,7 +467,7 @@ void ipc_router_release_rtentry(struct kref *ref)
 	 * As part of SSR, all the internals of the routing table entry
 	 * are cleaned. So just free the routing table entry.
 	 */
-	kfree(rt_entry);
+	kfree_rcu(rt_entry, rcu);
 }
 
 struct rr_packet *rr_read(struct msm_ipc_router_xprt_info *xprt_info)
@@ -1093,10 +1104,15 @@ static int post_pkt_to_port(struct msm_ipc_port *port_ptr,
 		       size_t oob_data_len, void *priv);
 	void (*data_ready)(struct sock *sk, int bytes) = NULL;
 	struct sock *sk;
+	uint32_t type, size;
 
 	if (unlikely(!port_ptr || !pkt))
 		return -EINVAL;
 
+	/* An uncloned packet belongs to the reader once it is queued */
+	type = pkt->hdr.type;
+	size = pkt->hdr.size;
+
 	if (clone) {
 		temp_pkt = clone_pkt(pkt);
 		if (!temp_pkt) {
@@ -1121,9 +1137,9 @@ static int post_pkt_to_port(struct msm_ipc_port *port_ptr,
 	}
 	mutex_unlock(&port_ptr->port_rx_q_lock_lhc3);
 	if (notify)
-		notify(pkt->hdr.type, NULL, 0, port_ptr->priv);
+		notify(type, NULL, 0, port_ptr->priv);
 	else if (sk && data_ready)
-		data_ready(sk, pkt->hdr.size);
+		data_ready(sk, size);
 
 	return 0;
 }
@@ -1220,7 +1236,7 @@ void msm_ipc_router_add_local_port(struct msm_ipc_port *port_ptr)
 
 	key = (port_ptr->this_port.port_id & (LP_HASH_SIZE - 1));
 	down_write(&local_ports_lock_lhc2);
-	list_add_tail(&port_ptr->list, &local_ports[key]);
+	list_add_tail_rcu(&port_ptr->list, &local_ports[key]);
 	up_write(&local_ports_lock_lhc2);
 }
 
@@ -1296,15 +1312,16 @@ static struct msm_ipc_port *ipc_router_get_port_ref(uint32_t port_id)
 	int key = (port_id & (LP_HASH_SIZE - 1));
 	struct msm_ipc_port *port_ptr;
 
-	down_read(&local_ports_lock_lhc2);
-	list_for_each_entry(port_ptr, &local_ports[key], list) {
+	rcu_read_lock();
+	list_for_each_entry_rcu(port_ptr, &local_ports[key], list) {
 		if (port_ptr->this_port.port_id == port_id) {
-			kref_get(&port_ptr->ref);
-			up_read(&local_ports_lock_lhc2);
+			if (!kref_get_unless_zero(&port_ptr->ref))
+				break;
+			rcu_read_unlock();
 			return port_ptr;
 		}
 	}
-	up_read(&local_ports_lock_lhc2);
+	rcu_read_unlock();
 	return NULL;
 }
 
@@ -1329,7 +1346,7 @@ void ipc_router_release_port(struct kref *ref)
 	wakeup_source_unregister(port_ptr->port_rx_ws);
 	if (port_ptr->endpoint)
 		sock_put(ipc_port_sk(port_ptr->endpoint));
-	kfree(port_ptr);
+	kfree_rcu(port_ptr, rcu);
 }
 
 /**
@@ -1346,24 +1363,28 @@ static struct msm_ipc_router_remote_port *ipc_router_get_rport_ref(
 	struct msm_ipc_routing_table_entry *rt_entry;
 	int key = (port_id & (RP_HASH_SIZE - 1));
 
-	rt_entry = ipc_router_get_rtentry_ref(node_id);
+	/* Both the entry and its remote ports are freed after a grace
+	 * period, so no reference on the entry is needed for the walk.
+	 */
+	rcu_read_lock();
+	rt_entry = lookup_routing_table(node_id);
 	if (!rt_entry) {
+		rcu_read_unlock();
 		IPC_RTR_ERR("%s: Node is not up\n", __func__);
 		return NULL;
 	}
 
-	down_read(&rt_entry->lock_lha4);
-	list_for_each_entry(rport_ptr,
-			    &rt_entry->remote_port_list[key], list) {
+	list_for_each_entry_rcu(rport_ptr,
+				&rt_entry->remote_port_list[key], list) {
 		if (rport_ptr->port_id == port_id) {
-			kref_get(&rport_ptr->ref);
-			goto out_lookup_rmt_port1;
+			if (kref_get_unless_zero(&rport_ptr->ref))
+				goto out_lookup_rmt_port1;
+			break;
 		}
 	}
 	rport_ptr = NULL;
 out_lookup_rmt_port1:
-	up_read(&rt_entry->lock_lha4);
-	kref_put(&rt_entry->ref, ipc_router_release_rtentry);
+	rcu_read_unlock();
 	return rport_ptr;
 }
 
@@ -1412,8 +1433,8 @@ static struct msm_ipc_router_remote_port *ipc_router_create_rport(
 	mutex_init(&rport_ptr->rport_lock_lhb2);
 	INIT_LIST_HEAD(&rport_ptr->resume_tx_port_list);
 	INIT_LIST_HEAD(&rport_ptr->conn_info_list);
-	list_add_tail(&rport_ptr->list,
-		      &rt_entry->remote_port_list[key]);
+	list_add_tail_rcu(&rport_ptr->list,
+			  &rt_entry->remote_port_list[key]);
 out_create_rmt_port1:
 	kref_get(&rport_ptr->ref);
 out_create_rmt_port2:
@@ -1583,7 +1604,7 @@ static void ipc_router_release_rport(struct kref *ref)
 	msm_ipc_router_free_resume_tx_port(rport_ptr);
 	msm_ipc_router_free_conn_info(rport_ptr);
 	mutex_unlock(&rport_ptr->rport_lock_lhb2);
-	kfree(rport_ptr);
+	kfree_rcu(rport_ptr, rcu);
 }
 
 /**
@@ -1606,7 +1627,7 @@ static void ipc_router_destroy_rport(
 		return;
 	}
 	down_write(&rt_entry->lock_lha4);
-	list_del(&rport_ptr->list);
+	list_del_rcu(&rport_ptr->list);
 	up_write(&rt_entry->lock_lha4);
 	signal_rport_exit(rport_ptr);
 	kref_put(&rport_ptr->ref, ipc_router_release_rport);
@@ -1623,7 +1644,8 @@ static void ipc_router_destroy_rport(
  *
  * @return: If found Pointer to server structure, else NULL.
  *
- * Note1: Lock the server_list_lock_lha2 before accessing this function.
+ * Note1: Lock the server_list_lock_lha2 or hold rcu_read_lock() before
+ *        accessing this function.
  * Note2: If the <node_id:port_id> are <0:0>, then the lookup is restricted
  *        to <service:instance>. Used only when a client wants to send a
  *        message to any QMI server.
@@ -1638,14 +1660,14 @@ static struct msm_ipc_server *msm_ipc_router_lookup_server(
 	struct msm_ipc_server_port *server_port;
 	int key = (service & (SRV_HASH_SIZE - 1));
 
-	list_for_each_entry(server, &server_list[key], list) {
+	list_for_each_entry_rcu(server, &server_list[key], list) {
 		if ((server->name.service != service) ||
 		    (server->name.instance != instance))
 			continue;
 		if ((node_id == 0) && (port_id == 0))
 			return server;
-		list_for_each_entry(server_port, &server->server_port_list,
-				    list) {
+		list_for_each_entry_rcu(server_port,
+					&server->server_port_list, list) {
 			if ((server_port->server_addr.node_id == node_id) &&
 			    (server_port->server_addr.port_id == port_id))
 				return server;
@@ -1668,11 +1690,11 @@ static struct msm_ipc_server *ipc_router_get_server_ref(
 {
 	struct msm_ipc_server *server;
 
-	down_read(&server_list_lock_lha2);
+	rcu_read_lock();
 	server = msm_ipc_router_lookup_server(svc, ins, node_id, port_id);
-	if (server)
-		kref_get(&server->ref);
-	up_read(&server_list_lock_lha2);
+	if (server && !kref_get_unless_zero(&server->ref))
+		server = NULL;
+	rcu_read_unlock();
 	return server;
 }
 
@@ -1687,7 +1709,7 @@ static void ipc_router_release_server(struct kref *ref)
 	struct msm_ipc_server *server =
 		container_of(ref, struct msm_ipc_server, ref);
 
-	kfree(server);
+	kfree_rcu(server, rcu);
 }
 
 /**
@@ -1739,7 +1761,7 @@ static struct msm_ipc_server *msm_ipc_router_create_server(
 	server->synced_sec_rule = 0;
 	INIT_LIST_HEAD(&server->server_port_list);
 	kref_init(&server->ref);
-	list_add_tail(&server->list, &server_list[key]);
+	list_add_tail_rcu(&server->list, &server_list[key]);
 	scnprintf(server->pdev_name, sizeof(server->pdev_name),
 		  "SVC%08x:%08x", service, instance);
 	server->next_pdev_id = 1;
@@ -1752,8 +1774,8 @@ create_srv_port:
 		if (pdev)
 			platform_device_put(pdev);
 		if (list_empty(&server->server_port_list)) {
-			list_del(&server->list);
-			kfree(server);
+			list_del_rcu(&server->list);
+			kfree_rcu(server, rcu);
 		}
 		up_write(&server_list_lock_lha2);
 		IPC_RTR_ERR("%s: Server Port allocation failed\n", __func__);
@@ -1763,7 +1785,7 @@ create_srv_port:
 	server_port->server_addr.node_id = node_id;
 	server_port->server_addr.port_id = port_id;
 	server_port->xprt_info = xprt_info;
-	list_add_tail(&server_port->list, &server->server_port_list);
+	list_add_tail_rcu(&server_port->list, &server->server_port_list);
 	server->next_pdev_id++;
 	platform_device_add(server_port->pdev);
 
@@ -1803,11 +1825,11 @@ static void ipc_router_destroy_server_nolock(struct msm_ipc_server *server,
 	}
 	if (server_port_found && server_port) {
 		platform_device_unregister(server_port->pdev);
-		list_del(&server_port->list);
-		kfree(server_port);
+		list_del_rcu(&server_port->list);
+		kfree_rcu(server_port, rcu);
 	}
 	if (list_empty(&server->server_port_list)) {
-		list_del(&server->list);
+		list_del_rcu(&server->list);
 		kref_put(&server->ref, ipc_router_release_server);
 	}
 	return;
@@ -2152,7 +2174,7 @@ static void cleanup_rmt_ports(struct msm_ipc_router_xprt_info *xprt_info,
 	for (j = 0; j < RP_HASH_SIZE; j++) {
 		list_for_each_entry_safe(rport_ptr, tmp_rport_ptr,
 				&rt_entry->remote_port_list[j], list) {
-			list_del(&rport_ptr->list);
+			list_del_rcu(&rport_ptr->list);
 			mutex_lock(&rport_ptr->rport_lock_lhb2);
 			server = rport_ptr->server;
 			rport_ptr->server = NULL;
@@ -2198,7 +2220,7 @@ static void msm_ipc_cleanup_routing_table(
 			cleanup_rmt_ports(xprt_info, rt_entry);
 			rt_entry->xprt_info = NULL;
 			up_write(&rt_entry->lock_lha4);
-			list_del(&rt_entry->list);
+			list_del_rcu(&rt_entry->list);
 			kref_put(&rt_entry->ref, ipc_router_release_rtentry);
 		}
 	}
@@ -2825,6 +2847,17 @@ int msm_ipc_router_unregister_server(struct msm_ipc_port *port_ptr)
 	return 0;
 }
 
+/**
+ * loopback_data() - Deliver a packet to a port on the local node
+ * @src: Port sending the packet.
+ * @port_id: Destination port ID.
+ * @pkt: Packet to be delivered.
+ *
+ * @return: Size of the delivered message on success, < 0 on error.
+ *
+ * The packet, along with its skb chain, is queued on the destination port
+ * as is. On success the caller no longer owns @pkt.
+ */
 static int loopback_data(struct msm_ipc_port *src,
 			uint32_t port_id,
 			struct rr_packet *pkt)
@@ -2832,6 +2865,7 @@ static int loopback_data(struct msm_ipc_port *src,
 	struct msm_ipc_port *port_ptr;
 	struct sk_buff *temp_skb;
 	int align_size;
+	int size;
 
 	if (!pkt) {
 		IPC_RTR_ERR("%s: Invalid pkt pointer\n", __func__);
@@ -2849,11 +2883,12 @@ static int loopback_data(struct msm_ipc_port *src,
 						__func__, port_id);
 		return -ENODEV;
 	}
-	post_pkt_to_port(port_ptr, pkt, 1);
+	size = pkt->hdr.size;
+	post_pkt_to_port(port_ptr, pkt, 0);
 	update_comm_mode_info(&src->mode_info, NULL);
 	kref_put(&port_ptr->ref, ipc_router_release_port);
 
-	return pkt->hdr.size;
+	return size;
 }
 
 static int ipc_router_tx_wait(struct msm_ipc_port *src,
@@ -3051,21 +3086,24 @@ int msm_ipc_router_send_to(struct msm_ipc_port *src,
 		dst_node_id = dest->addr.port_addr.node_id;
 		dst_port_id = dest->addr.port_addr.port_id;
 	} else if (dest->addrtype == MSM_IPC_ADDR_NAME) {
-		server = ipc_router_get_server_ref(
+		rcu_read_lock();
+		server = msm_ipc_router_lookup_server(
 					dest->addr.port_name.service,
 					dest->addr.port_name.instance,
 					0, 0);
-		if (!server) {
+		server_port = server ? list_first_or_null_rcu(
+					&server->server_port_list,
+					struct msm_ipc_server_port,
+					list) : NULL;
+		if (!server_port) {
+			rcu_read_unlock();
 			IPC_RTR_ERR("%s: Destination not reachable\n",
 								__func__);
 			return -ENODEV;
 		}
-		server_port = list_first_entry(&server->server_port_list,
-					       struct msm_ipc_server_port,
-					       list);
 		dst_node_id = server_port->server_addr.node_id;
 		dst_port_id = server_port->server_addr.port_id;
-		kref_put(&server->ref, ipc_router_release_server);
+		rcu_read_unlock();
 	}
 
 	rport_ptr = ipc_router_get_rport_ref(dst_node_id, dst_port_id);
@@ -3109,6 +3147,8 @@ int msm_ipc_router_send_to(struct msm_ipc_port *src,
 	kref_put(&rport_ptr->ref, ipc_router_release_rport);
 	if (ret < 0)
 		pkt->pkt_fragment_q = NULL;
+	else if (dst_node_id == IPC_ROUTER_NID_LOCAL)
+		return ret;	/* queued on the destination port */
 	release_pkt(pkt);
 
 	return ret;
@@ -3389,7 +3429,7 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 
 	if (port_ptr->type == SERVER_PORT || port_ptr->type == CLIENT_PORT) {
 		down_write(&local_ports_lock_lhc2);
-		list_del(&port_ptr->list);
+		list_del_rcu(&port_ptr->list);
 		up_write(&local_ports_lock_lhc2);
 
 		mutex_lock(&port_ptr->port_lock_lhc3);
@@ -3424,7 +3464,7 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 		up_write(&control_ports_lock_lha5);
 	} else if (port_ptr->type == IRSC_PORT) {
 		down_write(&local_ports_lock_lhc2);
-		list_del(&port_ptr->list);
+		list_del_rcu(&port_ptr->list);
 		up_write(&local_ports_lock_lhc2);
 		signal_irsc_completion();
 	}
@@ -3479,8 +3519,12 @@ int msm_ipc_router_bind_control_port(struct msm_ipc_port *port_ptr)
 		return -EINVAL;
 
 	down_write(&local_ports_lock_lhc2);
-	list_del(&port_ptr->list);
+	list_del_rcu(&port_ptr->list);
 	up_write(&local_ports_lock_lhc2);
+	/* A lockless reader may still be on the port; let it leave the
+	 * local port hash before the entry is linked into another list.
+	 */
+	synchronize_rcu();
 	port_ptr->type = CONTROL_PORT;
 	down_write(&control_ports_lock_lha5);
 	list_add_tail(&port_ptr->list, &control_ports);
@@ -3508,15 +3552,15 @@ int msm_ipc_router_lookup_server_name(struct msm_ipc_port_name *srv_name,
 		return -EINVAL;
 	}
 
-	down_read(&server_list_lock_lha2);
+	rcu_read_lock();
 	key = (srv_name->service & (SRV_HASH_SIZE - 1));
-	list_for_each_entry(server, &server_list[key], list) {
+	list_for_each_entry_rcu(server, &server_list[key], list) {
 		if ((server->name.service != srv_name->service) ||
 		    ((server->name.instance & lookup_mask) !=
 			srv_name->instance))
 			continue;
 
-		list_for_each_entry(server_port,
+		list_for_each_entry_rcu(server_port,
 			&server->server_port_list, list) {
 			if (i < num_entries_in_array) {
 				srv_info[i].node_id =
@@ -3529,7 +3573,7 @@ int msm_ipc_router_lookup_server_name(struct msm_ipc_port_name *srv_name,
 			i++;
 		}
 	}
-	up_read(&server_list_lock_lha2);
+	rcu_read_unlock();
 
 	return i;
 }
@@ -143,6 +143,7 @@
 #include <net/checksum.h>
 #include <linux/netfilter_ipv4.h>
 #include <net/xfrm.h>
+#include <net/net_lat.h>
 #include <linux/mroute.h>
 #include <linux/netlink.h>
 
@@ -377,6 +378,8 @@ int ip_rcv(struct sk_buff *skb, struct net_device *dev, struct packet_type *pt,
 	const struct iphdr *iph;
 	u32 len;
 
+	net_lat_stage(skb, NET_LAT_IP_RCV);
+
 	/* When the interface is in promisc. mode, drop all the crap
 	 * that it receives, do not try to analyse it.
 	 */
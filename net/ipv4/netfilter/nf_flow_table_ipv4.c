@@ -0,0 +1,618 @@
+/*
+ * IPv4 flow offload table
+ *
+ * Forwarded TCP and UDP connections are entered into a hash table by the
+ * FLOWOFFLOAD target in the filter table's FORWARD chain, once conntrack
+ * has seen them established. Nothing is offloaded without a rule using
+ * the target, and only connections whose packets reach that rule are.
+ * Each direction is keyed by its conntrack tuple and input interface and
+ * caches the route and the NAT rewrite taken by the first packet. From
+ * then on, packets that match are rewritten and handed to the neighbour
+ * layer straight from __netif_receive_skb_core(), without going through
+ * ip_rcv(), the netfilter hooks or the routing lookup. Each of them still
+ * refreshes the conntrack timeout and counters, so the connection ages
+ * the same way it would on the slow path.
+ *
+ * A flow is torn down when a TCP FIN or RST is seen, when the connection
+ * leaves the established state or dies, when its route is invalidated or
+ * when one of its devices goes down; the slow path then takes over.
+ *
+ * Offloaded packets skip every netfilter hook, so rules added after a
+ * flow was offloaded never see it, and neither do rules that come after
+ * the target or sit in POSTROUTING. Flushing the conntrack table tears
+ * down every offloaded flow.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/types.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <linux/jhash.h>
+#include <linux/module.h>
+#include <linux/netdevice.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter_ipv4.h>
+#include <linux/netfilter/x_tables.h>
+#include <linux/random.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <net/arp.h>
+#include <net/checksum.h>
+#include <net/dst.h>
+#include <net/ip.h>
+#include <net/neighbour.h>
+#include <net/route.h>
+
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_core.h>
+#include <net/netfilter/nf_conntrack_ecache.h>
+#include <net/netfilter/nf_conntrack_helper.h>
+#include <net/netfilter/nf_conntrack_zones.h>
+#include <net/netfilter/nf_flow_table.h>
+
+#define NF_FLOW_HASH_BITS	10
+#define NF_FLOW_HASH_SIZE	(1 << NF_FLOW_HASH_BITS)
+
+static unsigned int nf_flow_max __read_mostly = 4096;
+module_param_named(max_flows, nf_flow_max, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(max_flows, "Maximum number of offloaded connections");
+
+struct nf_flow_tuple {
+	__be32			saddr;
+	__be32			daddr;
+	__be16			sport;
+	__be16			dport;
+	int			iifindex;
+	u8			l4proto;
+	u8			pad[3];
+};
+
+struct nf_flow_tuple_hash {
+	struct hlist_node	node;
+	struct nf_flow_tuple	tuple;
+	struct dst_entry __rcu	*dst;
+	__be32			nat_saddr;
+	__be32			nat_daddr;
+	__be16			nat_sport;
+	__be16			nat_dport;
+	u8			dir;
+};
+
+enum {
+	NF_FLOW_TEARDOWN,
+};
+
+struct nf_flow {
+	struct nf_flow_tuple_hash	tuplehash[IP_CT_DIR_MAX];
+	struct nf_conn			*ct;
+	unsigned long			flags;
+	unsigned long			timeout;
+	struct rcu_head			rcu;
+};
+
+static struct hlist_head nf_flow_table[NF_FLOW_HASH_SIZE];
+static DEFINE_SPINLOCK(nf_flow_lock);
+static atomic_t nf_flow_count = ATOMIC_INIT(0);
+static u32 nf_flow_hash_rnd __read_mostly;
+
+static void nf_flow_gc_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(nf_flow_gc, nf_flow_gc_work);
+
+static inline struct nf_flow *
+nf_flow_from_tuplehash(struct nf_flow_tuple_hash *th)
+{
+	return container_of(th, struct nf_flow, tuplehash[th->dir]);
+}
+
+static inline u32 nf_flow_hash(const struct nf_flow_tuple *t)
+{
+	return jhash2((const u32 *)t, sizeof(*t) / sizeof(u32),
+		      nf_flow_hash_rnd) & (NF_FLOW_HASH_SIZE - 1);
+}
+
+/* Must be called under rcu_read_lock() or with nf_flow_lock held */
+static struct nf_flow_tuple_hash *nf_flow_lookup(const struct nf_flow_tuple *t)
+{
+	struct nf_flow_tuple_hash *th;
+
+	hlist_for_each_entry_rcu(th, &nf_flow_table[nf_flow_hash(t)], node) {
+		if (!memcmp(&th->tuple, t, sizeof(*t)))
+			return th;
+	}
+	return NULL;
+}
+
+static void nf_flow_tuple_init(struct nf_flow_tuple_hash *th,
+			       const struct nf_conn *ct,
+			       enum ip_conntrack_dir dir, int iifindex)
+{
+	const struct nf_conntrack_tuple *t = &ct->tuplehash[dir].tuple;
+	const struct nf_conntrack_tuple *rt = &ct->tuplehash[!dir].tuple;
+
+	memset(&th->tuple, 0, sizeof(th->tuple));
+	th->tuple.saddr = t->src.u3.ip;
+	th->tuple.daddr = t->dst.u3.ip;
+	th->tuple.sport = t->src.u.all;
+	th->tuple.dport = t->dst.u.all;
+	th->tuple.l4proto = t->dst.protonum;
+	th->tuple.iifindex = iifindex;
+
+	/* Leaving in this direction, the packet looks like the inverse of
+	 * what the other direction arrives as.
+	 */
+	th->nat_saddr = rt->dst.u3.ip;
+	th->nat_daddr = rt->src.u3.ip;
+	th->nat_sport = rt->dst.u.all;
+	th->nat_dport = rt->src.u.all;
+	th->dir = dir;
+}
+
+static bool nf_flow_ct_eligible(struct nf_conn *ct)
+{
+	const struct nf_conn_help *help;
+
+	if (nf_ct_zone(ct) != NF_CT_DEFAULT_ZONE)
+		return false;
+	if (test_bit(IPS_SEQ_ADJUST_BIT, &ct->status))
+		return false;
+	if ((ct->status & IPS_NAT_MASK) &&
+	    (ct->status & IPS_NAT_DONE_MASK) != IPS_NAT_DONE_MASK)
+		return false;
+
+	/* Helpers need to see every packet */
+	help = nfct_help(ct);
+	if (help && rcu_access_pointer(help->helper))
+		return false;
+
+	switch (nf_ct_protonum(ct)) {
+	case IPPROTO_TCP:
+		return ct->proto.tcp.state == TCP_CONNTRACK_ESTABLISHED;
+	case IPPROTO_UDP:
+		return true;
+	}
+	return false;
+}
+
+static bool nf_flow_dst_eligible(const struct dst_entry *dst)
+{
+	const struct rtable *rt = (const struct rtable *)dst;
+
+	return dst && rt->rt_type == RTN_UNICAST && !dst_xfrm(dst) &&
+	       !(rt->rt_flags & RTCF_DOREDIRECT);
+}
+
+static void nf_flow_free_rcu(struct rcu_head *head)
+{
+	struct nf_flow *flow = container_of(head, struct nf_flow, rcu);
+	int dir;
+
+	for (dir = 0; dir < IP_CT_DIR_MAX; dir++)
+		dst_release(rcu_dereference_protected(
+				flow->tuplehash[dir].dst, 1));
+	nf_ct_put(flow->ct);
+	kfree(flow);
+}
+
+/* Must be called with nf_flow_lock held */
+static void nf_flow_del(struct nf_flow *flow)
+{
+	hlist_del_rcu(&flow->tuplehash[IP_CT_DIR_ORIGINAL].node);
+	hlist_del_rcu(&flow->tuplehash[IP_CT_DIR_REPLY].node);
+	atomic_dec(&nf_flow_count);
+	call_rcu(&flow->rcu, nf_flow_free_rcu);
+}
+
+static void nf_flow_add(struct nf_conn *ct, enum ip_conntrack_dir dir,
+			const struct net_device *in, struct sk_buff *skb)
+{
+	struct dst_entry *dst = skb_dst(skb);
+	struct nf_flow_tuple_hash *th, key;
+	struct nf_flow *flow;
+	long timeout;
+
+	/* Most packets that get here belong to a flow already offloaded
+	 * in their direction but which the fast path declined.
+	 */
+	nf_flow_tuple_init(&key, ct, dir, in->ifindex);
+	th = nf_flow_lookup(&key.tuple);
+	if (th && rcu_access_pointer(th->dst))
+		return;
+
+	flow = kzalloc(sizeof(*flow), GFP_ATOMIC);
+	if (!flow)
+		return;
+
+	nf_flow_tuple_init(&flow->tuplehash[dir], ct, dir, in->ifindex);
+	nf_flow_tuple_init(&flow->tuplehash[!dir], ct, !dir,
+			   dst->dev->ifindex);
+
+	spin_lock_bh(&nf_flow_lock);
+	th = nf_flow_lookup(&flow->tuplehash[dir].tuple);
+	if (th) {
+		/* First packet seen in the other direction of a flow */
+		if (nf_flow_from_tuplehash(th)->ct == ct &&
+		    !rcu_access_pointer(th->dst))
+			rcu_assign_pointer(th->dst, dst_clone(dst));
+		goto out_free;
+	}
+	if (nf_flow_lookup(&flow->tuplehash[!dir].tuple) ||
+	    atomic_read(&nf_flow_count) >= nf_flow_max)
+		goto out_free;
+
+	/* Conntrack only hears about offloaded packets through refreshes
+	 * from now on, so stop it from validating TCP windows once the
+	 * flow falls back to the slow path.
+	 */
+	if (nf_ct_protonum(ct) == IPPROTO_TCP) {
+		spin_lock(&ct->lock);
+		ct->proto.tcp.seen[0].flags |= IP_CT_TCP_FLAG_BE_LIBERAL;
+		ct->proto.tcp.seen[1].flags |= IP_CT_TCP_FLAG_BE_LIBERAL;
+		spin_unlock(&ct->lock);
+	}
+
+	/* The packet was just refreshed by conntrack, so what is left of
+	 * the timer is the timeout of the current protocol state. UDP is
+	 * the exception: the first reply was refreshed before conntrack
+	 * marked the reply seen, with the unreplied timeout, and conntrack
+	 * won't see the packets that would make it assured. Do both here.
+	 */
+	if (nf_ct_protonum(ct) == IPPROTO_UDP) {
+		timeout = nf_ct_net(ct)->ct.nf_ct_proto.udp.timeouts[
+							UDP_CT_REPLIED];
+		if (!test_and_set_bit(IPS_ASSURED_BIT, &ct->status))
+			nf_conntrack_event_cache(IPCT_ASSURED, ct);
+		nf_ct_refresh(ct, skb, timeout);
+	} else {
+		timeout = (long)(ct->timeout.expires - jiffies);
+	}
+	if (timeout <= 0)
+		goto out_free;
+	flow->timeout = timeout;
+
+	nf_conntrack_get(&ct->ct_general);
+	flow->ct = ct;
+	rcu_assign_pointer(flow->tuplehash[dir].dst, dst_clone(dst));
+
+	hlist_add_head_rcu(&flow->tuplehash[IP_CT_DIR_ORIGINAL].node,
+		&nf_flow_table[nf_flow_hash(
+			&flow->tuplehash[IP_CT_DIR_ORIGINAL].tuple)]);
+	hlist_add_head_rcu(&flow->tuplehash[IP_CT_DIR_REPLY].node,
+		&nf_flow_table[nf_flow_hash(
+			&flow->tuplehash[IP_CT_DIR_REPLY].tuple)]);
+	atomic_inc(&nf_flow_count);
+	spin_unlock_bh(&nf_flow_lock);
+	return;
+
+out_free:
+	spin_unlock_bh(&nf_flow_lock);
+	kfree(flow);
+}
+
+static unsigned int
+flowoffload_tg(struct sk_buff *skb, const struct xt_action_param *par)
+{
+	enum ip_conntrack_info ctinfo;
+	struct nf_conn *ct;
+
+	ct = nf_ct_get(skb, &ctinfo);
+	if (!ct || nf_ct_is_untracked(ct))
+		return XT_CONTINUE;
+	if (ctinfo != IP_CT_ESTABLISHED && ctinfo != IP_CT_ESTABLISHED_REPLY)
+		return XT_CONTINUE;
+	if (!nf_flow_ct_eligible(ct) || !nf_flow_dst_eligible(skb_dst(skb)))
+		return XT_CONTINUE;
+
+	nf_flow_add(ct, CTINFO2DIR(ctinfo), par->in, skb);
+	return XT_CONTINUE;
+}
+
+static int flowoffload_tg_check(const struct xt_tgchk_param *par)
+{
+	int ret;
+
+	ret = nf_ct_l3proto_try_module_get(par->family);
+	if (ret < 0)
+		pr_info("cannot load conntrack support for proto=%u\n",
+			par->family);
+	return ret;
+}
+
+static void flowoffload_tg_destroy(const struct xt_tgdtor_param *par)
+{
+	nf_ct_l3proto_module_put(par->family);
+}
+
+static inline void nf_flow_nat_addr(struct sk_buff *skb, struct iphdr *iph,
+				    __be32 *addr, __be32 new, __sum16 *check)
+{
+	if (*addr == new)
+		return;
+	if (check)
+		inet_proto_csum_replace4(check, skb, *addr, new, 1);
+	csum_replace4(&iph->check, *addr, new);
+	*addr = new;
+}
+
+static inline void nf_flow_nat_port(struct sk_buff *skb, __be16 *port,
+				    __be16 new, __sum16 *check)
+{
+	if (*port == new)
+		return;
+	if (check)
+		inet_proto_csum_replace2(check, skb, *port, new, 0);
+	*port = new;
+}
+
+static void nf_flow_nat(struct sk_buff *skb,
+			const struct nf_flow_tuple_hash *th,
+			unsigned int thoff)
+{
+	struct iphdr *iph = ip_hdr(skb);
+	__be16 *ports = (__be16 *)(skb->data + thoff);
+	__sum16 *check = NULL;
+
+	if (iph->protocol == IPPROTO_TCP) {
+		check = &((struct tcphdr *)(skb->data + thoff))->check;
+	} else {
+		struct udphdr *uh = (struct udphdr *)(skb->data + thoff);
+
+		if (uh->check || skb->ip_summed == CHECKSUM_PARTIAL)
+			check = &uh->check;
+	}
+
+	nf_flow_nat_addr(skb, iph, &iph->saddr, th->nat_saddr, check);
+	nf_flow_nat_addr(skb, iph, &iph->daddr, th->nat_daddr, check);
+	nf_flow_nat_port(skb, &ports[0], th->nat_sport, check);
+	nf_flow_nat_port(skb, &ports[1], th->nat_dport, check);
+
+	if (check && iph->protocol == IPPROTO_UDP && !*check)
+		*check = CSUM_MANGLED_0;
+}
+
+static rx_handler_result_t nf_flow_offload_rx(struct sk_buff **pskb)
+{
+	struct sk_buff *skb = *pskb;
+	struct nf_flow_tuple_hash *th;
+	struct nf_flow_tuple tuple;
+	struct dst_entry *dst;
+	struct neighbour *neigh;
+	struct nf_flow *flow;
+	struct iphdr *iph;
+	unsigned int thoff, hdrsize, len;
+	__be16 *ports;
+	u32 nexthop;
+
+	if (!atomic_read(&nf_flow_count) ||
+	    skb->pkt_type != PACKET_HOST || skb_shared(skb))
+		return RX_HANDLER_PASS;
+
+	/* ip_rcv() is skipped, so do its header checks here */
+	if (!pskb_may_pull(skb, sizeof(struct iphdr)))
+		return RX_HANDLER_PASS;
+	skb_reset_network_header(skb);
+	iph = ip_hdr(skb);
+	if (iph->ihl != 5 || iph->version != 4 || ip_is_fragment(iph) ||
+	    iph->ttl <= 1)
+		return RX_HANDLER_PASS;
+
+	switch (iph->protocol) {
+	case IPPROTO_TCP:
+		hdrsize = sizeof(struct tcphdr);
+		break;
+	case IPPROTO_UDP:
+		hdrsize = sizeof(struct udphdr);
+		break;
+	default:
+		return RX_HANDLER_PASS;
+	}
+
+	len = ntohs(iph->tot_len);
+	thoff = sizeof(struct iphdr);
+	if (skb->len < len || len < thoff + hdrsize ||
+	    ip_fast_csum((u8 *)iph, iph->ihl))
+		return RX_HANDLER_PASS;
+	if (!pskb_may_pull(skb, thoff + hdrsize))
+		return RX_HANDLER_PASS;
+	iph = ip_hdr(skb);
+	ports = (__be16 *)(skb->data + thoff);
+
+	memset(&tuple, 0, sizeof(tuple));
+	tuple.saddr = iph->saddr;
+	tuple.daddr = iph->daddr;
+	tuple.sport = ports[0];
+	tuple.dport = ports[1];
+	tuple.l4proto = iph->protocol;
+	tuple.iifindex = skb->dev->ifindex;
+
+	th = nf_flow_lookup(&tuple);
+	if (!th)
+		return RX_HANDLER_PASS;
+	flow = nf_flow_from_tuplehash(th);
+	if (test_bit(NF_FLOW_TEARDOWN, &flow->flags) ||
+	    !net_eq(dev_net(skb->dev), nf_ct_net(flow->ct)))
+		return RX_HANDLER_PASS;
+
+	dst = rcu_dereference(th->dst);
+	if (!dst)
+		return RX_HANDLER_PASS;
+	if (iph->protocol == IPPROTO_TCP) {
+		const struct tcphdr *tcph = (struct tcphdr *)ports;
+
+		if (unlikely(tcph->fin || tcph->rst))
+			goto teardown;
+	}
+	if (unlikely(nf_ct_is_dying(flow->ct) || !dst_check(dst, 0)))
+		goto teardown;
+	if (unlikely(!(dst->dev->flags & IFF_UP)))
+		return RX_HANDLER_PASS;
+	if (len > dst_mtu(dst) && !skb_is_gso(skb))
+		return RX_HANDLER_PASS;
+
+	if (pskb_trim_rcsum(skb, len) ||
+	    !skb_make_writable(skb, thoff + hdrsize) ||
+	    skb_cow_head(skb, LL_RESERVED_SPACE(dst->dev)))
+		return RX_HANDLER_PASS;
+
+	rcu_read_lock_bh();
+	nexthop = (__force u32) rt_nexthop((struct rtable *)dst,
+					   th->nat_daddr);
+	neigh = __ipv4_neigh_lookup_noref(dst->dev, nexthop);
+	if (unlikely(!neigh)) {
+		rcu_read_unlock_bh();
+		return RX_HANDLER_PASS;
+	}
+
+	skb_forward_csum(skb);
+	nf_flow_nat(skb, th, thoff);
+	iph = ip_hdr(skb);
+	ip_decrease_ttl(iph);
+	skb->priority = rt_tos2priority(iph->tos);
+
+	nf_ct_refresh_acct(flow->ct, th->dir == IP_CT_DIR_ORIGINAL ?
+			   IP_CT_ESTABLISHED : IP_CT_ESTABLISHED_REPLY,
+			   skb, flow->timeout);
+
+	skb->dev = dst->dev;
+	skb_dst_drop(skb);
+	skb_dst_set(skb, dst_clone(dst));
+	dst_neigh_output(dst, neigh, skb);
+	rcu_read_unlock_bh();
+
+	return RX_HANDLER_CONSUMED;
+
+teardown:
+	set_bit(NF_FLOW_TEARDOWN, &flow->flags);
+	return RX_HANDLER_PASS;
+}
+
+static bool nf_flow_stale(struct nf_flow *flow, const struct net_device *dev)
+{
+	struct nf_conn *ct = flow->ct;
+	struct dst_entry *dst;
+	int dir;
+
+	if (test_bit(NF_FLOW_TEARDOWN, &flow->flags) || nf_ct_is_dying(ct))
+		return true;
+	if (nf_ct_protonum(ct) == IPPROTO_TCP &&
+	    ct->proto.tcp.state != TCP_CONNTRACK_ESTABLISHED)
+		return true;
+	if (!dev)
+		return false;
+
+	for (dir = 0; dir < IP_CT_DIR_MAX; dir++) {
+		if (flow->tuplehash[dir].tuple.iifindex == dev->ifindex)
+			return true;
+		dst = rcu_dereference_protected(flow->tuplehash[dir].dst,
+					lockdep_is_held(&nf_flow_lock));
+		if (dst && dst->dev == dev)
+			return true;
+	}
+	return false;
+}
+
+/* Remove torn down flows, and every flow through @dev if it is given */
+static void nf_flow_sweep(const struct net_device *dev, bool flush)
+{
+	struct nf_flow_tuple_hash *th;
+	struct hlist_node *n;
+	struct nf_flow *flow;
+	int i;
+
+	spin_lock_bh(&nf_flow_lock);
+	for (i = 0; i < NF_FLOW_HASH_SIZE; i++) {
+		hlist_for_each_entry_safe(th, n, &nf_flow_table[i], node) {
+			if (th->dir != IP_CT_DIR_ORIGINAL)
+				continue;
+			flow = nf_flow_from_tuplehash(th);
+			if (flush || nf_flow_stale(flow, dev))
+				nf_flow_del(flow);
+		}
+	}
+	spin_unlock_bh(&nf_flow_lock);
+}
+
+static void nf_flow_gc_work(struct work_struct *work)
+{
+	if (atomic_read(&nf_flow_count))
+		nf_flow_sweep(NULL, false);
+	schedule_delayed_work(&nf_flow_gc, HZ);
+}
+
+static int nf_flow_netdev_event(struct notifier_block *this,
+				unsigned long event, void *ptr)
+{
+	struct net_device *dev = ptr;
+
+	switch (event) {
+	case NETDEV_DOWN:
+	case NETDEV_CHANGEADDR:
+	case NETDEV_UNREGISTER:
+		nf_flow_sweep(dev, false);
+		break;
+	}
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block nf_flow_netdev_notifier = {
+	.notifier_call	= nf_flow_netdev_event,
+};
+
+static struct xt_target flowoffload_tg_reg __read_mostly = {
+	.name		= "FLOWOFFLOAD",
+	.family		= NFPROTO_IPV4,
+	.target		= flowoffload_tg,
+	.checkentry	= flowoffload_tg_check,
+	.destroy	= flowoffload_tg_destroy,
+	.table		= "filter",
+	.hooks		= 1 << NF_INET_FORWARD,
+	.me		= THIS_MODULE,
+};
+
+static int __init nf_flow_table_init(void)
+{
+	int i, ret;
+
+	for (i = 0; i < NF_FLOW_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&nf_flow_table[i]);
+	get_random_bytes(&nf_flow_hash_rnd, sizeof(nf_flow_hash_rnd));
+
+	ret = register_netdevice_notifier(&nf_flow_netdev_notifier);
+	if (ret < 0)
+		return ret;
+
+	ret = xt_register_target(&flowoffload_tg_reg);
+	if (ret < 0) {
+		unregister_netdevice_notifier(&nf_flow_netdev_notifier);
+		return ret;
+	}
+
+	schedule_delayed_work(&nf_flow_gc, HZ);
+	rcu_assign_pointer(nf_flow_offload_hook, nf_flow_offload_rx);
+	return 0;
+}
+
+static void __exit nf_flow_table_fini(void)
+{
+	RCU_INIT_POINTER(nf_flow_offload_hook, NULL);
+	xt_unregister_target(&flowoffload_tg_reg);
+	unregister_netdevice_notifier(&nf_flow_netdev_notifier);
+	cancel_delayed_work_sync(&nf_flow_gc);
+	synchronize_net();
+
+	nf_flow_sweep(NULL, true);
+	rcu_barrier();
+}
+
+module_init(nf_flow_table_init);
+module_exit(nf_flow_table_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("IPv4 flow offload table for forwarded connections");
+MODULE_ALIAS("ipt_FLOWOFFLOAD");
@@ -280,6 +280,8 @@
 #include <net/transp_v6.h>
 #include <net/netdma.h>
 #include <net/sock.h>
+#include <net/busy_poll.h>
+#include <net/net_lat.h>
 
 #include <asm/uaccess.h>
 #include <asm/ioctls.h>
@@ -872,6 +874,8 @@ static ssize_t do_tcp_sendpages(struct sock *sk, struct page *page, int offset,
 			goto out_err;
 	}
 
+	tcp_rate_check_app_limited(sk);  /* is sending application-limited? */
+
 	clear_bit(SOCK_ASYNC_NOSPACE, &sk->sk_socket->flags);
 
 	mss_now = tcp_send_mss(sk, &size_goal, flags);
@@ -1092,6 +1096,8 @@ int tcp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 		/* 'common' sending to sendq */
 	}
 
+	tcp_rate_check_app_limited(sk);  /* is sending application-limited? */
+
 	/* This should be in poll */
 	clear_bit(SOCK_ASYNC_NOSPACE, &sk->sk_socket->flags);
 
@@ -1597,6 +1603,10 @@ int tcp_recvmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 	struct sk_buff *skb;
 	u32 urg_hole = 0;
 
+	if (sk_can_busy_loop(sk) && skb_queue_empty(&sk->sk_receive_queue) &&
+	    (sk->sk_state == TCP_ESTABLISHED))
+		sk_busy_loop(sk, nonblock);
+
 	lock_sock(sk);
 
 	err = -ENOTCONN;
@@ -1839,6 +1849,9 @@ do_prequeue:
 		continue;
 
 	found_ok_skb:
+		if (!(flags & MSG_PEEK))
+			net_lat_stage(skb, NET_LAT_SK_DEQUEUE);
+
 		/* Ok so how much can we use? */
 		used = skb->len - offset;
 		if (len < used)
@@ -75,6 +75,7 @@
 #include <net/netdma.h>
 #include <net/secure_seq.h>
 #include <net/tcp_memcontrol.h>
+#include <net/busy_poll.h>
 
 #include <linux/inet.h>
 #include <linux/ipv6.h>
@@ -2047,6 +2048,7 @@ process:
 
 	if (tcp_filter(sk, skb))
 		goto discard_and_relse;
+	sk_mark_napi_id(sk, skb);
 	th = (const struct tcphdr *)skb->data;
 	iph = ip_hdr(skb);
 
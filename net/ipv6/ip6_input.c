@@ -44,6 +44,7 @@
 #include <net/ip6_route.h>
 #include <net/addrconf.h>
 #include <net/xfrm.h>
+#include <net/net_lat.h>
 
 
 
@@ -69,6 +70,8 @@ int ipv6_rcv(struct sk_buff *skb, struct net_device *dev, struct packet_type *pt
 	struct inet6_dev *idev;
 	struct net *net = dev_net(skb->dev);
 
+	net_lat_stage(skb, NET_LAT_IP_RCV);
+
 	if (skb->pkt_type == PACKET_OTHERHOST) {
 		kfree_skb(skb);
 		return NET_RX_DROP;
@@ -63,6 +63,7 @@
 #include <net/inet_common.h>
 #include <net/secure_seq.h>
 #include <net/tcp_memcontrol.h>
+#include <net/busy_poll.h>
 
 #include <asm/uaccess.h>
 
@@ -1520,6 +1521,7 @@ process:
 
 	if (tcp_filter(sk, skb))
 		goto discard_and_relse;
+	sk_mark_napi_id(sk, skb);
 	th = (const struct tcphdr *)skb->data;
 	hdr = ipv6_hdr(skb);
 
@@ -11,8 +11,12 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/cache.h>
+#include <linux/hashtable.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
 #include <linux/spinlock_types.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -131,6 +135,12 @@ static inline tag_t get_atag_from_tag(tag_t tag)
 	return tag & TAG_ACCT_MASK;
 }
 
+/* Key for the tag hash tables, folds the acct_tag in on 32bit too */
+static inline u32 tag_hash_key(tag_t tag)
+{
+	return (u32)(tag ^ (tag >> 32));
+}
+
 static inline bool valid_atag(tag_t tag)
 {
 	return !(tag & TAG_UID_MASK);
@@ -179,6 +189,23 @@ struct data_counters {
 	struct byte_packet_counters bpc[IFS_MAX_COUNTER_SETS][IFS_MAX_DIRECTIONS][IFS_MAX_PROTOS];
 };
 
+/*
+ * Each cpu updates its own copy of the counters without locking, and
+ * readers add them up with dc_sum_percpu().
+ * The copies live in a plain array of nr_cpu_ids entries indexed by
+ * smp_processor_id(): tag stats are created from the packet path where
+ * alloc_percpu() can't be used.
+ */
+struct data_counters_pcpu {
+	struct data_counters dc;
+	struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
+#define DC_PCPU_SIZE (nr_cpu_ids * sizeof(struct data_counters_pcpu))
+
+void dc_sum_percpu(struct data_counters *sum,
+		   struct data_counters_pcpu *counters);
+
 static inline uint64_t dc_sum_bytes(struct data_counters *counters,
 				    int set,
 				    enum ifs_tx_rx direction)
@@ -204,14 +231,23 @@ struct tag_node {
 	tag_t tag;
 };
 
+/*
+ * tag_stats are looked up per packet through the RCU protected
+ * iface_stat.tag_stat_hash. The rb_tree is only used by the ctrl and
+ * stats proc code, under iface_stat.tag_stat_list_lock.
+ */
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
+	struct hlist_node hash_node;  /* in iface_stat.tag_stat_hash */
+	struct rcu_head rcu;
 	/*
 	 * If this tag is acct_tag based, we need to count against the
 	 * matching parent uid_tag.
+	 * The parent is only deleted along with its children.
 	 */
-	struct data_counters *parent_counters;
+	struct data_counters_pcpu *parent_counters;
+	/* nr_cpu_ids entries */
+	struct data_counters_pcpu counters[];
 };
 
 struct iface_stat {
@@ -222,7 +258,6 @@ struct iface_stat {
 	struct net_device *net_dev;
 
 	struct byte_packet_counters totals_via_dev[IFS_MAX_DIRECTIONS];
-	struct data_counters totals_via_skb;
 	/*
 	 * We keep the last_known, because some devices reset their counters
 	 * just before NETDEV_UP, while some will reset just before
@@ -239,6 +274,10 @@ struct iface_stat {
 
 	struct rb_root tag_stat_tree;
 	spinlock_t tag_stat_list_lock;
+	DECLARE_HASHTABLE(tag_stat_hash, 8);
+
+	/* nr_cpu_ids entries */
+	struct data_counters_pcpu totals_via_skb[];
 };
 
 /* This is needed to create proc_dir_entries from atomic context. */
@@ -255,6 +294,9 @@ struct iface_stat_work {
  */
 struct sock_tag {
 	struct rb_node sock_node;
+	/* The packet path looks sock_tags up in sock_tag_hash under RCU */
+	struct hlist_node hash_node;
+	struct rcu_head rcu;
 	struct sock *sk;  /* Only used as a number, never dereferenced */
 	/* The socket is needed for sockfd_put() */
 	struct socket *socket;
@@ -300,6 +342,8 @@ struct qtaguid_event_counts {
 /* Track the set active_set for the given tag. */
 struct tag_counter_set {
 	struct tag_node tn;
+	struct hlist_node hash_node;  /* in tag_counter_set_hash */
+	struct rcu_head rcu;
 	int active_set;
 };
 
@@ -177,6 +177,9 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 
 #define PGV_FROM_VMALLOC 1
 
+/* Frames sent per driver call when the qdisc is bypassed */
+#define TPACKET_TX_BATCH	32
+
 #define BLOCK_STATUS(x)	((x)->hdr.bh1.block_status)
 #define BLOCK_NUM_PKTS(x)	((x)->hdr.bh1.num_pkts)
 #define BLOCK_O2FP(x)		((x)->hdr.bh1.offset_to_first_pkt)
@@ -187,6 +190,7 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 
 struct packet_sock;
 static int tpacket_snd(struct packet_sock *po, struct msghdr *msg);
+static int packet_direct_xmit(struct sk_buff *skb);
 static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 		       struct packet_type *pt, struct net_device *orig_dev);
 
@@ -261,6 +265,91 @@ static void packet_cached_dev_reset(struct packet_sock *po)
 	RCU_INIT_POINTER(po->cached_dev, NULL);
 }
 
+static bool packet_use_direct_xmit(const struct packet_sock *po)
+{
+	return po->xmit == packet_direct_xmit;
+}
+
+static u16 packet_pick_tx_queue(struct net_device *dev)
+{
+	return (u16) raw_smp_processor_id() % dev->real_num_tx_queues;
+}
+
+/* Do what dev_hard_start_xmit() would have done to make the skb
+ * acceptable to the driver, or tell the caller to drop it.
+ */
+static bool packet_direct_xmit_prep(struct sk_buff *skb)
+{
+	netdev_features_t features = netif_skb_features(skb);
+
+	if (netif_needs_gso(skb, features))
+		return false;
+	if (skb_is_nonlinear(skb) && !(features & NETIF_F_SG) &&
+	    __skb_linearize(skb))
+		return false;
+	if (skb->ip_summed == CHECKSUM_PARTIAL &&
+	    !(features & NETIF_F_ALL_CSUM) && skb_checksum_help(skb))
+		return false;
+	return true;
+}
+
+/* Hand a list of skbs for @dev straight to the driver, bypassing the
+ * qdisc layer and the taps. The tx queue is picked by the sending cpu,
+ * and its lock is taken once for the whole list. Whatever the driver
+ * does not accept is dropped; the list is always consumed.
+ */
+static int packet_direct_xmit_list(struct net_device *dev,
+				   struct sk_buff_head *list)
+{
+	const struct net_device_ops *ops = dev->netdev_ops;
+	struct netdev_queue *txq;
+	struct sk_buff *skb;
+	int ret, err = 0;
+	u16 queue_map;
+
+	if (unlikely(!netif_running(dev) || !netif_carrier_ok(dev))) {
+		__skb_queue_purge(list);
+		return -ENETDOWN;
+	}
+
+	local_bh_disable();
+
+	queue_map = packet_pick_tx_queue(dev);
+	txq = netdev_get_tx_queue(dev, queue_map);
+
+	HARD_TX_LOCK(dev, txq, smp_processor_id());
+	while ((skb = __skb_dequeue(list)) != NULL) {
+		ret = NETDEV_TX_BUSY;
+		skb_set_queue_mapping(skb, queue_map);
+		if (packet_direct_xmit_prep(skb) &&
+		    !netif_xmit_frozen_or_stopped(txq)) {
+			ret = ops->ndo_start_xmit(skb, dev);
+			if (ret == NETDEV_TX_OK)
+				txq_trans_update(txq);
+		}
+		if (!dev_xmit_complete(ret)) {
+			kfree_skb(skb);
+			err = -ENOBUFS;
+		}
+	}
+	HARD_TX_UNLOCK(dev, txq);
+
+	local_bh_enable();
+
+	return err;
+}
+
+static int packet_direct_xmit(struct sk_buff *skb)
+{
+	struct sk_buff_head list;
+
+	__skb_queue_head_init(&list);
+	__skb_queue_tail(&list, skb);
+
+	return packet_direct_xmit_list(skb->dev, &list) ?
+	       NET_XMIT_DROP : NET_XMIT_SUCCESS;
+}
+
 /* register_prot_hook must be invoked with the po->bind_lock held,
  * or from a context in which asynchronous accesses to the packet
  * socket is not possible (packet_create()).
@@ -337,6 +426,9 @@ static void __packet_set_status(struct packet_sock *po, void *frame, int status)
 		flush_dcache_page(pgv_to_page(&h.h2->tp_status));
 		break;
 	case TPACKET_V3:
+		h.h3->tp_status = status;
+		flush_dcache_page(pgv_to_page(&h.h3->tp_status));
+		break;
 	default:
 		WARN(1, "TPACKET version not supported.\n");
 		BUG();
@@ -360,6 +452,8 @@ static int __packet_get_status(struct packet_sock *po, void *frame)
 		flush_dcache_page(pgv_to_page(&h.h2->tp_status));
 		return h.h2->tp_status;
 	case TPACKET_V3:
+		flush_dcache_page(pgv_to_page(&h.h3->tp_status));
+		return h.h3->tp_status;
 	default:
 		WARN(1, "TPACKET version not supported.\n");
 		BUG();
@@ -408,6 +502,9 @@ static __u32 __packet_set_timestamp(struct packet_sock *po, void *frame,
 		h.h2->tp_nsec = ts.tv_nsec;
 		break;
 	case TPACKET_V3:
+		h.h3->tp_sec = ts.tv_sec;
+		h.h3->tp_nsec = ts.tv_nsec;
+		break;
 	default:
 		WARN(1, "TPACKET version not supported.\n");
 		BUG();
@@ -1173,6 +1270,13 @@ static unsigned int fanout_demux_cpu(struct packet_fanout *f,
 	return smp_processor_id() % num;
 }
 
+static unsigned int fanout_demux_qm(struct packet_fanout *f,
+				    struct sk_buff *skb,
+				    unsigned int num)
+{
+	return skb_get_rx_queue(skb) % num;
+}
+
 static unsigned int fanout_demux_rollover(struct packet_fanout *f,
 					  struct sk_buff *skb,
 					  unsigned int idx, unsigned int skip,
@@ -1233,6 +1337,9 @@ static int packet_rcv_fanout(struct sk_buff *skb, struct net_device *dev,
 	case PACKET_FANOUT_ROLLOVER:
 		idx = fanout_demux_rollover(f, skb, 0, (unsigned int) -1, num);
 		break;
+	case PACKET_FANOUT_QM:
+		idx = fanout_demux_qm(f, skb, num);
+		break;
 	}
 
 	po = pkt_sk(f->arr[idx]);
@@ -1303,6 +1410,7 @@ static int fanout_add(struct sock *sk, u16 id, u16 type_flags)
 	case PACKET_FANOUT_HASH:
 	case PACKET_FANOUT_LB:
 	case PACKET_FANOUT_CPU:
+	case PACKET_FANOUT_QM:
 		break;
 	default:
 		return -EINVAL;
@@ -1980,6 +2088,14 @@ static int tpacket_fill_skb(struct packet_sock *po, struct sk_buff *skb,
 	skb_shinfo(skb)->destructor_arg = ph.raw;
 
 	switch (po->tp_version) {
+	case TPACKET_V3:
+		/* tx frames are fixed size, there is no next frame to link */
+		if (ph.h3->tp_next_offset != 0) {
+			pr_warn_once("variable sized slot not supported");
+			return -EINVAL;
+		}
+		tp_len = ph.h3->tp_len;
+		break;
 	case TPACKET_V2:
 		tp_len = ph.h2->tp_len;
 		break;
@@ -2002,6 +2118,9 @@ static int tpacket_fill_skb(struct packet_sock *po, struct sk_buff *skb,
 		off_max = po->tx_ring.frame_size - tp_len;
 		if (sock->type == SOCK_DGRAM) {
 			switch (po->tp_version) {
+			case TPACKET_V3:
+				off = ph.h3->tp_net;
+				break;
 			case TPACKET_V2:
 				off = ph.h2->tp_net;
 				break;
@@ -2011,6 +2130,9 @@ static int tpacket_fill_skb(struct packet_sock *po, struct sk_buff *skb,
 			}
 		} else {
 			switch (po->tp_version) {
+			case TPACKET_V3:
+				off = ph.h3->tp_mac;
+				break;
 			case TPACKET_V2:
 				off = ph.h2->tp_mac;
 				break;
@@ -2095,6 +2217,10 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 	int len_sum = 0;
 	int status = TP_STATUS_AVAILABLE;
 	int hlen, tlen;
+	bool batch = packet_use_direct_xmit(po);
+	struct sk_buff_head queue;
+
+	__skb_queue_head_init(&queue);
 
 	mutex_lock(&po->pg_vec_lock);
 
@@ -2135,6 +2261,12 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 				TP_STATUS_SEND_REQUEST);
 
 		if (unlikely(ph == NULL)) {
+			/* Kick what we have before waiting for completions */
+			if (!skb_queue_empty(&queue)) {
+				err = packet_direct_xmit_list(dev, &queue);
+				if (unlikely(err))
+					goto out_put;
+			}
 			schedule();
 			continue;
 		}
@@ -2170,6 +2302,22 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 		__packet_set_status(po, ph, TP_STATUS_SENDING);
 		atomic_inc(&po->tx_ring.pending);
 
+		/* With the qdisc bypassed, frames are sent TPACKET_TX_BATCH
+		 * at a time. Frames the driver drops are released by the
+		 * destructor, and the error is reported on the next flush.
+		 */
+		if (batch) {
+			__skb_queue_tail(&queue, skb);
+			packet_increment_head(&po->tx_ring);
+			len_sum += tp_len;
+			if (skb_queue_len(&queue) >= TPACKET_TX_BATCH) {
+				err = packet_direct_xmit_list(dev, &queue);
+				if (unlikely(err))
+					goto out_put;
+			}
+			continue;
+		}
+
 		status = TP_STATUS_SEND_REQUEST;
 		err = dev_queue_xmit(skb);
 		if (unlikely(err > 0)) {
@@ -2200,6 +2348,12 @@ out_status:
 	__packet_set_status(po, ph, status);
 	kfree_skb(skb);
 out_put:
+	if (!skb_queue_empty(&queue)) {
+		int ret = packet_direct_xmit_list(dev, &queue);
+
+		if (unlikely(ret) && err >= 0)
+			err = ret;
+	}
 	dev_put(dev);
 out:
 	mutex_unlock(&po->pg_vec_lock);
@@ -2407,7 +2561,7 @@ static int packet_snd(struct socket *sock,
 	 *	Now send it
 	 */
 
-	err = dev_queue_xmit(skb);
+	err = po->xmit(skb);
 	if (err > 0 && (err = net_xmit_errno(err)) != 0)
 		goto out_unlock;
 
@@ -2664,6 +2818,7 @@ static int packet_create(struct net *net, struct socket *sock, int protocol,
 
 	spin_lock_init(&po->bind_lock);
 	mutex_init(&po->pg_vec_lock);
+	po->xmit = dev_queue_xmit;
 	po->prot_hook.func = packet_rcv;
 
 	if (sock->type == SOCK_PACKET)
@@ -3289,6 +3444,18 @@ packet_setsockopt(struct socket *sock, int level, int optname, char __user *optv
 		po->tp_tx_has_off = !!val;
 		return 0;
 	}
+	case PACKET_QDISC_BYPASS:
+	{
+		int val;
+
+		if (optlen != sizeof(val))
+			return -EINVAL;
+		if (copy_from_user(&val, optval, sizeof(val)))
+			return -EFAULT;
+
+		po->xmit = val ? packet_direct_xmit : dev_queue_xmit;
+		return 0;
+	}
 	default:
 		return -ENOPROTOOPT;
 	}
@@ -3383,6 +3550,9 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 	case PACKET_TX_HAS_OFF:
 		val = po->tp_tx_has_off;
 		break;
+	case PACKET_QDISC_BYPASS:
+		val = packet_use_direct_xmit(po);
+		break;
 	default:
 		return -ENOPROTOOPT;
 	}
@@ -3643,11 +3813,13 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 	struct tpacket_req *req = &req_u->req;
 
 	lock_sock(sk);
-	/* Opening a Tx-ring is NOT supported in TPACKET_V3 */
-	if (!closing && tx_ring && (po->tp_version > TPACKET_V2)) {
-		WARN(1, "Tx-ring is not supported.\n");
+	/* A TPACKET_V3 Tx-ring is frame based like V1/V2; the block
+	 * retire timer and private area only make sense on receive.
+	 */
+	if (!closing && tx_ring && (po->tp_version > TPACKET_V2) &&
+	    (req_u->req3.tp_retire_blk_tov || req_u->req3.tp_sizeof_priv ||
+	     req_u->req3.tp_feature_req_word))
 		goto out;
-	}
 
 	rb = tx_ring ? &po->tx_ring : &po->rx_ring;
 	rb_queue = tx_ring ? &sk->sk_write_queue : &sk->sk_receive_queue;
@@ -3709,9 +3881,7 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 			goto out;
 		switch (po->tp_version) {
 		case TPACKET_V3:
-		/* Transmit path is not supported. We checked
-		 * it above but just being paranoid
-		 */
+			/* Block-based V3 is only used on the Rx-ring */
 			if (!tx_ring)
 				init_prb_bdqc(po, rb, pg_vec, req_u, tx_ring);
 			break;
@@ -24,6 +24,7 @@
 #include "rmnet_data_config.h"
 #include "rmnet_data_handlers.h"
 #include "rmnet_data_vnd.h"
+#include "rmnet_map.h"
 #include "rmnet_data_private.h"
 #include "rmnet_data_trace.h"
 
@@ -711,6 +712,7 @@ int rmnet_unassociate_network_device(struct net_device *dev)
 	if (!config)
 		return RMNET_CONFIG_UNKNOWN_ERROR;
 
+	rmnet_map_aggregate_exit(config);
 	kfree(config);
 
 	netdev_rx_handler_unregister(dev);
@@ -839,6 +841,10 @@ int rmnet_associate_network_device(struct net_device *dev)
 	memset(config, 0, sizeof(struct rmnet_phys_ep_conf_s));
 	config->dev = dev;
 	spin_lock_init(&config->agg_lock);
+	hrtimer_init(&config->hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	config->hrtimer.function = rmnet_map_flush_packet_queue;
+	tasklet_init(&config->tasklet, rmnet_map_flush_packet_work,
+		     (unsigned long)config);
 
 	rc = netdev_rx_handler_register(dev, rmnet_rx_handler, config);
 
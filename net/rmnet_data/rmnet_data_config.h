@@ -17,6 +17,8 @@
 #include <linux/types.h>
 #include <linux/time.h>
 #include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 
 #ifndef _RMNET_DATA_CONFIG_H_
 #define _RMNET_DATA_CONFIG_H_
@@ -58,8 +60,13 @@ struct rmnet_logical_ep_conf_s {
  *                  Smaller of the two parameters above are chosen for
  *                  aggregation
  * @tail_spacing: Guaranteed padding (bytes) when de-aggregating ingress frames
- * @agg_time: Wall clock time when aggregated frame was created
+ * @agg_tail: Last packet chained on the frag_list of agg_skb, or 0 if the
+ *            aggregated frame is a single linear copy
+ * @agg_time: Monotonic time when aggregated frame was created
  * @agg_last: Last time the aggregation routing was invoked
+ * @agg_gap_avg: Moving average (ns) of the spacing between egress packets
+ * @hrtimer: Flushes the aggregated frame once the traffic goes idle
+ * @tasklet: Transmits the aggregated frame on behalf of the hrtimer
  */
 struct rmnet_phys_ep_conf_s {
 	struct net_device *dev;
@@ -78,10 +85,14 @@ struct rmnet_phys_ep_conf_s {
 	 */
 	spinlock_t agg_lock;
 	struct sk_buff *agg_skb;
+	struct sk_buff *agg_tail;
 	uint8_t agg_state;
 	uint8_t agg_count;
-	struct timespec agg_time;
-	struct timespec agg_last;
+	ktime_t agg_time;
+	ktime_t agg_last;
+	uint32_t agg_gap_avg;
+	struct hrtimer hrtimer;
+	struct tasklet_struct tasklet;
 };
 
 int rmnet_config_init(void);
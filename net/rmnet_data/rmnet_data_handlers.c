@@ -191,9 +191,6 @@ static void rmnet_reset_mac_header(struct sk_buff *skb)
 static rx_handler_result_t __rmnet_deliver_skb(struct sk_buff *skb,
 					 struct rmnet_logical_ep_conf_s *ep)
 {
-	struct napi_struct *napi = NULL;
-	gro_result_t gro_res;
-
 	trace___rmnet_deliver_skb(skb);
 	switch (ep->rmnet_mode) {
 	case RMNET_EPMODE_NONE:
@@ -212,18 +209,10 @@ static rx_handler_result_t __rmnet_deliver_skb(struct sk_buff *skb,
 		case RX_HANDLER_PASS:
 			skb->pkt_type = PACKET_HOST;
 			rmnet_reset_mac_header(skb);
-			if (skb->dev->features & NETIF_F_GRO) {
-				napi = get_current_napi_context();
-				if (napi != NULL) {
-					gro_res = napi_gro_receive(napi, skb);
-					trace_rmnet_gro_downlink(gro_res);
-				} else {
-					WARN_ONCE(1, "current napi is NULL\n");
-					netif_receive_skb(skb);
-				}
-			} else {
+			if (skb->dev->features & NETIF_F_GRO)
+				rmnet_vnd_gro_receive(skb);
+			else
 				netif_receive_skb(skb);
-			}
 			return RX_HANDLER_CONSUMED;
 		}
 		return RX_HANDLER_PASS;
@@ -348,6 +337,15 @@ static rx_handler_result_t _rmnet_map_ingress_handler(struct sk_buff *skb,
 	skb_pull(skb, sizeof(struct rmnet_map_header_s));
 	skb_trim(skb, len);
 	__rmnet_data_set_skb_proto(skb);
+
+	/* Hash the flow while the headers are still cache hot so that RPS on
+	 * the VND does not have to dissect the packet again.
+	 */
+	if (config->ingress_data_format & RMNET_INGRESS_FORMAT_FLOW_HASH) {
+		skb_reset_network_header(skb);
+		skb_get_rxhash(skb);
+	}
+
 	return __rmnet_deliver_skb(skb, ep);
 }
 
@@ -566,35 +564,19 @@ rx_handler_result_t rmnet_rx_handler(struct sk_buff **pskb)
 }
 
 /**
- * rmnet_egress_handler() - Egress handler entry point
+ * __rmnet_egress_handler() - Transmits a single (non GSO) packet
  * @skb:        packet to transmit
+ * @config:     physical endpoint configuration of the egress device
  * @ep:         logical endpoint configuration of the packet originator
- *              (e.g.. RmNet virtual network device)
- *
- * Modifies packet as per logical endpoint configuration and egress data format
- * for egress device configured in logical endpoint. Packet is then transmitted
- * on the egress device.
+ * @orig_dev:   device the packet was sent on (e.g.. RmNet virtual network
+ *              device)
  */
-void rmnet_egress_handler(struct sk_buff *skb,
-			  struct rmnet_logical_ep_conf_s *ep)
+static void __rmnet_egress_handler(struct sk_buff *skb,
+				   struct rmnet_phys_ep_conf_s *config,
+				   struct rmnet_logical_ep_conf_s *ep,
+				   struct net_device *orig_dev)
 {
-	struct rmnet_phys_ep_conf_s *config;
-	struct net_device *orig_dev;
 	int rc;
-	orig_dev = skb->dev;
-	skb->dev = ep->egress_dev;
-
-	config = (struct rmnet_phys_ep_conf_s *)
-		rcu_dereference(skb->dev->rx_handler_data);
-
-	if (!config) {
-		LOGD("%s is not associated with rmnet_data", skb->dev->name);
-		kfree_skb(skb);
-		return;
-	}
-
-	LOGD("Packet going out on %s with egress format 0x%08X",
-	     skb->dev->name, config->egress_data_format);
 
 	if (config->egress_data_format & RMNET_EGRESS_FORMAT_MAP) {
 		switch (rmnet_map_egress_handler(skb, config, ep, orig_dev)) {
@@ -625,3 +607,78 @@ void rmnet_egress_handler(struct sk_buff *skb,
 	}
 	rmnet_stats_queue_xmit(rc, RMNET_STATS_QUEUE_XMIT_EGRESS);
 }
+
+/**
+ * rmnet_egress_segment() - Segments a GSO packet before MAP processing
+ * @skb:        GSO packet to transmit
+ * @config:     physical endpoint configuration of the egress device
+ * @ep:         logical endpoint configuration of the packet originator
+ * @orig_dev:   device the packet was sent on
+ *
+ * Every MAP packet carries its own header, so the super-packet cannot be left
+ * for the egress device to segment. The stack still traverses the protocol
+ * layers once per super-packet; the segments are then fed one by one to MAP
+ * processing, and typically straight into the aggregation buffer. Checksums
+ * are left to the MAP checksum offload when orig_dev advertises it.
+ */
+static void rmnet_egress_segment(struct sk_buff *skb,
+				 struct rmnet_phys_ep_conf_s *config,
+				 struct rmnet_logical_ep_conf_s *ep,
+				 struct net_device *orig_dev)
+{
+	struct sk_buff *segs, *next;
+
+	segs = skb_gso_segment(skb, orig_dev->features & ~NETIF_F_GSO_MASK);
+	if (IS_ERR_OR_NULL(segs)) {
+		LOGD("Failed to segment GSO packet on %s", orig_dev->name);
+		rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_EGR_GSO_FAIL);
+		return;
+	}
+	consume_skb(skb);
+
+	while (segs) {
+		next = segs->next;
+		segs->next = 0;
+		__rmnet_egress_handler(segs, config, ep, orig_dev);
+		segs = next;
+	}
+}
+
+/**
+ * rmnet_egress_handler() - Egress handler entry point
+ * @skb:        packet to transmit
+ * @ep:         logical endpoint configuration of the packet originator
+ *              (e.g.. RmNet virtual network device)
+ *
+ * Modifies packet as per logical endpoint configuration and egress data format
+ * for egress device configured in logical endpoint. Packet is then transmitted
+ * on the egress device. GSO packets are segmented first if MAP is used.
+ */
+void rmnet_egress_handler(struct sk_buff *skb,
+			  struct rmnet_logical_ep_conf_s *ep)
+{
+	struct rmnet_phys_ep_conf_s *config;
+	struct net_device *orig_dev;
+	orig_dev = skb->dev;
+	skb->dev = ep->egress_dev;
+
+	config = (struct rmnet_phys_ep_conf_s *)
+		rcu_dereference(skb->dev->rx_handler_data);
+
+	if (!config) {
+		LOGD("%s is not associated with rmnet_data", skb->dev->name);
+		kfree_skb(skb);
+		return;
+	}
+
+	LOGD("Packet going out on %s with egress format 0x%08X",
+	     skb->dev->name, config->egress_data_format);
+
+	if (skb_is_gso(skb) &&
+	    (config->egress_data_format & RMNET_EGRESS_FORMAT_MAP)) {
+		rmnet_egress_segment(skb, config, ep, orig_dev);
+		return;
+	}
+
+	__rmnet_egress_handler(skb, config, ep, orig_dev);
+}
@@ -39,6 +39,8 @@ enum rmnet_skb_free_e {
 	RMNET_STATS_SKBFREE_DEAGG_UNKOWN_IP_TYP,
 	RMNET_STATS_SKBFREE_DEAGG_DATA_LEN_0,
 	RMNET_STATS_SKBFREE_INGRESS_BAD_MAP_CKSUM,
+	RMNET_STATS_SKBFREE_EGR_GSO_FAIL,
+	RMNET_STATS_SKBFREE_AGG_UNASSOCIATE,
 	RMNET_STATS_SKBFREE_MAX
 };
 
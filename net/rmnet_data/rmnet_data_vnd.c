@@ -45,6 +45,7 @@ enum {
 };
 
 struct net_device *rmnet_devices[RMNET_DATA_MAX_VND];
+static const struct net_device_ops rmnet_data_vnd_ops;
 
 struct rmnet_map_flow_mapping_s {
 	struct list_head list;
@@ -62,8 +63,13 @@ struct rmnet_vnd_private_s {
 	rwlock_t flow_map_lock;
 	struct list_head flow_head;
 	struct rmnet_map_flow_mapping_s root_flow;
+
+	struct napi_struct napi;
+	struct sk_buff_head rx_queue;
 };
 
+#define RMNET_VND_NAPI_WEIGHT 64
+
 #define RMNET_VND_FC_QUEUED      0
 #define RMNET_VND_FC_NOT_ENABLED 1
 #define RMNET_VND_FC_KMALLOC_ERR 2
@@ -156,6 +162,107 @@ int rmnet_vnd_tx_fixup(struct sk_buff *skb, struct net_device *dev)
 
 /* ***************** Network Device Operations ****************************** */
 
+/**
+ * rmnet_vnd_gro_receive() - Hands an ingress packet to the device NAPI context
+ * @skb:        Packet to deliver; skb->dev must already be set
+ *
+ * Packets are queued and the per device NAPI context is scheduled, so that
+ * all packets de-aggregated from a MAP frame are coalesced by GRO before
+ * going up the stack, whether or not the physical device uses NAPI. Packets
+ * for devices which are not an rmnet_data VND are delivered directly.
+ */
+void rmnet_vnd_gro_receive(struct sk_buff *skb)
+{
+	struct rmnet_vnd_private_s *dev_conf;
+	struct net_device *dev = skb->dev;
+
+	if (dev->netdev_ops != &rmnet_data_vnd_ops) {
+		netif_receive_skb(skb);
+		return;
+	}
+
+	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	if (unlikely(!netif_running(dev) ||
+	    skb_queue_len(&dev_conf->rx_queue) >= netdev_max_backlog)) {
+		dev->stats.rx_dropped++;
+		kfree_skb(skb);
+		return;
+	}
+
+	skb_queue_tail(&dev_conf->rx_queue, skb);
+	napi_schedule(&dev_conf->napi);
+}
+
+/**
+ * rmnet_vnd_poll() - NAPI poll callback
+ * @napi:       NAPI context of the virtual network device
+ * @budget:     Maximum number of packets to process
+ *
+ * Return:
+ *      - Number of packets processed
+ */
+static int rmnet_vnd_poll(struct napi_struct *napi, int budget)
+{
+	struct rmnet_vnd_private_s *dev_conf;
+	struct sk_buff *skb;
+	gro_result_t gro_res;
+	int work_done = 0;
+
+	dev_conf = container_of(napi, struct rmnet_vnd_private_s, napi);
+
+	while (work_done < budget) {
+		skb = skb_dequeue(&dev_conf->rx_queue);
+		if (!skb)
+			break;
+
+		gro_res = napi_gro_receive(napi, skb);
+		trace_rmnet_gro_downlink(gro_res);
+		work_done++;
+	}
+
+	if (work_done < budget) {
+		napi_complete(napi);
+		/* Catch packets queued after the last dequeue */
+		if (!skb_queue_empty(&dev_conf->rx_queue))
+			napi_schedule(napi);
+	}
+
+	return work_done;
+}
+
+/**
+ * rmnet_vnd_open() - Open NDO callback
+ * @dev:        Virtual network device
+ *
+ * Return:
+ *      - 0 under all circumstances
+ */
+static int rmnet_vnd_open(struct net_device *dev)
+{
+	struct rmnet_vnd_private_s *dev_conf;
+
+	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	napi_enable(&dev_conf->napi);
+	return 0;
+}
+
+/**
+ * rmnet_vnd_stop() - Stop NDO callback
+ * @dev:        Virtual network device
+ *
+ * Return:
+ *      - 0 under all circumstances
+ */
+static int rmnet_vnd_stop(struct net_device *dev)
+{
+	struct rmnet_vnd_private_s *dev_conf;
+
+	dev_conf = (struct rmnet_vnd_private_s *) netdev_priv(dev);
+	napi_disable(&dev_conf->napi);
+	skb_queue_purge(&dev_conf->rx_queue);
+	return 0;
+}
+
 /**
  * rmnet_vnd_start_xmit() - Transmit NDO callback
  * @skb:        Socket buffer ("packet") being sent from network stack
@@ -464,6 +571,8 @@ static int rmnet_vnd_ioctl(struct net_device *dev, struct ifreq *ifr, int cmd)
 
 static const struct net_device_ops rmnet_data_vnd_ops = {
 	.ndo_init = 0,
+	.ndo_open = rmnet_vnd_open,
+	.ndo_stop = rmnet_vnd_stop,
 	.ndo_start_xmit = rmnet_vnd_start_xmit,
 	.ndo_do_ioctl = rmnet_vnd_ioctl,
 	.ndo_change_mtu = rmnet_vnd_change_mtu,
@@ -502,6 +611,11 @@ static void rmnet_vnd_setup(struct net_device *dev)
 	/* Flow control */
 	rwlock_init(&dev_conf->flow_map_lock);
 	INIT_LIST_HEAD(&dev_conf->flow_head);
+
+	/* Ingress GRO; the context is removed by free_netdev() */
+	skb_queue_head_init(&dev_conf->rx_queue);
+	netif_napi_add(dev, &dev_conf->napi, rmnet_vnd_poll,
+		       RMNET_VND_NAPI_WEIGHT);
 }
 
 /* ***************** Exposed API ******************************************** */
@@ -605,6 +719,8 @@ int rmnet_vnd_create_dev(int id, struct net_device **new_device,
 		/* Configuring GSO on rmnet_data interfaces */
 		dev->hw_features |= NETIF_F_GSO;
 		dev->hw_features |= NETIF_F_GSO_UDP_TUNNEL;
+		/* Configuring TSO; segmented in rmnet_egress_handler() */
+		dev->hw_features |= NETIF_F_TSO | NETIF_F_TSO6;
 	}
 
 	rc = register_netdevice(dev);
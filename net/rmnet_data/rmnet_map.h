@@ -13,6 +13,7 @@
 
 #include <linux/types.h>
 #include <linux/spinlock.h>
+#include <linux/hrtimer.h>
 
 #ifndef _RMNET_MAP_H_
 #define _RMNET_MAP_H_
@@ -145,6 +146,9 @@ rx_handler_result_t rmnet_map_command(struct sk_buff *skb,
 				      struct rmnet_phys_ep_conf_s *config);
 void rmnet_map_aggregate(struct sk_buff *skb,
 			 struct rmnet_phys_ep_conf_s *config);
+enum hrtimer_restart rmnet_map_flush_packet_queue(struct hrtimer *t);
+void rmnet_map_flush_packet_work(unsigned long data);
+void rmnet_map_aggregate_exit(struct rmnet_phys_ep_conf_s *config);
 
 int rmnet_map_checksum_downlink_packet(struct sk_buff *skb);
 int rmnet_map_checksum_uplink_packet(struct sk_buff *skb,
@@ -20,8 +20,9 @@
 #include <linux/netdevice.h>
 #include <linux/rmnet_data.h>
 #include <linux/spinlock.h>
-#include <linux/workqueue.h>
-#include <linux/time.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+#include <linux/ktime.h>
 #include <linux/net_map.h>
 #include <linux/ip.h>
 #include <linux/ipv6.h>
@@ -49,11 +50,12 @@ long agg_bypass_time __read_mostly = 10000000L;
 module_param(agg_bypass_time, long, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(agg_bypass_time, "Skip agg when apart spaced more than this");
 
+long agg_idle_gaps __read_mostly = 4L;
+module_param(agg_idle_gaps, long, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(agg_idle_gaps, "Flush agg buf after this many avg pkt gaps");
 
-struct agg_work {
-	struct delayed_work work;
-	struct rmnet_phys_ep_conf_s *config;
-};
+/* Weight of a new sample in the packet spacing average is 1/8 */
+#define RMNET_MAP_AGG_GAP_SHIFT 3
 
 #define RMNET_MAP_DEAGGR_SPACING  64
 #define RMNET_MAP_DEAGGR_HEADROOM (RMNET_MAP_DEAGGR_SPACING/2)
@@ -189,38 +191,105 @@ struct sk_buff *rmnet_map_deaggregate(struct sk_buff *skb,
 }
 
 /**
- * rmnet_map_flush_packet_queue() - Transmits aggregeted frame on timeout
- * @work:        struct agg_work containing delayed work and skb to flush
+ * rmnet_map_agg_deadline() - Time at which the aggregated frame is flushed
+ * @config:        Physical endpoint configuration of the egress device
+ *
+ * The frame is held for at most agg_time_limit after it was created, and is
+ * flushed sooner when no packet arrived for agg_idle_gaps times the average
+ * packet spacing; i.e. the burst feeding the frame has most likely ended.
+ * Caller must hold agg_lock.
+ */
+static ktime_t rmnet_map_agg_deadline(struct rmnet_phys_ep_conf_s *config)
+{
+	s64 limit, idle;
+
+	limit = ktime_to_ns(config->agg_time) + agg_time_limit;
+	idle = ktime_to_ns(config->agg_last) +
+	       (s64)agg_idle_gaps * config->agg_gap_avg;
+
+	return ns_to_ktime(min(limit, idle));
+}
+
+/**
+ * rmnet_map_agg_detach() - Takes the aggregated frame out of the config
+ * @config:        Physical endpoint configuration of the egress device
+ * @agg_count:     Returns the number of packets in the frame
+ *
+ * Caller must hold agg_lock.
+ *
+ * Return:
+ *      - Aggregated frame, to be transmitted by the caller
+ *      - 0 (null) if no frame is being aggregated
+ */
+static struct sk_buff *rmnet_map_agg_detach(struct rmnet_phys_ep_conf_s *config,
+					    int *agg_count)
+{
+	struct sk_buff *skb;
+
+	skb = config->agg_skb;
+	*agg_count = config->agg_count;
+	if (skb) {
+		rmnet_stats_agg_pkts(config->agg_count);
+		if (config->agg_count > 1)
+			LOGL("Agg count: %d", config->agg_count);
+	}
+
+	config->agg_skb = 0;
+	config->agg_tail = 0;
+	config->agg_count = 0;
+	config->agg_time = ktime_set(0, 0);
+	return skb;
+}
+
+/**
+ * rmnet_map_flush_packet_queue() - Aggregation hrtimer callback
+ * @t:           hrtimer embedded in the physical endpoint configuration
  *
- * This function is scheduled to run in a specified number of jiffies after
- * the last frame transmitted by the network stack. When run, the buffer
- * containing aggregated packets is finally transmitted on the underlying link.
+ * Runs in hard irq context, where the frame cannot be transmitted, so the
+ * actual flush is deferred to rmnet_map_flush_packet_work().
+ */
+enum hrtimer_restart rmnet_map_flush_packet_queue(struct hrtimer *t)
+{
+	struct rmnet_phys_ep_conf_s *config;
+
+	config = container_of(t, struct rmnet_phys_ep_conf_s, hrtimer);
+	tasklet_schedule(&config->tasklet);
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * rmnet_map_flush_packet_work() - Transmits aggregeted frame on timeout
+ * @data:        Physical endpoint configuration of the egress device
  *
+ * Scheduled by the aggregation hrtimer. The timer is only armed when a frame
+ * is started, so if packets kept arriving since then the deadline has moved
+ * and the timer is simply re-armed. Otherwise the buffer containing
+ * aggregated packets is finally transmitted on the underlying link.
  */
-static void rmnet_map_flush_packet_queue(struct work_struct *work)
+void rmnet_map_flush_packet_work(unsigned long data)
 {
-	struct agg_work *real_work;
 	struct rmnet_phys_ep_conf_s *config;
 	unsigned long flags;
 	struct sk_buff *skb;
+	ktime_t deadline;
 	int rc, agg_count = 0;
 
 	skb = 0;
-	real_work = (struct agg_work *)work;
-	config = real_work->config;
-	LOGD("%s", "Entering flush thread");
+	config = (struct rmnet_phys_ep_conf_s *)data;
+	LOGD("%s", "Entering flush tasklet");
 	spin_lock_irqsave(&config->agg_lock, flags);
 	if (likely(config->agg_state == RMNET_MAP_TXFER_SCHEDULED)) {
 		/* Buffer may have already been shipped out */
 		if (likely(config->agg_skb)) {
-			rmnet_stats_agg_pkts(config->agg_count);
-			if (config->agg_count > 1)
-				LOGL("Agg count: %d", config->agg_count);
-			skb = config->agg_skb;
-			agg_count = config->agg_count;
-			config->agg_skb = 0;
-			config->agg_count = 0;
-			memset(&(config->agg_time), 0, sizeof(struct timespec));
+			deadline = rmnet_map_agg_deadline(config);
+			if (ktime_compare(ktime_get(), deadline) < 0) {
+				hrtimer_start(&config->hrtimer, deadline,
+					      HRTIMER_MODE_ABS);
+				spin_unlock_irqrestore(&config->agg_lock,
+						       flags);
+				return;
+			}
+			skb = rmnet_map_agg_detach(config, &agg_count);
 		}
 		config->agg_state = RMNET_MAP_AGG_IDLE;
 	} else {
@@ -235,7 +304,47 @@ static void rmnet_map_flush_packet_queue(struct work_struct *work)
 		rc = dev_queue_xmit(skb);
 		rmnet_stats_queue_xmit(rc, RMNET_STATS_QUEUE_XMIT_AGG_TIMEOUT);
 	}
-	kfree(work);
+}
+
+/**
+ * rmnet_map_aggregate_exit() - Stops aggregation on a physical endpoint
+ * @config:     Physical endpoint configuration being torn down
+ *
+ * Cancels the flush timer and drops any partially aggregated frame. Must be
+ * called before the configuration is freed.
+ */
+void rmnet_map_aggregate_exit(struct rmnet_phys_ep_conf_s *config)
+{
+	unsigned long flags;
+	struct sk_buff *skb;
+	int agg_count;
+
+	spin_lock_irqsave(&config->agg_lock, flags);
+	skb = rmnet_map_agg_detach(config, &agg_count);
+	config->agg_state = RMNET_MAP_AGG_IDLE;
+	spin_unlock_irqrestore(&config->agg_lock, flags);
+
+	hrtimer_cancel(&config->hrtimer);
+	tasklet_kill(&config->tasklet);
+
+	if (skb)
+		rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_AGG_UNASSOCIATE);
+}
+
+/**
+ * rmnet_map_agg_can_chain() - Checks if a packet may be chained on frag_list
+ * @skb:        Packet being aggregated
+ * @config:     Physical endpoint configuration of the egress device
+ *
+ * Chaining avoids copying every packet into the aggregation buffer but is only
+ * worth it when the egress device takes frag_list skbs as is; otherwise the
+ * stack would linearize the frame on transmit anyway.
+ */
+static inline int rmnet_map_agg_can_chain(struct sk_buff *skb,
+					  struct rmnet_phys_ep_conf_s *config)
+{
+	return (config->dev->features & NETIF_F_FRAGLIST) &&
+	       !skb_has_frag_list(skb) && !skb_cloned(skb);
 }
 
 /**
@@ -246,15 +355,18 @@ static void rmnet_map_flush_packet_queue(struct work_struct *work)
  * Aggregates multiple SKBs into a single large SKB for transmission. MAP
  * protocol is used to separate the packets in the buffer. This funcion consumes
  * the argument SKB and should not be further processed by any other function.
+ *
+ * Packets are chained on the frag_list of the first one when the egress device
+ * supports it, and copied into a linear buffer otherwise. Sparse traffic, as
+ * measured by the average packet spacing, bypasses aggregation entirely.
  */
 void rmnet_map_aggregate(struct sk_buff *skb,
 			 struct rmnet_phys_ep_conf_s *config) {
-	uint8_t *dest_buff;
-	struct agg_work *work;
 	unsigned long flags;
 	struct sk_buff *agg_skb;
-	struct timespec diff, last;
-	int size, rc, agg_count = 0;
+	ktime_t now = ktime_set(0, 0);
+	s64 gap = 0, avg = 0;
+	int size, rc, agg_count = 0, sampled = 0;
 
 
 	if (!skb || !config)
@@ -269,19 +381,33 @@ void rmnet_map_aggregate(struct sk_buff *skb,
 new_packet:
 	spin_lock_irqsave(&config->agg_lock, flags);
 
-	memcpy(&last, &(config->agg_last), sizeof(struct timespec));
-	getnstimeofday(&(config->agg_last));
+	/* Sample the packet spacing only once per packet, not again after a
+	 * full buffer was shipped out below.
+	 */
+	if (!sampled) {
+		now = ktime_get();
+		gap = ktime_to_ns(ktime_sub(now, config->agg_last));
+		config->agg_last = now;
 
-	if (!config->agg_skb) {
-		/* Check to see if we should agg first. If the traffic is very
-		 * sparse, don't aggregate. We will need to tune this later
+		/* Clamp the gap so an idle period does not dominate the
+		 * average for long once traffic resumes.
 		 */
-		diff = timespec_sub(config->agg_last, last);
+		gap = clamp_t(s64, gap, 0, agg_bypass_time);
+		avg = config->agg_gap_avg;
+		avg += (gap - avg) >> RMNET_MAP_AGG_GAP_SHIFT;
+		config->agg_gap_avg = (uint32_t)avg;
+		sampled = 1;
+	}
 
-		if ((diff.tv_sec > 0) || (diff.tv_nsec > agg_bypass_time)) {
+	if (!config->agg_skb) {
+		/* Check to see if we should agg first. If the traffic is too
+		 * sparse for a second packet to show up before the frame would
+		 * be flushed anyway, don't aggregate.
+		 */
+		if ((gap >= agg_bypass_time) || (avg > agg_time_limit)) {
 			spin_unlock_irqrestore(&config->agg_lock, flags);
-			LOGL("delta t: %ld.%09lu\tcount: bypass", diff.tv_sec,
-			     diff.tv_nsec);
+			LOGL("delta t: %lld\tavg: %lld\tcount: bypass", gap,
+			     avg);
 			rmnet_stats_agg_pkts(1);
 			trace_rmnet_map_aggregate(skb, 0);
 			rc = dev_queue_xmit(skb);
@@ -290,11 +416,20 @@ new_packet:
 			return;
 		}
 
+		if (rmnet_map_agg_can_chain(skb, config)) {
+			config->agg_skb = skb;
+			config->agg_tail = skb;
+			config->agg_count = 1;
+			config->agg_time = now;
+			trace_rmnet_start_aggregation(skb);
+			goto schedule;
+		}
+
 		config->agg_skb = skb_copy_expand(skb, 0, size, GFP_ATOMIC);
 		if (!config->agg_skb) {
 			config->agg_skb = 0;
 			config->agg_count = 0;
-			memset(&(config->agg_time), 0, sizeof(struct timespec));
+			config->agg_time = ktime_set(0, 0);
 			spin_unlock_irqrestore(&config->agg_lock, flags);
 			rmnet_stats_agg_pkts(1);
 			trace_rmnet_map_aggregate(skb, 0);
@@ -304,25 +439,20 @@ new_packet:
 			return;
 		}
 		config->agg_count = 1;
-		getnstimeofday(&(config->agg_time));
+		config->agg_time = now;
 		trace_rmnet_start_aggregation(skb);
 		rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_AGG_CPY_EXPAND);
 		goto schedule;
 	}
-	diff = timespec_sub(config->agg_last, config->agg_time);
 
 	if (skb->len > (config->egress_agg_size - config->agg_skb->len)
 	    || (config->agg_count >= config->egress_agg_count)
-	    ||  (diff.tv_sec > 0) || (diff.tv_nsec > agg_time_limit)) {
-		rmnet_stats_agg_pkts(config->agg_count);
-		agg_skb = config->agg_skb;
-		agg_count = config->agg_count;
-		config->agg_skb = 0;
-		config->agg_count = 0;
-		memset(&(config->agg_time), 0, sizeof(struct timespec));
+	    || (config->agg_tail && skb_has_frag_list(skb))
+	    || (ktime_to_ns(ktime_sub(now, config->agg_time)) >
+		agg_time_limit)) {
+		agg_skb = rmnet_map_agg_detach(config, &agg_count);
 		spin_unlock_irqrestore(&config->agg_lock, flags);
-		LOGL("delta t: %ld.%09lu\tcount: %d", diff.tv_sec,
-		     diff.tv_nsec, agg_count);
+		LOGL("delta t: %lld\tcount: %d", gap, agg_count);
 		trace_rmnet_map_aggregate(skb, agg_count);
 		rc = dev_queue_xmit(agg_skb);
 		rmnet_stats_queue_xmit(rc,
@@ -330,27 +460,33 @@ new_packet:
 		goto new_packet;
 	}
 
-	dest_buff = skb_put(config->agg_skb, skb->len);
-	memcpy(dest_buff, skb->data, skb->len);
+	if (config->agg_tail) {
+		/* The chained packets keep their own destructors, so only the
+		 * length of the head is updated and not its truesize; socket
+		 * memory accounting stays with each packet until it is freed.
+		 */
+		agg_skb = config->agg_skb;
+		if (config->agg_tail == agg_skb)
+			skb_shinfo(agg_skb)->frag_list = skb;
+		else
+			config->agg_tail->next = skb;
+		skb->next = 0;
+		config->agg_tail = skb;
+		agg_skb->len += skb->len;
+		agg_skb->data_len += skb->len;
+	} else {
+		if (skb_copy_bits(skb, 0, skb_put(config->agg_skb, skb->len),
+				  skb->len))
+			BUG();
+		rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_AGG_INTO_BUFF);
+	}
 	config->agg_count++;
-	rmnet_kfree_skb(skb, RMNET_STATS_SKBFREE_AGG_INTO_BUFF);
 
 schedule:
 	if (config->agg_state != RMNET_MAP_TXFER_SCHEDULED) {
-		work = (struct agg_work *)
-			kmalloc(sizeof(struct agg_work), GFP_ATOMIC);
-		if (!work) {
-			LOGE("Failed to allocate work item for packet %s",
-			     "transfer. DATA PATH LIKELY BROKEN!");
-			config->agg_state = RMNET_MAP_AGG_IDLE;
-			spin_unlock_irqrestore(&config->agg_lock, flags);
-			return;
-		}
-		INIT_DELAYED_WORK((struct delayed_work *)work,
-				  rmnet_map_flush_packet_queue);
-		work->config = config;
 		config->agg_state = RMNET_MAP_TXFER_SCHEDULED;
-		schedule_delayed_work((struct delayed_work *)work, 1);
+		hrtimer_start(&config->hrtimer, rmnet_map_agg_deadline(config),
+			      HRTIMER_MODE_ABS);
 	}
 	spin_unlock_irqrestore(&config->agg_lock, flags);
 	return;
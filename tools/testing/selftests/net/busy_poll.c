@@ -0,0 +1,361 @@
+/*
+ * Request-response latency with and without SO_BUSY_POLL.
+ *
+ * Checks that SO_BUSY_POLL can be set and read back, then bounces a
+ * small message between a client and an echo server over UDP and TCP,
+ * once with busy polling off and once with it on, and reports the
+ * round trip times.
+ *
+ * By default both ends run on this host over loopback. Loopback has no
+ * NAPI context, so there the two runs only show the cost of the busy
+ * poll path, not its gain. To measure over a NIC, start "busy_poll -s"
+ * on the peer and run "busy_poll -H <peer address>" here.
+ *
+ * Latencies are reported, not judged: only functional errors fail.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL	46
+#endif
+
+#define MSG_LEN		64
+#define DEFAULT_PORT	8765
+#define DEFAULT_ITERS	10000
+#define DEFAULT_USECS	50
+
+static int cfg_port = DEFAULT_PORT;
+static int cfg_iters = DEFAULT_ITERS;
+static int cfg_usecs = DEFAULT_USECS;
+static const char *cfg_host = "127.0.0.1";
+static int cfg_remote;
+
+static void set_busy_poll(int fd, int usecs)
+{
+	if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs))) {
+		perror("setsockopt SO_BUSY_POLL");
+		exit(1);
+	}
+}
+
+/* 0 if usable, 1 if not configured or not permitted, exits on errors */
+static int test_sockopt(void)
+{
+	int fd, val;
+	socklen_t len = sizeof(val);
+
+	fd = socket(PF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+
+	val = cfg_usecs;
+	if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val))) {
+		if (errno == ENOPROTOOPT) {
+			fprintf(stderr, "SO_BUSY_POLL not supported\n");
+			close(fd);
+			return 1;
+		}
+		if (errno == EPERM) {
+			fprintf(stderr, "SO_BUSY_POLL needs CAP_NET_ADMIN\n");
+			close(fd);
+			return 1;
+		}
+		perror("setsockopt SO_BUSY_POLL");
+		exit(1);
+	}
+
+	if (getsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &val, &len)) {
+		perror("getsockopt SO_BUSY_POLL");
+		exit(1);
+	}
+	if (val != cfg_usecs) {
+		fprintf(stderr, "SO_BUSY_POLL: set %d, read back %d\n",
+			cfg_usecs, val);
+		exit(1);
+	}
+
+	val = -1;
+	if (!setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)) ||
+	    errno != EINVAL) {
+		fprintf(stderr, "SO_BUSY_POLL: negative value accepted\n");
+		exit(1);
+	}
+
+	close(fd);
+	return 0;
+}
+
+static int socket_bound(int type)
+{
+	struct sockaddr_in addr;
+	int fd, one = 1;
+
+	fd = socket(PF_INET, type, 0);
+	if (fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one))) {
+		perror("setsockopt SO_REUSEADDR");
+		exit(1);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(cfg_port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(fd, (void *) &addr, sizeof(addr))) {
+		perror("bind");
+		exit(1);
+	}
+
+	return fd;
+}
+
+static void echo_udp(int usecs)
+{
+	struct sockaddr_in peer;
+	socklen_t len;
+	char buf[MSG_LEN];
+	int fd, ret;
+
+	fd = socket_bound(SOCK_DGRAM);
+	set_busy_poll(fd, usecs);
+
+	while (1) {
+		len = sizeof(peer);
+		ret = recvfrom(fd, buf, sizeof(buf), 0, (void *) &peer, &len);
+		if (ret < 0) {
+			perror("recvfrom");
+			exit(1);
+		}
+		if (sendto(fd, buf, ret, 0, (void *) &peer, len) != ret) {
+			perror("sendto");
+			exit(1);
+		}
+	}
+}
+
+static void echo_tcp(int usecs)
+{
+	char buf[MSG_LEN];
+	int fd, conn, ret, one = 1;
+
+	fd = socket_bound(SOCK_STREAM);
+	if (listen(fd, 1)) {
+		perror("listen");
+		exit(1);
+	}
+
+	while (1) {
+		conn = accept(fd, NULL, NULL);
+		if (conn < 0) {
+			perror("accept");
+			exit(1);
+		}
+		set_busy_poll(conn, usecs);
+		setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		while ((ret = recv(conn, buf, sizeof(buf), MSG_WAITALL)) > 0) {
+			if (send(conn, buf, ret, 0) != ret) {
+				perror("send");
+				exit(1);
+			}
+		}
+		close(conn);
+	}
+}
+
+static pid_t start_server(int type, int usecs)
+{
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(1);
+	}
+	if (!pid) {
+		if (type == SOCK_DGRAM)
+			echo_udp(usecs);
+		else
+			echo_tcp(usecs);
+		exit(0);
+	}
+
+	/* let it bind before the first request goes out */
+	usleep(100 * 1000);
+	return pid;
+}
+
+static void stop_server(pid_t pid)
+{
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *) a;
+	unsigned long long y = *(const unsigned long long *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void run_client(int type, int usecs)
+{
+	struct sockaddr_in addr;
+	unsigned long long *rtt, start, sum = 0;
+	char buf[MSG_LEN];
+	struct timeval tv = { .tv_sec = 1 };
+	int fd, i, one = 1;
+
+	rtt = calloc(cfg_iters, sizeof(*rtt));
+	if (!rtt) {
+		perror("calloc");
+		exit(1);
+	}
+
+	fd = socket(PF_INET, type, 0);
+	if (fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+	set_busy_poll(fd, usecs);
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))) {
+		perror("setsockopt SO_RCVTIMEO");
+		exit(1);
+	}
+	if (type == SOCK_STREAM)
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(cfg_port);
+	if (inet_pton(AF_INET, cfg_host, &addr.sin_addr) != 1) {
+		fprintf(stderr, "bad address %s\n", cfg_host);
+		exit(1);
+	}
+	if (connect(fd, (void *) &addr, sizeof(addr))) {
+		perror("connect");
+		exit(1);
+	}
+
+	memset(buf, 'a', sizeof(buf));
+	for (i = 0; i < cfg_iters; i++) {
+		start = now_ns();
+		if (send(fd, buf, sizeof(buf), 0) != sizeof(buf)) {
+			perror("send");
+			exit(1);
+		}
+		if (recv(fd, buf, sizeof(buf), MSG_WAITALL) != sizeof(buf)) {
+			perror("recv");
+			exit(1);
+		}
+		rtt[i] = now_ns() - start;
+		sum += rtt[i];
+	}
+	close(fd);
+
+	qsort(rtt, cfg_iters, sizeof(*rtt), cmp_ull);
+	fprintf(stderr, "%s busy_poll=%3d: avg %llu ns, p50 %llu ns, "
+		"p99 %llu ns\n", type == SOCK_DGRAM ? "udp" : "tcp", usecs,
+		sum / cfg_iters, rtt[cfg_iters / 2],
+		rtt[cfg_iters * 99 / 100]);
+
+	free(rtt);
+}
+
+static void run_test(int type, int usecs)
+{
+	pid_t pid = 0;
+
+	if (!cfg_remote)
+		pid = start_server(type, usecs);
+
+	run_client(type, usecs);
+
+	if (!cfg_remote)
+		stop_server(pid);
+}
+
+static void __attribute__((noreturn)) usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-s] [-H host] [-p port] [-n iters] "
+		"[-b usecs]\n", name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int c, server = 0;
+
+	while ((c = getopt(argc, argv, "sH:p:n:b:")) != -1) {
+		switch (c) {
+		case 's':
+			server = 1;
+			break;
+		case 'H':
+			cfg_host = optarg;
+			cfg_remote = 1;
+			break;
+		case 'p':
+			cfg_port = atoi(optarg);
+			break;
+		case 'n':
+			cfg_iters = atoi(optarg);
+			break;
+		case 'b':
+			cfg_usecs = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (cfg_iters <= 0 || cfg_usecs <= 0)
+		usage(argv[0]);
+
+	if (test_sockopt()) {
+		fprintf(stderr, "OK (skipped)\n");
+		return 0;
+	}
+
+	if (server) {
+		/* udp echo on cfg_port, tcp echo on the same port */
+		if (!fork())
+			echo_tcp(cfg_usecs);
+		echo_udp(cfg_usecs);
+		return 0;
+	}
+
+	run_test(SOCK_DGRAM, 0);
+	run_test(SOCK_DGRAM, cfg_usecs);
+	run_test(SOCK_STREAM, 0);
+	run_test(SOCK_STREAM, cfg_usecs);
+
+	fprintf(stderr, "OK. All tests passed\n");
+	return 0;
+}
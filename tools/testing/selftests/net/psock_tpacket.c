@@ -17,7 +17,9 @@
  *   The test currently runs for
  *   - TPACKET_V1: RX_RING, TX_RING
  *   - TPACKET_V2: RX_RING, TX_RING
- *   - TPACKET_V3: RX_RING
+ *   - TPACKET_V3: RX_RING, TX_RING
+ *
+ *   TX_RING runs once more per version with PACKET_QDISC_BYPASS set.
  *
  * License (GPLv2):
  *
@@ -320,20 +322,33 @@ static inline void __v2_tx_user_ready(struct tpacket2_hdr *hdr)
 	__sync_synchronize();
 }
 
-static inline int __v1_v2_tx_kernel_ready(void *base, int version)
+static inline int __v3_tx_kernel_ready(struct tpacket3_hdr *hdr)
+{
+	return !(hdr->tp_status & (TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING));
+}
+
+static inline void __v3_tx_user_ready(struct tpacket3_hdr *hdr)
+{
+	hdr->tp_status = TP_STATUS_SEND_REQUEST;
+	__sync_synchronize();
+}
+
+static inline int __tx_kernel_ready(void *base, int version)
 {
 	switch (version) {
 	case TPACKET_V1:
 		return __v1_tx_kernel_ready(base);
 	case TPACKET_V2:
 		return __v2_tx_kernel_ready(base);
+	case TPACKET_V3:
+		return __v3_tx_kernel_ready(base);
 	default:
 		bug_on(1);
 		return 0;
 	}
 }
 
-static inline void __v1_v2_tx_user_ready(void *base, int version)
+static inline void __tx_user_ready(void *base, int version)
 {
 	switch (version) {
 	case TPACKET_V1:
@@ -342,10 +357,30 @@ static inline void __v1_v2_tx_user_ready(void *base, int version)
 	case TPACKET_V2:
 		__v2_tx_user_ready(base);
 		break;
+	case TPACKET_V3:
+		__v3_tx_user_ready(base);
+		break;
+	}
+}
+
+/* V3 tx rings are frame based, the frames follow each other */
+static inline void *get_next_frame(struct ring *ring, int n)
+{
+	uint8_t *f0 = ring->rd[0].iov_base;
+
+	switch (ring->version) {
+	case TPACKET_V1:
+	case TPACKET_V2:
+		return ring->rd[n].iov_base;
+	case TPACKET_V3:
+		return f0 + (n * ring->req3.tp_frame_size);
+	default:
+		bug_on(1);
+		return NULL;
 	}
 }
 
-static void __v1_v2_set_packet_loss_discard(int sock)
+static void __set_packet_loss_discard(int sock)
 {
 	int ret, discard = 1;
 
@@ -357,7 +392,7 @@ static void __v1_v2_set_packet_loss_discard(int sock)
 	}
 }
 
-static void walk_v1_v2_tx(int sock, struct ring *ring)
+static void walk_tx(int sock, struct ring *ring)
 {
 	struct pollfd pfd;
 	int rcv_sock, ret;
@@ -369,9 +404,15 @@ static void walk_v1_v2_tx(int sock, struct ring *ring)
 		.sll_family = PF_PACKET,
 		.sll_halen = ETH_ALEN,
 	};
+	int nframes;
+
+	if (ring->version <= TPACKET_V2)
+		nframes = ring->rd_num;
+	else
+		nframes = ring->req3.tp_frame_nr;
 
 	bug_on(ring->type != PACKET_TX_RING);
-	bug_on(ring->rd_num < NUM_PACKETS);
+	bug_on(nframes < NUM_PACKETS);
 
 	rcv_sock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
 	if (rcv_sock == -1) {
@@ -397,10 +438,11 @@ static void walk_v1_v2_tx(int sock, struct ring *ring)
 	create_payload(packet, &packet_len);
 
 	while (total_packets > 0) {
-		while (__v1_v2_tx_kernel_ready(ring->rd[frame_num].iov_base,
-					       ring->version) &&
+		void *next = get_next_frame(ring, frame_num);
+
+		while (__tx_kernel_ready(next, ring->version) &&
 		       total_packets > 0) {
-			ppd.raw = ring->rd[frame_num].iov_base;
+			ppd.raw = next;
 
 			switch (ring->version) {
 			case TPACKET_V1:
@@ -422,14 +464,29 @@ static void walk_v1_v2_tx(int sock, struct ring *ring)
 				       packet_len);
 				total_bytes += ppd.v2->tp_h.tp_snaplen;
 				break;
+
+			case TPACKET_V3: {
+				struct tpacket3_hdr *tx = next;
+
+				tx->tp_snaplen = packet_len;
+				tx->tp_len = packet_len;
+				tx->tp_next_offset = 0;
+
+				memcpy((uint8_t *) tx + TPACKET3_HDRLEN -
+				       sizeof(struct sockaddr_ll), packet,
+				       packet_len);
+				total_bytes += tx->tp_snaplen;
+				break;
+			}
 			}
 
 			status_bar_update();
 			total_packets--;
 
-			__v1_v2_tx_user_ready(ppd.raw, ring->version);
+			__tx_user_ready(next, ring->version);
 
-			frame_num = (frame_num + 1) % ring->rd_num;
+			frame_num = (frame_num + 1) % nframes;
+			next = get_next_frame(ring, frame_num);
 		}
 
 		poll(&pfd, 1, 1);
@@ -443,9 +500,13 @@ static void walk_v1_v2_tx(int sock, struct ring *ring)
 		exit(1);
 	}
 
-	while ((ret = recvfrom(rcv_sock, packet, sizeof(packet),
-			       0, NULL, NULL)) > 0 &&
-	       total_packets < NUM_PACKETS) {
+	/*
+	 * Check the count first: with qdisc bypass the tx tap sees
+	 * nothing, so no packet arrives after the last expected one.
+	 */
+	while (total_packets < NUM_PACKETS &&
+	       (ret = recvfrom(rcv_sock, packet, sizeof(packet),
+			       0, NULL, NULL)) > 0) {
 		got += ret;
 		test_payload(packet, ret);
 
@@ -469,7 +530,7 @@ static void walk_v1_v2(int sock, struct ring *ring)
 	if (ring->type == PACKET_RX_RING)
 		walk_v1_v2_rx(sock, ring);
 	else
-		walk_v1_v2_tx(sock, ring);
+		walk_tx(sock, ring);
 }
 
 static uint64_t __v3_prev_block_seq_num = 0;
@@ -602,7 +663,7 @@ static void walk_v3(int sock, struct ring *ring)
 	if (ring->type == PACKET_RX_RING)
 		walk_v3_rx(sock, ring);
 	else
-		bug_on(1);
+		walk_tx(sock, ring);
 }
 
 static void __v1_v2_fill(struct ring *ring, unsigned int blocks)
@@ -621,11 +682,14 @@ static void __v1_v2_fill(struct ring *ring, unsigned int blocks)
 	ring->flen = ring->req.tp_frame_size;
 }
 
-static void __v3_fill(struct ring *ring, unsigned int blocks)
+static void __v3_fill(struct ring *ring, unsigned int blocks, int type)
 {
-	ring->req3.tp_retire_blk_tov = 64;
-	ring->req3.tp_sizeof_priv = 13;
-	ring->req3.tp_feature_req_word |= TP_FT_REQ_FILL_RXHASH;
+	/* block retirement, private area and features are rx only */
+	if (type == PACKET_RX_RING) {
+		ring->req3.tp_retire_blk_tov = 64;
+		ring->req3.tp_sizeof_priv = 13;
+		ring->req3.tp_feature_req_word |= TP_FT_REQ_FILL_RXHASH;
+	}
 
 	ring->req3.tp_block_size = getpagesize() << 2;
 	ring->req3.tp_frame_size = TPACKET_ALIGNMENT << 7;
@@ -649,18 +713,19 @@ static void setup_ring(int sock, struct ring *ring, int version, int type)
 	ring->type = type;
 	ring->version = version;
 
+	if (type == PACKET_TX_RING)
+		__set_packet_loss_discard(sock);
+
 	switch (version) {
 	case TPACKET_V1:
 	case TPACKET_V2:
-		if (type == PACKET_TX_RING)
-			__v1_v2_set_packet_loss_discard(sock);
 		__v1_v2_fill(ring, blocks);
 		ret = setsockopt(sock, SOL_PACKET, type, &ring->req,
 				 sizeof(ring->req));
 		break;
 
 	case TPACKET_V3:
-		__v3_fill(ring, blocks);
+		__v3_fill(ring, blocks, type);
 		ret = setsockopt(sock, SOL_PACKET, type, &ring->req3,
 				 sizeof(ring->req3));
 		break;
@@ -774,13 +839,25 @@ static const char *type_str[] = {
 	[PACKET_TX_RING] = "PACKET_TX_RING",
 };
 
-static int test_tpacket(int version, int type)
+static void set_qdisc_bypass(int sock)
+{
+	int ret, one = 1;
+
+	ret = setsockopt(sock, SOL_PACKET, PACKET_QDISC_BYPASS, &one,
+			 sizeof(one));
+	if (ret == -1) {
+		perror("setsockopt");
+		exit(1);
+	}
+}
+
+static int test_tpacket(int version, int type, int qdisc_bypass)
 {
 	int sock;
 	struct ring ring;
 
-	fprintf(stderr, "test: %s with %s ", tpacket_str[version],
-		type_str[type]);
+	fprintf(stderr, "test: %s with %s%s ", tpacket_str[version],
+		type_str[type], qdisc_bypass ? " (qdisc bypass)" : "");
 	fflush(stderr);
 
 	if (version == TPACKET_V1 &&
@@ -792,6 +869,8 @@ static int test_tpacket(int version, int type)
 	}
 
 	sock = pfsocket(version);
+	if (qdisc_bypass)
+		set_qdisc_bypass(sock);
 	memset(&ring, 0, sizeof(ring));
 	setup_ring(sock, &ring, version, type);
 	mmap_ring(sock, &ring);
@@ -808,13 +887,17 @@ int main(void)
 {
 	int ret = 0;
 
-	ret |= test_tpacket(TPACKET_V1, PACKET_RX_RING);
-	ret |= test_tpacket(TPACKET_V1, PACKET_TX_RING);
+	ret |= test_tpacket(TPACKET_V1, PACKET_RX_RING, 0);
+	ret |= test_tpacket(TPACKET_V1, PACKET_TX_RING, 0);
+	ret |= test_tpacket(TPACKET_V1, PACKET_TX_RING, 1);
 
-	ret |= test_tpacket(TPACKET_V2, PACKET_RX_RING);
-	ret |= test_tpacket(TPACKET_V2, PACKET_TX_RING);
+	ret |= test_tpacket(TPACKET_V2, PACKET_RX_RING, 0);
+	ret |= test_tpacket(TPACKET_V2, PACKET_TX_RING, 0);
+	ret |= test_tpacket(TPACKET_V2, PACKET_TX_RING, 1);
 
-	ret |= test_tpacket(TPACKET_V3, PACKET_RX_RING);
+	ret |= test_tpacket(TPACKET_V3, PACKET_RX_RING, 0);
+	ret |= test_tpacket(TPACKET_V3, PACKET_TX_RING, 0);
+	ret |= test_tpacket(TPACKET_V3, PACKET_TX_RING, 1);
 
 	if (ret)
 		return 1;